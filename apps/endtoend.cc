@@ -2,12 +2,15 @@
 #include "arp_message.hh"
 #include "bidirectional_stream_copy.hh"
 #include "exception.hh"
+#include "log.hh"
 #include "router.hh"
 #include "tcp_minnow_socket_impl.hh"
 #include "tcp_over_ip.hh"
 
 #include <cstdlib>
 #include <iostream>
+#include <span>
+#include <sys/socket.h>
 #include <thread>
 #include <utility>
 
@@ -100,6 +103,53 @@ private:
     {
       sockets.first.write( serialize( x ) );
     }
+
+    void transmit_packet( const NetworkInterface& n [[maybe_unused]], PacketBuffer&& packet ) override
+    {
+      sockets.first.write( packet.view() );
+    }
+
+    // Send a burst with one sendmmsg, one datagram per frame. A run of frames to the same neighbour shares one
+    // serialized Ethernet header; payloads are sent by reference.
+    void transmit_batch( const NetworkInterface& n [[maybe_unused]], span<const EthernetFrame> frames ) override
+    {
+      using RawHeader = array<char, EthernetHeader::LENGTH>;
+      vector<RawHeader> headers;
+      vector<iovec> iovecs;
+      size_t total_buffers = 0;
+      for ( const auto& frame : frames ) {
+        total_buffers += 1 + frame.payload.size();
+      }
+      iovecs.reserve( total_buffers ); // msg_iov points into this, so it must not reallocate
+      headers.reserve( frames.size() ); // and iov_base into this
+      vector<mmsghdr> messages( frames.size() );
+
+      const EthernetFrame* previous = nullptr;
+      for ( size_t i = 0; i < frames.size(); ++i ) {
+        const EthernetHeader& header = frames[i].header;
+        if ( not previous or header.dst != previous->header.dst or header.src != previous->header.src
+             or header.type != previous->header.type ) {
+          Serializer serializer { headers.emplace_back() };
+          header.serialize( serializer );
+        }
+        previous = &frames[i];
+
+        messages[i].msg_hdr.msg_iov = iovecs.data() + iovecs.size();
+        iovecs.push_back( { headers.back().data(), headers.back().size() } );
+        for ( const auto& buf : frames[i].payload ) {
+          iovecs.push_back( { const_cast<char*>( buf.data() ), buf.size() } ); // NOLINT(*-const-cast)
+        }
+        messages[i].msg_hdr.msg_iovlen = 1 + frames[i].payload.size();
+      }
+
+      for ( size_t sent = 0; sent < messages.size(); ) {
+        sent += CheckSystemCall( "sendmmsg",
+                                 ::sendmmsg( sockets.first.fd_num(),
+                                             messages.data() + sent,
+                                             static_cast<unsigned int>( messages.size() - sent ),
+                                             0 ) );
+      }
+    }
   };
 
   shared_ptr<Sender> sender_ = make_shared<Sender>();
@@ -110,20 +160,27 @@ public:
   NetworkInterfaceAdapter( const Address& ip_address, const Address& next_hop ) // NOLINT(*-swappable-*)
     : _interface( "network interface adapter", sender_, random_host_ethernet_address(), ip_address )
     , _next_hop( next_hop )
-  {}
+  {
+    _interface.enable_reassembly();
+  }
 
   optional<TCPMessage> read()
   {
-    auto frame_opt = maybe_receive_frame( sender_->sockets.first );
-    if ( not frame_opt ) {
+    PacketBuffer frame;
+    frame.resize( sender_->sockets.first.read( frame.append( frame.tailroom() ) ) );
+    if ( frame.empty() ) {
       return {};
     }
-    EthernetFrame frame = move( frame_opt.value() );
 
     // Give the frame to the NetworkInterface. Get back an Internet datagram if frame was carrying one.
-    _interface.recv_frame( frame );
+    _interface.recv_frame( move( frame ) );
 
-    // Try to interpret IPv4 datagram as TCP
+    // Try to interpret IPv4 datagram as TCP (a whole one is still in its buffer; a reassembled one is parsed)
+    if ( not _interface.packets_received().empty() ) {
+      const NetworkInterface::ReceivedPacket received { move( _interface.packets_received().front() ) };
+      _interface.packets_received().pop();
+      return unwrap_tcp_in_ip( received.header, Parser { received.packet.view().substr( IPv4Header::LENGTH ) } );
+    }
     if ( _interface.datagrams_received().empty() ) {
       return {};
     }
@@ -132,7 +189,12 @@ public:
     _interface.datagrams_received().pop();
     return unwrap_tcp_in_ip( dgram );
   }
-  void write( const TCPMessage& msg ) { _interface.send_datagram( wrap_tcp_in_ip( msg ), _next_hop ); }
+  void write( const TCPMessage& msg )
+  {
+    PacketBuffer packet;
+    wrap_tcp_in_ip( msg, packet );
+    _interface.send_datagram( move( packet ), _next_hop );
+  }
   void tick( const size_t ms_since_last_tick ) { _interface.tick( ms_since_last_tick ); }
   NetworkInterface& interface() { return _interface; }
 
@@ -143,11 +205,13 @@ public:
 class TCPSocketEndToEnd : public TCPMinnowSocket<NetworkInterfaceAdapter>
 {
   Address _local_address;
+  TCPConfig _tcp_config;
 
 public:
-  TCPSocketEndToEnd( const Address& ip_address, const Address& next_hop )
+  TCPSocketEndToEnd( const Address& ip_address, const Address& next_hop, const TCPConfig& tcp_config )
     : TCPMinnowSocket<NetworkInterfaceAdapter>( NetworkInterfaceAdapter( ip_address, next_hop ) )
     , _local_address( ip_address )
+    , _tcp_config( tcp_config )
   {}
 
   void connect( const Address& address )
@@ -159,7 +223,7 @@ public:
     multiplexer_config.source = _local_address;
     multiplexer_config.destination = address;
 
-    TCPMinnowSocket<NetworkInterfaceAdapter>::connect( {}, multiplexer_config );
+    TCPMinnowSocket<NetworkInterfaceAdapter>::connect( _tcp_config, multiplexer_config );
   }
 
   void bind( const Address& address )
@@ -174,14 +238,18 @@ public:
   {
     FdAdapterConfig multiplexer_config;
     multiplexer_config.source = _local_address;
-    TCPMinnowSocket<NetworkInterfaceAdapter>::listen_and_accept( {}, multiplexer_config );
+    TCPMinnowSocket<NetworkInterfaceAdapter>::listen_and_accept( _tcp_config, multiplexer_config );
   }
 
   NetworkInterfaceAdapter& adapter() { return _datagram_adapter; }
 };
 
 // NOLINTBEGIN(*-cognitive-complexity)
-void program_body( bool is_client, const string& bounce_host, const string& bounce_port, const bool debug )
+void program_body( bool is_client,
+                   const string& bounce_host,
+                   const string& bounce_port,
+                   const bool debug,
+                   const bool pace )
 {
   class FramesOut : public NetworkInterface::OutputPort
   {
@@ -230,8 +298,11 @@ void program_body( bool is_client, const string& bounce_host, const string& boun
   }
 
   /* set up the client */
-  TCPSocketEndToEnd sock = is_client ? TCPSocketEndToEnd { Address { "192.168.0.50" }, Address { "192.168.0.1" } }
-                                     : TCPSocketEndToEnd { Address { "172.16.0.100" }, Address { "172.16.0.1" } };
+  TCPConfig tcp_config;
+  tcp_config.pacing = pace;
+  TCPSocketEndToEnd sock
+    = is_client ? TCPSocketEndToEnd { Address { "192.168.0.50" }, Address { "192.168.0.1" }, tcp_config }
+                : TCPSocketEndToEnd { Address { "172.16.0.100" }, Address { "172.16.0.1" }, tcp_config };
 
   atomic<bool> exit_flag {};
 
@@ -337,8 +408,8 @@ void program_body( bool is_client, const string& bounce_host, const string& boun
 
 void print_usage( const string& argv0 )
 {
-  cerr << "Usage: " << argv0 << " client HOST PORT [debug]\n";
-  cerr << "or     " << argv0 << " server HOST PORT [debug]\n";
+  cerr << "Usage: " << argv0 << " client HOST PORT [debug] [pace]\n";
+  cerr << "or     " << argv0 << " server HOST PORT [debug] [pace]\n";
 }
 
 int main( int argc, char* argv[] )
@@ -348,13 +419,16 @@ int main( int argc, char* argv[] )
       abort(); // For sticklers: don't try to access argv[0] if argc <= 0.
     }
 
+    // These tools narrate the connection (unless MINNOW_LOG_LEVEL says otherwise).
+    set_log_level( environment_log_level( LogLevel::Debug ) );
+
     auto args = span( argv, argc );
 
     if ( argc <= 0 ) {
       abort(); // For sticklers: don't try to access argv[0] if argc <= 0.
     }
 
-    if ( argc != 4 and argc != 5 ) {
+    if ( argc < 4 or argc > 6 ) {
       print_usage( args[0] );
       return EXIT_FAILURE;
     }
@@ -364,7 +438,20 @@ int main( int argc, char* argv[] )
       return EXIT_FAILURE;
     }
 
-    program_body( args[1] == "client"s, args[2], args[3], argc == 5 );
+    bool debug = false;
+    bool pace = false;
+    for ( const char* option : args.subspan( 4 ) ) {
+      if ( option == "debug"s ) {
+        debug = true;
+      } else if ( option == "pace"s ) {
+        pace = true;
+      } else {
+        print_usage( args[0] );
+        return EXIT_FAILURE;
+      }
+    }
+
+    program_body( args[1] == "client"s, args[2], args[3], debug, pace );
   } catch ( const exception& e ) {
     cerr << e.what() << "\n";
     return EXIT_FAILURE;
@@ -1,15 +1,24 @@
 #include "bidirectional_stream_copy.hh"
+#include "log.hh"
 #include "tcp_config.hh"
 #include "tcp_minnow_socket.hh"
+#include "trace.hh"
 #include "tun.hh"
 
+#include <chrono>
+#include <condition_variable>
 #include <cstdint>
 #include <cstdlib>
 #include <cstring>
+#include <fstream>
 #include <iostream>
+#include <memory>
+#include <mutex>
 #include <random>
 #include <span>
 #include <string>
+#include <stop_token>
+#include <thread>
 #include <tuple>
 
 using namespace std;
@@ -35,11 +44,18 @@ void show_usage( const char* argv0, const char* msg )
 
        << "   -t <tmout>      Set rt_timeout to tmout                         " << TCPConfig::TIMEOUT_DFLT << "\n\n"
 
-       << "   -d <tundev>     Connect to tun <tundev>                         " << TUN_DFLT << "\n\n"
+       << "   -N              Coalesce small writes (Nagle's algorithm).      (off)\n\n"
+
+       << "   -d <tundev>     Connect to tun <tundev>                         " << TUN_DFLT << "\n"
+       << "   -C              Trust TCP checksums (verified by the device).   (verify)\n\n"
 
        << "   -Lu <loss>      Set uplink loss to <rate> (float in 0..1)       (no loss)\n"
        << "   -Ld <loss>      Set downlink loss to <rate> (float in 0..1)     (no loss)\n\n"
 
+       << "   --stats         Print connection statistics every second.       (off)\n"
+       << "   --trace <file>  Write a binary event trace to <file> at exit.   (off)\n"
+       << "                   (Needs a build configured with -DMINNOW_TRACING=ON; see trace_dump.)\n\n"
+
        << "   -h              Show this message.\n\n";
 
   if ( msg != nullptr ) {
@@ -56,7 +72,7 @@ void check_argc( const span<char*>& args, size_t curr, const char* err )
   }
 }
 
-tuple<TCPConfig, FdAdapterConfig, bool, const char*> get_config( const span<char*>& args )
+tuple<TCPConfig, FdAdapterConfig, bool, const char*, bool, const char*> get_config( const span<char*>& args )
 {
   TCPConfig c_fsm {};
   c_fsm.isn = Wrap32 { random_device()() };
@@ -66,6 +82,8 @@ tuple<TCPConfig, FdAdapterConfig, bool, const char*> get_config( const span<char
 
   size_t curr = 1;
   bool listen = false;
+  bool stats = false;
+  const char* trace_file = nullptr;
   const size_t argc = args.size();
 
   string source_address = LOCAL_ADDRESS_DFLT;
@@ -96,11 +114,19 @@ tuple<TCPConfig, FdAdapterConfig, bool, const char*> get_config( const span<char
       c_fsm.rt_timeout = strtol( args[curr + 1], nullptr, 0 );
       curr += 2;
 
+    } else if ( strncmp( "-N", args[curr], 3 ) == 0 ) {
+      c_fsm.nagle = true;
+      curr += 1;
+
     } else if ( strncmp( "-d", args[curr], 3 ) == 0 ) {
       check_argc( args, curr, "ERROR: -t requires one argument." );
       tundev = args[curr + 1];
       curr += 2;
 
+    } else if ( strncmp( "-C", args[curr], 3 ) == 0 ) {
+      c_filt.trust_checksums = true;
+      curr += 1;
+
     } else if ( strncmp( "-Lu", args[curr], 3 ) == 0 ) {
       check_argc( args, curr, "ERROR: -Lu requires one argument." );
       const float lossrate = strtof( args[curr + 1], nullptr );
@@ -117,6 +143,19 @@ tuple<TCPConfig, FdAdapterConfig, bool, const char*> get_config( const span<char
         = static_cast<LossRateDnT>( static_cast<float>( numeric_limits<LossRateDnT>::max() ) * lossrate );
       curr += 2;
 
+    } else if ( strncmp( "--stats", args[curr], 8 ) == 0 ) {
+      stats = true;
+      curr += 1;
+
+    } else if ( strncmp( "--trace", args[curr], 8 ) == 0 ) {
+      check_argc( args, curr, "ERROR: --trace requires one argument." );
+      if ( not TRACING_ENABLED ) {
+        show_usage( args[0], "ERROR: --trace needs tracing compiled in (cmake -DMINNOW_TRACING=ON)." );
+        exit( 1 );
+      }
+      trace_file = args[curr + 1];
+      curr += 2;
+
     } else if ( strncmp( "-h", args[curr], 3 ) == 0 ) {
       show_usage( args[0], nullptr );
       exit( 0 );
@@ -139,7 +178,20 @@ tuple<TCPConfig, FdAdapterConfig, bool, const char*> get_config( const span<char
     c_filt.source = { source_address, source_port };
   }
 
-  return make_tuple( c_fsm, c_filt, listen, tundev );
+  return make_tuple( c_fsm, c_filt, listen, tundev, stats, trace_file );
+}
+
+// Print the connection's statistics every second, until the returned thread is destroyed
+jthread report_stats( shared_ptr<const TCPStats> stats )
+{
+  return jthread { [stats = move( stats )]( const stop_token& stop ) {
+    mutex mutex;
+    condition_variable_any wakeup;
+    unique_lock lock { mutex };
+    while ( not wakeup.wait_for( lock, stop, 1s, [&] { return stop.stop_requested(); } ) ) {
+      log_line<LogLevel::Info>( [&]( ostream& out ) { out << "minnow stats: " << stats->to_string(); } );
+    }
+  } };
 }
 } // namespace
 
@@ -150,6 +202,9 @@ int main( int argc, char** argv )
       abort(); // For sticklers: don't try to access argv[0] if argc <= 0.
     }
 
+    // These tools narrate the connection (unless MINNOW_LOG_LEVEL says otherwise).
+    set_log_level( environment_log_level( LogLevel::Debug ) );
+
     auto args = span( argv, argc );
 
     if ( argc < 3 ) {
@@ -157,7 +212,7 @@ int main( int argc, char** argv )
       return EXIT_FAILURE;
     }
 
-    auto [c_fsm, c_filt, listen, tun_dev_name] = get_config( args );
+    auto [c_fsm, c_filt, listen, tun_dev_name, stats, trace_file] = get_config( args );
     LossyTCPOverIPv4MinnowSocket tcp_socket( LossyFdAdapter<TCPOverIPv4OverTunFdAdapter>(
       TCPOverIPv4OverTunFdAdapter( TunFD( tun_dev_name == nullptr ? TUN_DFLT : tun_dev_name ) ) ) );
 
@@ -167,8 +222,26 @@ int main( int argc, char** argv )
       tcp_socket.connect( c_fsm, c_filt );
     }
 
+    jthread stats_reporter;
+    if ( stats ) {
+      stats_reporter = report_stats( tcp_socket.stats() );
+    }
+
     bidirectional_stream_copy( tcp_socket, tcp_socket.peer_address().to_string() );
     tcp_socket.wait_until_closed();
+
+    if ( stats ) {
+      stats_reporter = {};
+      log_line<LogLevel::Info>( [&]( ostream& out ) { out << "minnow stats: " << tcp_socket.stats()->to_string(); } );
+    }
+
+    if ( trace_file != nullptr ) {
+      ofstream out { trace_file, ios::binary };
+      write_traces( out );
+      if ( not out ) {
+        throw runtime_error( "could not write trace to " + string( trace_file ) );
+      }
+    }
   } catch ( const exception& e ) {
     cerr << "Exception: " << e.what() << endl;
     return EXIT_FAILURE;
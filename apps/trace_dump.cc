@@ -0,0 +1,136 @@
+#include "trace.hh"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <span>
+#include <string>
+#include <utility>
+#include <vector>
+
+using namespace std;
+
+namespace {
+
+// Every thread's records as one timeline: (thread, record), in order of time
+vector<pair<uint64_t, TraceRecord>> merge( const vector<ThreadTrace>& threads )
+{
+  vector<pair<uint64_t, TraceRecord>> events;
+  for ( const auto& thread : threads ) {
+    for ( const auto& record : thread.records ) {
+      events.emplace_back( thread.thread, record );
+    }
+  }
+  ranges::stable_sort( events, {}, []( const auto& event ) { return event.second.time_ns; } );
+  return events;
+}
+
+string event_name( TraceEvent event )
+{
+  switch ( event ) {
+    case TraceEvent::SegmentSent:
+      return "send";
+    case TraceEvent::SegmentReceived:
+      return "receive";
+    case TraceEvent::Ack:
+      return "ack";
+    case TraceEvent::Retransmit:
+      return "retransmit";
+    case TraceEvent::WindowChange:
+      return "window";
+    case TraceEvent::TimerFired:
+      return "timer";
+  }
+  return "unknown";
+}
+
+string flag_string( uint8_t flags )
+{
+  string str;
+  str += ( flags & TraceFlag::SYN ) ? "S" : "";
+  str += ( flags & TraceFlag::FIN ) ? "F" : "";
+  str += ( flags & TraceFlag::RST ) ? "R" : "";
+  str += ( flags & TraceFlag::ACK ) ? "A" : "";
+  return str;
+}
+
+// Microseconds since the first event
+double elapsed_us( const TraceRecord& record, uint64_t start_ns )
+{
+  return static_cast<double>( record.time_ns - start_ns ) / 1000;
+}
+
+void print_text( const vector<pair<uint64_t, TraceRecord>>& events )
+{
+  const uint64_t start_ns = events.empty() ? 0 : events.front().second.time_ns;
+  cout << fixed << setprecision( 3 );
+  for ( const auto& [thread, record] : events ) {
+    cout << setw( 14 ) << elapsed_us( record, start_ns ) << " us  thread " << thread << "  " << setw( 10 )
+         << event_name( record.event ) << "  seqno=" << record.seqno << " ackno=" << record.ackno
+         << " length=" << record.length << " window=" << record.window;
+    if ( record.flags != 0 ) {
+      cout << " flags=" << flag_string( record.flags );
+    }
+    cout << "\n";
+  }
+}
+
+// The Chrome trace event format (chrome://tracing, or ui.perfetto.dev): an instant event per record, and a
+// counter track for the peer's window
+void print_json( const vector<pair<uint64_t, TraceRecord>>& events )
+{
+  const uint64_t start_ns = events.empty() ? 0 : events.front().second.time_ns;
+  cout << fixed << setprecision( 3 ) << "{\"traceEvents\":[\n";
+  bool first = true;
+  for ( const auto& [thread, record] : events ) {
+    const double ts = elapsed_us( record, start_ns );
+    cout << ( first ? "" : ",\n" ) << R"({"name":")" << event_name( record.event )
+         << R"(","cat":"tcp","ph":"i","s":"t","pid":1,"tid":)" << thread << ",\"ts\":" << ts
+         << R"(,"args":{"seqno":)" << record.seqno << ",\"ackno\":" << record.ackno
+         << ",\"length\":" << record.length << ",\"window\":" << record.window << R"(,"flags":")"
+         << flag_string( record.flags ) << "\"}}";
+    if ( record.event == TraceEvent::WindowChange ) {
+      cout << ",\n"
+           << R"({"name":"peer window","ph":"C","pid":1,"tid":)" << thread << ",\"ts\":" << ts
+           << R"(,"args":{"bytes":)" << record.window << "}}";
+    }
+    first = false;
+  }
+  cout << "\n],\"displayTimeUnit\":\"ms\"}\n";
+}
+
+} // namespace
+
+int main( int argc, char* argv[] )
+{
+  try {
+    if ( argc <= 0 ) {
+      abort(); // For sticklers: don't try to access argv[0] if argc <= 0.
+    }
+
+    auto args = span( argv, argc );
+    const bool json = argc == 3 and strcmp( args[1], "--json" ) == 0;
+    if ( argc != 2 and not json ) {
+      cerr << "Usage: " << args.front() << " [--json] TRACE_FILE\n";
+      cerr << "\tPrints a trace written by tcp_ipv4 --trace as text, or as Chrome trace JSON.\n";
+      return EXIT_FAILURE;
+    }
+
+    ifstream in { args.back(), ios::binary };
+    if ( not in ) {
+      throw runtime_error( "could not open " + string( args.back() ) );
+    }
+
+    const auto events = merge( read_traces( in ) );
+    json ? print_json( events ) : print_text( events );
+  } catch ( const exception& e ) {
+    cerr << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
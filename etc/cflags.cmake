@@ -6,3 +6,13 @@ set(SANITIZING_FLAGS -fno-sanitize-recover=all -fsanitize=undefined -fsanitize=a
 # ask for more warnings from the compiler
 set (CMAKE_BASE_CXX_FLAGS "${CMAKE_CXX_FLAGS}")
 set (CMAKE_CXX_FLAGS "${CMAKE_CXX_FLAGS} -Wall -Wpedantic -Wextra -Weffc++ -Werror -Wshadow -Wpointer-arith -Wcast-qual -Wformat=2 -Wno-unqualified-std-cast-call -Wno-non-virtual-dtor")
+
+# compile in binary event tracing (util/trace.hh)
+option(MINNOW_TRACING "Record TCP events in per-thread trace buffers" OFF)
+if(MINNOW_TRACING)
+  add_compile_definitions(MINNOW_TRACING=1)
+endif()
+
+# compile out log messages below a level (0 trace, 1 debug, 2 info, 3 warning, 4 error; see util/log.hh)
+set(MINNOW_MIN_LOG_LEVEL 0 CACHE STRING "Lowest log level compiled in")
+add_compile_definitions(MINNOW_MIN_LOG_LEVEL=${MINNOW_MIN_LOG_LEVEL})
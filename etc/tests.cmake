@@ -26,6 +26,7 @@ ttest(byte_stream_one_write)
 ttest(byte_stream_two_writes)
 ttest(byte_stream_many_writes)
 ttest(byte_stream_stress_test)
+ttest(byte_stream_retain)
 
 ttest(reassembler_single)
 ttest(reassembler_cap)
@@ -56,10 +57,22 @@ ttest(send_window)
 ttest(send_ack)
 ttest(send_close)
 ttest(send_extra)
+ttest(send_nagle)
+ttest(send_pacing)
+ttest(send_stats)
+
+ttest(peer_delayed_ack)
+ttest(trace_roundtrip)
+ttest(packet_buffer)
 
 ttest(net_interface)
+ttest(net_fragments)
+ttest(net_emulator)
+ttest(tcp_over_ip_padding)
 
 ttest(router)
+ttest(router_table)
+ttest(router_egress)
 
 add_custom_target (check0 COMMAND ${CMAKE_CTEST_COMMAND} --output-on-failure --stop-on-failure --timeout 12 -R 'webget|^byte_stream_')
 
@@ -94,4 +107,9 @@ set_property(TEST ${compile_name_opt} PROPERTY TIMEOUT 0)
 set_tests_properties(${compile_name_opt} PROPERTIES FIXTURES_SETUP compile_opt)
 
 stest(byte_stream_speed_test)
+stest(wrapping_integers_speed_test)
 stest(reassembler_speed_test)
+stest(sender_speed_test)
+stest(packet_buffer_speed_test)
+stest(router_speed_test)
+stest(tcp_loopback_speed_test)
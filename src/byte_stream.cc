@@ -23,7 +23,7 @@ void Writer::push( string data )
   total_pushed_ += data.size();
   total_buffered_ += data.size();
 
-  stream_.emplace( move( data ) );
+  stream_.emplace_back( make_shared<string>( move( data ) ) );
 }
 
 void Writer::close()
@@ -53,26 +53,95 @@ uint64_t Reader::bytes_popped() const
 
 string_view Reader::peek() const
 {
-  return stream_.empty() ? string_view {} // std::string_view dependents on the initializer through its lifetime.
-                         : string_view { stream_.front() }.substr( removed_prefix_ );
+  // std::string_view dependents on the initializer through its lifetime.
+  return read_chunk_ == stream_.size() ? string_view {} : string_view { *stream_[read_chunk_] }.substr( read_prefix_ );
+}
+
+SharedString Reader::peek_shared() const
+{
+  if ( read_chunk_ == stream_.size() ) {
+    return {};
+  }
+  const auto& chunk { stream_[read_chunk_] };
+  return { chunk, read_prefix_, chunk->size() - read_prefix_ };
 }
 
 void Reader::pop( uint64_t len )
 {
   total_buffered_ -= len;
   total_popped_ += len;
+  total_retained_ += len;
   while ( len != 0U ) {
-    const uint64_t& size { stream_.front().size() - removed_prefix_ };
+    const uint64_t& size { stream_[read_chunk_]->size() - read_prefix_ };
+    if ( len < size ) {
+      read_prefix_ += len;
+      break; // with len = 0;
+    }
+    read_chunk_ += 1;
+    read_prefix_ = 0;
+    len -= size;
+  }
+  if ( not retain_ ) {
+    release( total_retained_ );
+  }
+}
+
+void Reader::set_retain( bool retain )
+{
+  retain_ = retain;
+  if ( not retain_ ) {
+    release( total_retained_ );
+  }
+}
+
+SharedString Reader::peek_retained( uint64_t offset ) const
+{
+  const uint64_t index { front_index_ + removed_prefix_ + offset };
+  if ( index < peek_chunk_index_ ) {
+    peek_chunk_ = 0; // behind the cursor: start again from the oldest chunk
+    peek_chunk_index_ = front_index_;
+  }
+  while ( peek_chunk_ <= read_chunk_ and peek_chunk_ < stream_.size() ) {
+    const uint64_t end { peek_chunk_ == read_chunk_ ? read_prefix_ : stream_[peek_chunk_]->size() };
+    if ( index - peek_chunk_index_ < end ) {
+      return { stream_[peek_chunk_], index - peek_chunk_index_, end - ( index - peek_chunk_index_ ) };
+    }
+    if ( peek_chunk_ == read_chunk_ ) {
+      break; // not popped yet
+    }
+    peek_chunk_index_ += stream_[peek_chunk_]->size();
+    ++peek_chunk_;
+  }
+  return {};
+}
+
+void Reader::release( uint64_t len )
+{
+  total_retained_ -= len;
+  while ( len != 0U ) {
+    const uint64_t& size { stream_.front()->size() - removed_prefix_ };
     if ( len < size ) {
       removed_prefix_ += len;
       break; // with len = 0;
     }
-    stream_.pop();
+    front_index_ += stream_.front()->size();
+    stream_.pop_front();
+    read_chunk_ -= 1;
     removed_prefix_ = 0;
+    if ( peek_chunk_ == 0 ) {
+      peek_chunk_index_ = front_index_;
+    } else {
+      --peek_chunk_;
+    }
     len -= size;
   }
 }
 
+uint64_t Reader::bytes_retained() const
+{
+  return total_retained_;
+}
+
 uint64_t Reader::bytes_buffered() const
 {
   return total_buffered_;
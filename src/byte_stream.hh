@@ -1,7 +1,10 @@
 #pragma once
 
+#include "shared_string.hh"
+
 #include <cstdint>
-#include <queue>
+#include <deque>
+#include <memory>
 #include <string>
 #include <string_view>
 
@@ -24,8 +27,19 @@ public:
 
 protected:
   // Please add any additional state to the ByteStream here, and not to the Writer and Reader interfaces.
-  std::queue<std::string> stream_ {};
+  // stream_ = [ retained bytes | buffered bytes ], the read cursor sits at stream_[read_chunk_][read_prefix_]
+  std::deque<std::shared_ptr<std::string>> stream_ {};
   uint64_t removed_prefix_ {};
+  uint64_t read_chunk_ {};
+  uint64_t read_prefix_ {};
+
+  bool retain_ {};
+  uint64_t total_retained_ {};
+  uint64_t front_index_ {}; // stream index of stream_.front()'s first byte (released or not)
+  // peek_retained() carries on from the chunk it last looked in (stream_[peek_chunk_], starting at stream index
+  // peek_chunk_index_), so walking through the retained bytes in order costs O(1) a peek
+  mutable uint64_t peek_chunk_ {};
+  mutable uint64_t peek_chunk_index_ {};
 
   uint64_t capacity_;
   uint64_t total_popped_ {};
@@ -50,12 +64,23 @@ public:
 class Reader : public ByteStream
 {
 public:
-  std::string_view peek() const; // Peek at the next bytes in the buffer
+  std::string_view peek() const;  // Peek at the next bytes in the buffer
+  SharedString peek_shared() const; // Same as peek(), but the result shares ownership of the bytes
   void pop( uint64_t len );      // Remove `len` bytes from the buffer
 
   bool is_finished() const;        // Is the stream finished (closed and fully popped)?
   uint64_t bytes_buffered() const; // Number of bytes currently buffered (pushed and not popped)
   uint64_t bytes_popped() const;   // Total number of bytes cumulatively popped from stream
+
+  // Popped bytes can stay in place (e.g. until the peer acknowledges them) instead of being discarded.
+  // Retained bytes don't count against the stream's capacity. Peeking at them in order (or close to the last
+  // peek) is O(1); going back to an earlier offset walks the chunks from the oldest again. Only release() trims
+  // them: the TCPSender releases a segment's bytes once it is acknowledged in full, so the bytes of a partly
+  // acknowledged segment stay retained (and are sent again whole) until the rest is acknowledged.
+  void set_retain( bool retain );                          // Keep popped bytes until release()d
+  SharedString peek_retained( uint64_t offset ) const;     // Peek at retained bytes, `offset` from the oldest
+  void release( uint64_t len );                            // Discard the `len` oldest retained bytes
+  uint64_t bytes_retained() const;                         // Number of bytes popped and not yet released
 };
 
 /*
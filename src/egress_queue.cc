@@ -0,0 +1,209 @@
+#include "egress_queue.hh"
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+
+using namespace std;
+
+void EgressQueue::push( FlowQueue& flow, QueuedDatagram&& item )
+{
+  flow.bytes += item.size;
+  bytes_ += item.size;
+  ++packets_;
+  ++stats_.enqueued;
+  flow.items.push_back( move( item ) );
+}
+
+QueuedDatagram EgressQueue::pop( FlowQueue& flow )
+{
+  QueuedDatagram item { move( flow.items.front() ) };
+  flow.items.pop_front();
+  flow.bytes -= item.size;
+  bytes_ -= item.size;
+  --packets_;
+  return item;
+}
+
+QueuedDatagram EgressQueue::sent( QueuedDatagram&& item, uint64_t now_ms )
+{
+  const uint64_t sojourn_ms { now_ms - item.enqueue_ms };
+  ++stats_.dequeued;
+  stats_.sojourn_total_ms += sojourn_ms;
+  stats_.sojourn_max_ms = max( stats_.sojourn_max_ms, sojourn_ms );
+  stats_.sojourn_last_ms = sojourn_ms;
+  return move( item );
+}
+
+// The dequeue side of RFC 8289's pseudocode
+optional<QueuedDatagram> EgressQueue::codel_dequeue( FlowQueue& flow, const CoDelConfig& config, uint64_t now_ms )
+{
+  // Pop the head, and say whether it has stood above target for long enough to be dropped
+  const auto pop_head = [&]() -> pair<optional<QueuedDatagram>, bool> {
+    if ( flow.items.empty() ) {
+      flow.first_above_ms = 0;
+      return { nullopt, false };
+    }
+    QueuedDatagram item { pop( flow ) };
+    bool ok_to_drop { false };
+    if ( now_ms - item.enqueue_ms < config.target_ms or flow.bytes <= config.mtu_bytes ) {
+      flow.first_above_ms = 0;
+    } else if ( flow.first_above_ms == 0 ) {
+      flow.first_above_ms = now_ms + config.interval_ms;
+    } else {
+      ok_to_drop = now_ms >= flow.first_above_ms;
+    }
+    return { move( item ), ok_to_drop };
+  };
+  // Drops come closer together the longer the queue stays above target: interval / sqrt( count )
+  const auto control_law = [&]( uint64_t t ) {
+    const double spacing { static_cast<double>( config.interval_ms ) / sqrt( max<uint32_t>( flow.count, 1 ) ) };
+    return t + static_cast<uint64_t>( spacing );
+  };
+
+  auto [item, ok_to_drop] = pop_head();
+  if ( flow.dropping ) {
+    if ( not ok_to_drop ) {
+      flow.dropping = false;
+    }
+    while ( flow.dropping and now_ms >= flow.drop_next_ms ) {
+      ++stats_.dropped_aqm;
+      ++flow.count;
+      tie( item, ok_to_drop ) = pop_head();
+      if ( not ok_to_drop ) {
+        flow.dropping = false;
+      } else {
+        flow.drop_next_ms = control_law( flow.drop_next_ms );
+      }
+    }
+  } else if ( ok_to_drop ) {
+    ++stats_.dropped_aqm;
+    tie( item, ok_to_drop ) = pop_head();
+    flow.dropping = true;
+    // Resume near the previous drop rate if the last dropping state ended only recently
+    const uint32_t delta { flow.count - flow.last_count };
+    const auto since_last_drop = static_cast<int64_t>( now_ms - flow.drop_next_ms );
+    flow.count = ( delta > 1 and since_last_drop < static_cast<int64_t>( 16 * config.interval_ms ) ) ? delta : 1;
+    flow.drop_next_ms = control_law( now_ms );
+    flow.last_count = flow.count;
+  }
+
+  if ( not item.has_value() ) {
+    return nullopt;
+  }
+  return sent( move( *item ), now_ms );
+}
+
+void FIFOQueue::enqueue( QueuedDatagram&& item )
+{
+  if ( full_for( item.size ) ) {
+    ++stats_.dropped_overflow;
+    return;
+  }
+  push( queue_, move( item ) );
+}
+
+optional<QueuedDatagram> FIFOQueue::dequeue( uint64_t now_ms )
+{
+  if ( queue_.items.empty() ) {
+    return nullopt;
+  }
+  return sent( pop( queue_ ), now_ms );
+}
+
+void CoDelQueue::enqueue( QueuedDatagram&& item )
+{
+  if ( full_for( item.size ) ) {
+    ++stats_.dropped_overflow;
+    return;
+  }
+  push( queue_, move( item ) );
+}
+
+optional<QueuedDatagram> CoDelQueue::dequeue( uint64_t now_ms )
+{
+  return codel_dequeue( queue_, config_, now_ms );
+}
+
+FQCoDelQueue::FQCoDelQueue( const EgressLimits& limits, const FQCoDelConfig& config )
+  : EgressQueue( limits )
+  , config_( config )
+  , perturbation_( config.perturbation.has_value() ? config.perturbation.value() : random_device()() )
+  , flows_( max<size_t>( config.flows, 1 ) )
+{}
+
+// Hash the addresses, protocol and (for TCP and UDP) ports
+size_t FQCoDelQueue::flow_of( const InternetDatagram& dgram ) const
+{
+  constexpr uint8_t PROTO_UDP { 17 };
+  uint64_t key { ( uint64_t { dgram.header.src } << 32 | dgram.header.dst ) ^ perturbation_ };
+  uint32_t ports {};
+  if ( ( dgram.header.proto == IPv4Header::PROTO_TCP or dgram.header.proto == PROTO_UDP )
+       and not dgram.payload.empty() and dgram.payload.front().size() >= 4 ) {
+    for ( size_t i = 0; i < 4; ++i ) {
+      ports = ports << 8 | static_cast<uint8_t>( dgram.payload.front()[i] );
+    }
+  }
+  key = ( key ^ ( uint64_t { ports } << 8 | dgram.header.proto ) ) * 0x9E37'79B9'7F4A'7C15ULL;
+  return ( key >> 32 ) % flows_.size();
+}
+
+void FQCoDelQueue::enqueue( QueuedDatagram&& item )
+{
+  if ( item.size > limits_.bytes or limits_.packets == 0 ) {
+    ++stats_.dropped_overflow;
+    return;
+  }
+
+  // Make room by dropping from the head of the longest queue (which may be this datagram's own)
+  while ( full_for( item.size ) ) {
+    FlowQueue& fattest
+      = *ranges::max_element( flows_, {}, []( const FlowQueue& flow ) { return flow.bytes; } );
+    pop( fattest );
+    ++stats_.dropped_overflow;
+  }
+
+  const size_t index { flow_of( item.dgram ) };
+  FlowQueue& flow { flows_[index] };
+  push( flow, move( item ) );
+  if ( not flow.listed ) {
+    flow.listed = true;
+    flow.deficit = static_cast<int64_t>( config_.quantum_bytes );
+    new_flows_.push_back( index );
+  }
+}
+
+optional<QueuedDatagram> FQCoDelQueue::dequeue( uint64_t now_ms )
+{
+  while ( not new_flows_.empty() or not old_flows_.empty() ) {
+    const bool from_new { not new_flows_.empty() };
+    deque<size_t>& list { from_new ? new_flows_ : old_flows_ };
+    const size_t index { list.front() };
+    FlowQueue& flow { flows_[index] };
+
+    if ( flow.deficit <= 0 ) {
+      // Its round is over: it goes to the back of the old flows with a fresh quantum
+      flow.deficit += static_cast<int64_t>( config_.quantum_bytes );
+      list.pop_front();
+      old_flows_.push_back( index );
+      continue;
+    }
+
+    auto item = codel_dequeue( flow, config_.codel, now_ms );
+    if ( not item.has_value() ) {
+      // An emptied new flow waits a round among the old ones (even when there are none), so it can't jump the
+      // queue again at once (RFC 8290, section 4.2)
+      list.pop_front();
+      if ( from_new ) {
+        old_flows_.push_back( index );
+      } else {
+        flow.listed = false;
+      }
+      continue;
+    }
+
+    flow.deficit -= static_cast<int64_t>( item->size );
+    return item;
+  }
+  return nullopt;
+}
@@ -0,0 +1,162 @@
+#pragma once
+
+#include "ipv4_datagram.hh"
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <optional>
+#include <vector>
+
+// A datagram waiting to leave an interface
+struct QueuedDatagram
+{
+  InternetDatagram dgram {};
+  uint32_t next_hop {};   // numeric IPv4 address
+  uint64_t enqueue_ms {}; // when it joined the queue
+  size_t size {};         // serialized length in bytes
+};
+
+// How much an egress queue may hold
+struct EgressLimits
+{
+  size_t packets { 1000 };
+  size_t bytes { 1024 * 1024 };
+};
+
+// CoDel's settings (RFC 8289): drop when the shortest sojourn time over an interval stays above the target
+struct CoDelConfig
+{
+  uint64_t target_ms { 5 };
+  uint64_t interval_ms { 100 };
+  size_t mtu_bytes { 1500 }; // never drop when no more than this is queued
+};
+
+// What an egress queue has done
+struct EgressStats
+{
+  uint64_t enqueued {};
+  uint64_t dequeued {};
+  uint64_t dropped_overflow {}; // to stay within the limits
+  uint64_t dropped_aqm {};      // by CoDel, for standing in the queue too long
+
+  // Time spent in the queue by dequeued datagrams
+  uint64_t sojourn_total_ms {};
+  uint64_t sojourn_max_ms {};
+  uint64_t sojourn_last_ms {};
+
+  double mean_sojourn_ms() const
+  {
+    return dequeued == 0 ? 0 : static_cast<double>( sojourn_total_ms ) / static_cast<double>( dequeued );
+  }
+};
+
+// A queue discipline for the datagrams waiting to leave an interface
+class EgressQueue
+{
+public:
+  explicit EgressQueue( const EgressLimits& limits ) : limits_( limits ) {}
+  virtual ~EgressQueue() = default;
+
+  // Add a datagram (dropping it, or others, to stay within the limits)
+  virtual void enqueue( QueuedDatagram&& item ) = 0;
+
+  // The next datagram to send at `now_ms`, if any (the discipline may drop others first)
+  virtual std::optional<QueuedDatagram> dequeue( uint64_t now_ms ) = 0;
+
+  size_t packets() const { return packets_; }
+  size_t bytes() const { return bytes_; }
+  const EgressStats& stats() const { return stats_; }
+
+protected:
+  // A FIFO of datagrams, with CoDel's state for it
+  struct FlowQueue
+  {
+    std::deque<QueuedDatagram> items {};
+    size_t bytes {};
+
+    uint64_t first_above_ms {}; // when the sojourn time will have been above target for an interval (0: it isn't)
+    uint64_t drop_next_ms {};   // when to drop next, while dropping
+    uint32_t count {};          // drops since entering the dropping state
+    uint32_t last_count {};     // count when the dropping state was last left
+    bool dropping {};
+
+    int64_t deficit {}; // FQ-CoDel: bytes this flow may still send in its round
+    bool listed {};     // FQ-CoDel: on the new or old flows list
+  };
+
+  EgressLimits limits_;
+  EgressStats stats_ {};
+  size_t packets_ {};
+  size_t bytes_ {};
+
+  bool full_for( size_t size ) const { return packets_ + 1 > limits_.packets or bytes_ + size > limits_.bytes; }
+
+  void push( FlowQueue& flow, QueuedDatagram&& item );
+  QueuedDatagram pop( FlowQueue& flow );
+
+  // Account for a datagram leaving the queue to be sent
+  QueuedDatagram sent( QueuedDatagram&& item, uint64_t now_ms );
+
+  // The next datagram from `flow` that CoDel lets through at `now_ms`, dropping from its head as needed
+  std::optional<QueuedDatagram> codel_dequeue( FlowQueue& flow, const CoDelConfig& config, uint64_t now_ms );
+};
+
+// First in, first out, dropping arrivals once full
+class FIFOQueue : public EgressQueue
+{
+public:
+  explicit FIFOQueue( const EgressLimits& limits = {} ) : EgressQueue( limits ) {}
+
+  void enqueue( QueuedDatagram&& item ) override;
+  std::optional<QueuedDatagram> dequeue( uint64_t now_ms ) override;
+
+private:
+  FlowQueue queue_ {};
+};
+
+// A single queue managed by CoDel (RFC 8289), dropping arrivals once full
+class CoDelQueue : public EgressQueue
+{
+public:
+  explicit CoDelQueue( const EgressLimits& limits = {}, const CoDelConfig& config = {} )
+    : EgressQueue( limits ), config_( config )
+  {}
+
+  void enqueue( QueuedDatagram&& item ) override;
+  std::optional<QueuedDatagram> dequeue( uint64_t now_ms ) override;
+
+private:
+  CoDelConfig config_;
+  FlowQueue queue_ {};
+};
+
+// FQ-CoDel's settings (RFC 8290)
+struct FQCoDelConfig
+{
+  size_t flows { 1024 };         // queues that flows are hashed into
+  size_t quantum_bytes { 1514 }; // bytes each flow may send per round
+  CoDelConfig codel {};
+  std::optional<uint64_t> perturbation {}; // salts the flow hash (default: a random salt)
+};
+
+// Flows hashed (by addresses, protocol and ports) into separate CoDel queues, served by deficit round robin
+// with new flows first (RFC 8290). Once full, drops from the head of the longest queue.
+class FQCoDelQueue : public EgressQueue
+{
+public:
+  explicit FQCoDelQueue( const EgressLimits& limits = {}, const FQCoDelConfig& config = {} );
+
+  void enqueue( QueuedDatagram&& item ) override;
+  std::optional<QueuedDatagram> dequeue( uint64_t now_ms ) override;
+
+  // The queue a datagram's flow is hashed into (exposed for tests)
+  size_t flow_of( const InternetDatagram& dgram ) const;
+
+private:
+  FQCoDelConfig config_;
+  uint64_t perturbation_; // salts the flow hash
+  std::vector<FlowQueue> flows_;
+  std::deque<size_t> new_flows_ {};
+  std::deque<size_t> old_flows_ {};
+};
@@ -4,16 +4,35 @@
 #include "ethernet_frame.hh"
 #include "ethernet_header.hh"
 #include "exception.hh"
+#include "fragment_reassembler.hh"
 #include "ipv4_datagram.hh"
+#include "log.hh"
 #include "parser.hh"
 
-#include <iostream>
+#include <deque>
+#include <iterator>
+#include <optional>
+#include <ostream>
 #include <ranges>
+#include <span>
 #include <utility>
 #include <vector>
 
 using namespace std;
 
+namespace {
+
+size_t serialized_size( const InternetDatagram& dgram )
+{
+  size_t size { IPv4Header::LENGTH };
+  for ( const auto& buf : dgram.payload ) {
+    size += buf.size();
+  }
+  return size;
+}
+
+} // namespace
+
 auto NetworkInterface::make_arp( const uint16_t opcode,
                                  const EthernetAddress& target_ethernet_address,
                                  const uint32_t target_ip_address ) const noexcept -> ARPMessage
@@ -38,8 +57,10 @@ NetworkInterface::NetworkInterface( string_view name,
   , ethernet_address_( ethernet_address )
   , ip_address_( ip_address )
 {
-  cerr << "DEBUG: Network interface has Ethernet address " << to_string( ethernet_address ) << " and IP address "
-       << ip_address.ip() << "\n";
+  log_line<LogLevel::Debug>( [&]( ostream& out ) {
+    out << "Network interface has Ethernet address " << to_string( ethernet_address ) << " and IP address "
+        << ip_address.ip();
+  } );
 }
 
 //! \param[in] dgram the IPv4 datagram to be sent
@@ -48,18 +69,121 @@ NetworkInterface::NetworkInterface( string_view name,
 //! can be converted to a uint32_t (raw 32-bit IP address) by using the Address::ipv4_numeric() method.
 void NetworkInterface::send_datagram( const InternetDatagram& dgram, const Address& next_hop )
 {
+  if ( serialized_size( dgram ) > mtu_ ) {
+    return send_fragments( InternetDatagram { dgram }, next_hop );
+  }
+  const AddressNumeric next_hop_numeric { next_hop.ipv4_numeric() };
+  if ( const auto next_hop_eth = resolve( next_hop_numeric ) ) {
+    return transmit( { { *next_hop_eth, ethernet_address_, EthernetHeader::TYPE_IPv4 }, serialize( dgram ) } );
+  }
+  queue_datagram( InternetDatagram { dgram }, next_hop_numeric );
+}
+
+void NetworkInterface::send_datagram( InternetDatagram&& dgram, const Address& next_hop )
+{
+  if ( serialized_size( dgram ) > mtu_ ) {
+    return send_fragments( move( dgram ), next_hop );
+  }
   const AddressNumeric next_hop_numeric { next_hop.ipv4_numeric() };
-  if ( ARP_cache_.contains( next_hop_numeric ) ) {
-    const EthernetAddress& dst { ARP_cache_[next_hop_numeric].first };
-    return transmit( { { dst, ethernet_address_, EthernetHeader::TYPE_IPv4 }, serialize( dgram ) } );
+  if ( const auto next_hop_eth = resolve( next_hop_numeric ) ) {
+    return transmit( { { *next_hop_eth, ethernet_address_, EthernetHeader::TYPE_IPv4 }, serialize( dgram ) } );
   }
-  dgrams_waitting_[next_hop_numeric].emplace_back( dgram );
-  if ( waitting_timer_.contains( next_hop_numeric ) ) {
+  queue_datagram( move( dgram ), next_hop_numeric );
+}
+
+void NetworkInterface::send_fragments( InternetDatagram&& dgram, const Address& next_hop )
+{
+  vector<InternetDatagram> fragments { fragment_datagram( move( dgram ), mtu_ ) };
+  if ( fragments.empty() ) {
+    ++fragmentation_stats_.dropped_dont_fragment;
+    return;
+  }
+  ++fragmentation_stats_.fragmented;
+  fragmentation_stats_.fragments += fragments.size();
+  for ( auto& fragment : fragments ) {
+    send_datagram( move( fragment ), next_hop );
+  }
+}
+
+void NetworkInterface::set_pending_limits( size_t neighbour_budget_bytes,
+                                           size_t total_budget_bytes,
+                                           DropPolicy policy )
+{
+  pending_neighbour_budget_ = neighbour_budget_bytes;
+  pending_total_budget_ = total_budget_bytes;
+  pending_policy_ = policy;
+}
+
+void NetworkInterface::queue_datagram( InternetDatagram&& dgram, AddressNumeric next_hop )
+{
+  auto [pending, inserted] = pending_.try_emplace( next_hop );
+  if ( inserted ) {
+    pending.expiry_ms = current_time_ms_ + ARP_RESPONSE_TTL_ms;
+    pending_expiry_.emplace( pending.expiry_ms, next_hop );
+  }
+
+  const size_t size { serialized_size( dgram ) };
+  const bool fits_now { pending.bytes + size <= pending_neighbour_budget_
+                        and pending_bytes_ + size <= pending_total_budget_ };
+  // Drop-oldest can only make room in this next hop's own queue: if emptying it would not be enough (because
+  // of the other next hops' datagrams), the new datagram is dropped and the queue left alone.
+  const bool fits_after_drops { pending_policy_ == DropPolicy::DropOldest and size <= pending_neighbour_budget_
+                                and pending_bytes_ - pending.bytes + size <= pending_total_budget_ };
+  const bool fits { fits_now or fits_after_drops };
+  while ( fits
+          and ( pending.bytes + size > pending_neighbour_budget_ or pending_bytes_ + size > pending_total_budget_ ) ) {
+    const size_t oldest_size { serialized_size( pending.datagrams.front() ) };
+    pending.bytes -= oldest_size;
+    pending_bytes_ -= oldest_size;
+    pending.datagrams.pop_front();
+    ++pending_drops_.overflow;
+  }
+
+  if ( fits ) {
+    pending.bytes += size;
+    pending_bytes_ += size;
+    pending.datagrams.push_back( move( dgram ) );
+  } else {
+    ++pending_drops_.overflow;
+  }
+
+  // Ask last: the reply may arrive (and flush the queue) before transmit() returns.
+  if ( inserted ) {
+    const ARPMessage arp_request { make_arp( ARPMessage::OPCODE_REQUEST, {}, next_hop ) };
+    transmit( { { ETHERNET_BROADCAST, ethernet_address_, EthernetHeader::TYPE_ARP }, serialize( arp_request ) } );
+  }
+}
+
+void NetworkInterface::OutputPort::transmit_packet( const NetworkInterface& sender, PacketBuffer&& packet )
+{
+  EthernetFrame frame;
+  if ( parse( frame, packet.view() ) ) {
+    transmit( sender, frame );
+  }
+}
+
+void NetworkInterface::OutputPort::transmit_batch( const NetworkInterface& sender, span<const EthernetFrame> frames )
+{
+  for ( const auto& frame : frames ) {
+    transmit( sender, frame );
+  }
+}
+
+//! \param[in] dgram the IPv4 datagram to be sent, serialized with room for an Ethernet header in front
+//! \param[in] next_hop the IP address of the interface to send it to
+void NetworkInterface::send_datagram( PacketBuffer&& dgram, const Address& next_hop )
+{
+  const auto next_hop_eth = dgram.size() <= mtu_ ? resolve( next_hop.ipv4_numeric() ) : nullopt;
+  if ( not next_hop_eth ) {
+    // Slow path: the datagram has to wait for an ARP reply (or be fragmented), in its parsed form.
+    InternetDatagram parsed;
+    if ( parse( parsed, dgram.view() ) ) {
+      send_datagram( move( parsed ), next_hop );
+    }
     return;
   }
-  waitting_timer_.emplace( next_hop_numeric, NetworkInterface::Timer {} );
-  const ARPMessage arp_request { make_arp( ARPMessage::OPCODE_REQUEST, {}, next_hop_numeric ) };
-  transmit( { { ETHERNET_BROADCAST, ethernet_address_, EthernetHeader::TYPE_ARP }, serialize( arp_request ) } );
+  dgram.prepend_header( EthernetHeader { *next_hop_eth, ethernet_address_, EthernetHeader::TYPE_IPv4 } );
+  port_->transmit_packet( *this, move( dgram ) );
 }
 
 //! \param[in] frame the incoming Ethernet frame
@@ -72,43 +196,141 @@ void NetworkInterface::recv_frame( const EthernetFrame& frame )
   if ( frame.header.type == EthernetHeader::TYPE_IPv4 ) {
     InternetDatagram ipv4_datagram;
     if ( parse( ipv4_datagram, frame.payload ) ) {
-      datagrams_received_.emplace( move( ipv4_datagram ) );
+      deliver( move( ipv4_datagram ) );
     }
     return;
   }
 
   if ( frame.header.type == EthernetHeader::TYPE_ARP ) {
     ARPMessage msg;
-    if ( not parse( msg, frame.payload ) ) {
+    if ( parse( msg, frame.payload ) ) {
+      recv_arp( msg );
+    }
+  }
+}
+
+//! \param[in] frame the incoming Ethernet frame, in a packet buffer
+void NetworkInterface::recv_frame( PacketBuffer&& frame )
+{
+  EthernetHeader header {};
+  if ( not parse( header, frame.view() ) ) {
+    return;
+  }
+  if ( header.dst != ethernet_address_ and header.dst != ETHERNET_BROADCAST ) {
+    return;
+  }
+  frame.remove_prefix( EthernetHeader::LENGTH );
+
+  if ( header.type == EthernetHeader::TYPE_IPv4 ) {
+    // A whole datagram with a plain header is passed up in its buffer, less any padding the link added
+    IPv4Header ip_header;
+    if ( parse( ip_header, frame.view() ) and ip_header.hlen * 4 == IPv4Header::LENGTH and not ip_header.mf
+         and ip_header.offset == 0 and ip_header.len >= IPv4Header::LENGTH and ip_header.len <= frame.size() ) {
+      frame.resize( ip_header.len );
+      packets_received_.push( { ip_header, move( frame ) } );
       return;
     }
 
-    const AddressNumeric sender_ip { msg.sender_ip_address };
-    const EthernetAddress sender_eth { msg.sender_ethernet_address };
-    ARP_cache_[sender_ip] = { sender_eth, Timer {} };
+    InternetDatagram ipv4_datagram;
+    if ( parse( ipv4_datagram, frame.view() ) ) {
+      deliver( move( ipv4_datagram ) );
+    }
+    return;
+  }
 
-    if ( msg.opcode == ARPMessage::OPCODE_REQUEST and msg.target_ip_address == ip_address_.ipv4_numeric() ) {
-      const ARPMessage arp_reply { make_arp( ARPMessage::OPCODE_REPLY, sender_eth, sender_ip ) };
-      transmit( { { sender_eth, ethernet_address_, EthernetHeader::TYPE_ARP }, serialize( arp_reply ) } );
+  if ( header.type == EthernetHeader::TYPE_ARP ) {
+    ARPMessage msg;
+    if ( parse( msg, frame.view() ) ) {
+      recv_arp( msg );
     }
-    if ( dgrams_waitting_.contains( sender_ip ) ) {
-      for ( const auto& dgram : dgrams_waitting_[sender_ip] ) {
-        transmit( { { sender_eth, ethernet_address_, EthernetHeader::TYPE_IPv4 }, serialize( dgram ) } );
-      }
-      dgrams_waitting_.erase( sender_ip );
-      waitting_timer_.erase( sender_ip );
+  }
+}
+
+void NetworkInterface::deliver( InternetDatagram&& dgram )
+{
+  if ( not reassembler_.has_value() ) {
+    datagrams_received_.emplace( move( dgram ) );
+  } else if ( auto whole = reassembler_->push( move( dgram ) ) ) {
+    datagrams_received_.emplace( move( *whole ) );
+  }
+}
+
+void NetworkInterface::recv_arp( const ARPMessage& msg )
+{
+  const AddressNumeric sender_ip { msg.sender_ip_address };
+  const EthernetAddress sender_eth { msg.sender_ethernet_address };
+  auto [entry, inserted] = ARP_cache_.try_emplace( sender_ip );
+  entry = { sender_eth, current_time_ms_ + ARP_ENTRY_TTL_ms };
+  if ( inserted ) {
+    ARP_cache_expiry_.emplace( entry.expiry_ms, sender_ip );
+  }
+
+  if ( msg.opcode == ARPMessage::OPCODE_REQUEST and msg.target_ip_address == ip_address_.ipv4_numeric() ) {
+    const ARPMessage arp_reply { make_arp( ARPMessage::OPCODE_REPLY, sender_eth, sender_ip ) };
+    transmit( { { sender_eth, ethernet_address_, EthernetHeader::TYPE_ARP }, serialize( arp_reply ) } );
+  }
+  if ( PendingNeighbour* pending = pending_.find( sender_ip ) ) {
+    // Take the queue out of the table first: transmitting may call back into this interface.
+    deque<InternetDatagram> datagrams { move( pending->datagrams ) };
+    pending_bytes_ -= pending->bytes;
+    pending_.erase( sender_ip );
+
+    // Send the whole queue as one burst, behind one Ethernet header. Each datagram's payload buffers are moved
+    // into its frame; only the IPv4 header is serialized.
+    const EthernetHeader header { sender_eth, ethernet_address_, EthernetHeader::TYPE_IPv4 };
+    vector<EthernetFrame> frames;
+    frames.reserve( datagrams.size() );
+    for ( auto& dgram : datagrams ) {
+      EthernetFrame& frame = frames.emplace_back( header, serialize( dgram.header ) );
+      ranges::move( dgram.payload, back_inserter( frame.payload ) );
     }
+    port_->transmit_batch( *this, frames );
   }
 }
 
+optional<EthernetAddress> NetworkInterface::resolve( AddressNumeric ip )
+{
+  ARPEntry* entry = ARP_cache_.find( ip );
+  if ( not entry or entry->expiry_ms <= current_time_ms_ ) {
+    return {};
+  }
+  const EthernetAddress ethernet_address { entry->ethernet_address };
+
+  if ( not entry->refreshing and entry->expiry_ms - current_time_ms_ < ARP_REFRESH_WINDOW_ms ) {
+    entry->refreshing = true; // before transmitting: the reply may arrive before transmit() returns
+    const ARPMessage arp_request { make_arp( ARPMessage::OPCODE_REQUEST, {}, ip ) };
+    transmit( { { ethernet_address, ethernet_address_, EthernetHeader::TYPE_ARP }, serialize( arp_request ) } );
+  }
+  return ethernet_address;
+}
+
 //! \param[in] ms_since_last_tick the number of milliseconds since the last call to this method
 void NetworkInterface::tick( const size_t ms_since_last_tick )
 {
-  erase_if( ARP_cache_, [&]( auto&& item ) noexcept -> bool {
-    return item.second.second.tick( ms_since_last_tick ).expired( ARP_ENTRY_TTL_ms );
-  } );
+  current_time_ms_ += ms_since_last_tick;
+  if ( reassembler_.has_value() ) {
+    reassembler_->tick( ms_since_last_tick );
+  }
 
-  erase_if( waitting_timer_, [&]( auto&& item ) noexcept -> bool {
-    return item.second.tick( ms_since_last_tick ).expired( ARP_RESPONSE_TTL_ms );
-  } );
+  while ( not ARP_cache_expiry_.empty() and ARP_cache_expiry_.top().first <= current_time_ms_ ) {
+    const AddressNumeric ip { ARP_cache_expiry_.top().second };
+    ARP_cache_expiry_.pop();
+    const ARPEntry* entry = ARP_cache_.find( ip );
+    if ( entry == nullptr or entry->expiry_ms <= current_time_ms_ ) {
+      ARP_cache_.erase( ip );
+    } else {
+      ARP_cache_expiry_.emplace( entry->expiry_ms, ip ); // refreshed since it was queued
+    }
+  }
+
+  while ( not pending_expiry_.empty() and pending_expiry_.top().first <= current_time_ms_ ) {
+    const AddressNumeric ip { pending_expiry_.top().second };
+    pending_expiry_.pop();
+    // The request may have been answered (and another one sent) since this record was queued.
+    if ( const PendingNeighbour* pending = pending_.find( ip ); pending and pending->expiry_ms <= current_time_ms_ ) {
+      pending_drops_.expired += pending->datagrams.size();
+      pending_bytes_ -= pending->bytes;
+      pending_.erase( ip );
+    }
+  }
 }
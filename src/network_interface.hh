@@ -1,15 +1,22 @@
 #pragma once
 
 #include "address.hh"
+#include "address_map.hh"
 #include "arp_message.hh"
 #include "ethernet_frame.hh"
 #include "ethernet_header.hh"
+#include "fragment_reassembler.hh"
 #include "ipv4_datagram.hh"
+#include "packet_buffer.hh"
 
 #include <cstddef>
 #include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <optional>
 #include <queue>
-#include <unordered_map>
+#include <span>
 #include <utility>
 #include <vector>
 
@@ -42,6 +49,15 @@ public:
   {
   public:
     virtual void transmit( const NetworkInterface& sender, const EthernetFrame& frame ) = 0;
+
+    // Transmit a frame already serialized into a packet buffer. Ports that write frames out as bytes should
+    // override this to send packet.view() directly; by default it is parsed back into an EthernetFrame.
+    virtual void transmit_packet( const NetworkInterface& sender, PacketBuffer&& packet );
+
+    // Transmit a burst of frames (e.g. the datagrams that were waiting for an ARP reply). Ports backed by a
+    // file descriptor can override this to send them with one system call; by default each is transmitted.
+    virtual void transmit_batch( const NetworkInterface& sender, std::span<const EthernetFrame> frames );
+
     virtual ~OutputPort() = default;
   };
 
@@ -57,21 +73,79 @@ public:
   // hop. Sending is accomplished by calling `transmit()` (a member variable) on the frame.
   void send_datagram( const InternetDatagram& dgram, const Address& next_hop );
 
+  // Same, but a datagram that has to wait for ARP is moved into the pending queue rather than copied
+  void send_datagram( InternetDatagram&& dgram, const Address& next_hop );
+
+  // Same, for a datagram already serialized into a packet buffer: the Ethernet header is prepended in place.
+  void send_datagram( PacketBuffer&& dgram, const Address& next_hop );
+
   // Receives an Ethernet frame and responds appropriately.
   // If type is IPv4, pushes the datagram to the datagrams_in queue.
   // If type is ARP request, learn a mapping from the "sender" fields, and send an ARP reply.
   // If type is ARP reply, learn a mapping from the "sender" fields.
   void recv_frame( const EthernetFrame& frame );
 
+  // Same, for a frame read into a packet buffer: the Ethernet header is checked and stripped in place, and an
+  // IPv4 datagram stays in the buffer (see packets_received()) unless it has to be parsed.
+  void recv_frame( PacketBuffer&& frame );
+
   // Called periodically when time elapses
   void tick( size_t ms_since_last_tick );
 
+  // What to do with a datagram that would take a pending queue (datagrams waiting for an ARP reply) over budget
+  enum class DropPolicy
+  {
+    DropTail,  //!< Drop the new datagram.
+    DropOldest //!< Drop the oldest datagrams waiting for the same next hop to make room for it.
+  };
+
+  // Bound the bytes of datagrams waiting for each next hop, and for all of them together. Whatever the policy,
+  // a datagram that cannot fit even in an empty queue is dropped.
+  void set_pending_limits( size_t neighbour_budget_bytes, size_t total_budget_bytes, DropPolicy policy );
+
+  // Datagrams dropped from the pending queues
+  struct PendingDrops
+  {
+    uint64_t overflow {}; // to stay within budget
+    uint64_t expired {};  // because the ARP request for their next hop went unanswered
+  };
+  const PendingDrops& pending_drops() const { return pending_drops_; }
+
+  // The largest datagram sent in one frame (by default, Ethernet's 1500 bytes); larger ones are fragmented, or
+  // dropped if they have DF set
+  void set_mtu( size_t mtu ) { mtu_ = mtu; }
+  size_t mtu() const { return mtu_; }
+
+  // Datagrams that were too big for the MTU
+  struct FragmentationStats
+  {
+    uint64_t fragmented {};            // datagrams split up
+    uint64_t fragments {};             // fragments made of them
+    uint64_t dropped_dont_fragment {}; // datagrams dropped instead, since they had DF set
+  };
+  const FragmentationStats& fragmentation_stats() const { return fragmentation_stats_; }
+
+  // Put fragments back together before passing datagrams up (as a host should; a router passes them on as they
+  // are, which is the default)
+  void enable_reassembly( const FragmentLimits& limits = {} ) { reassembler_.emplace( limits ); }
+  const std::optional<FragmentReassembler>& reassembler() const { return reassembler_; }
+
   // Accessors
   const std::string& name() const { return name_; }
   const OutputPort& output() const { return *port_; }
   OutputPort& output() { return *port_; }
   std::queue<InternetDatagram>& datagrams_received() { return datagrams_received_; }
 
+  // A datagram received into a packet buffer and left there, serialized, with a parsed copy of its header. Only
+  // whole datagrams with a plain 20-byte header arrive this way; fragments and datagrams with options are parsed
+  // into datagrams_received().
+  struct ReceivedPacket
+  {
+    IPv4Header header;
+    PacketBuffer packet;
+  };
+  std::queue<ReceivedPacket>& packets_received() { return packets_received_; }
+
 private:
   // Human-readable name of the interface
   std::string name_;
@@ -86,23 +160,78 @@ private:
   // IP (known as internet-layer or network-layer) address of the interface
   Address ip_address_;
 
-  // Datagrams that have been received
+  // Datagrams that have been received (parsed, or still in the packet buffers they arrived in)
   std::queue<InternetDatagram> datagrams_received_ {};
+  std::queue<ReceivedPacket> packets_received_ {};
+
+  static constexpr size_t ETHERNET_MTU { 1500 };
+  size_t mtu_ { ETHERNET_MTU };
+  FragmentationStats fragmentation_stats_ {};
+  std::optional<FragmentReassembler> reassembler_ {};
+
+  // Send a datagram too big for the MTU as fragments
+  void send_fragments( InternetDatagram&& dgram, const Address& next_hop );
+
+  // Pass a received datagram up (once whole, if reassembling)
+  void deliver( InternetDatagram&& dgram );
 
   auto make_arp( uint16_t, const EthernetAddress&, uint32_t ) const noexcept -> ARPMessage;
 
+  // Learn from an ARP message, reply to requests for our address, and send datagrams that were waiting for it
+  void recv_arp( const ARPMessage& msg );
+
   static constexpr size_t ARP_ENTRY_TTL_ms { 30'000 };
+  static constexpr size_t PENDING_NEIGHBOUR_BUDGET_DFLT { 64 * 1024 };
+  static constexpr size_t PENDING_TOTAL_BUDGET_DFLT { 1024 * 1024 };
   static constexpr size_t ARP_RESPONSE_TTL_ms { 5'000 };
 
-  struct Timer
+  // An entry used with less than this long to live is refreshed (so a refresh has as long to be answered as an
+  // ordinary request)
+  static constexpr size_t ARP_REFRESH_WINDOW_ms { ARP_RESPONSE_TTL_ms };
+
+  // Milliseconds since the interface was created; entries store the absolute time at which they expire
+  uint64_t current_time_ms_ {};
+
+  using AddressNumeric = decltype( ip_address_.ipv4_numeric() );
+
+  struct ARPEntry
   {
-    size_t _ms {};
-    constexpr Timer& tick( const size_t& ms_since_last_tick ) noexcept { return _ms += ms_since_last_tick, *this; }
-    [[nodiscard]] constexpr bool expired( const size_t& TTL_ms ) const noexcept { return _ms >= TTL_ms; }
+    EthernetAddress ethernet_address {};
+    uint64_t expiry_ms {};
+    bool refreshing {}; // a unicast request to confirm it has been sent
   };
 
-  using AddressNumeric = decltype( ip_address_.ipv4_numeric() );
-  std::unordered_map<AddressNumeric, std::vector<InternetDatagram>> dgrams_waitting_ {};
-  std::unordered_map<AddressNumeric, Timer> waitting_timer_ {};
-  std::unordered_map<AddressNumeric, std::pair<EthernetAddress, Timer>> ARP_cache_ {};
+  // Expiry records, soonest first: each holds the expiry time its entry had when the record was pushed, so
+  // tick() only looks at records that are due, and erases an entry as soon as it expires. A record whose entry
+  // has been refreshed since is pushed again at the new time; one whose entry is gone (or replaced) is skipped.
+  using ExpiryQueue = std::priority_queue<std::pair<uint64_t, AddressNumeric>,
+                                          std::vector<std::pair<uint64_t, AddressNumeric>>,
+                                          std::greater<>>;
+
+  AddressMap<ARPEntry> ARP_cache_ {};
+  ExpiryQueue ARP_cache_expiry_ {};
+
+  // An outstanding ARP request, and the datagrams waiting for its reply (dropped if it expires unanswered)
+  struct PendingNeighbour
+  {
+    uint64_t expiry_ms {};
+    std::deque<InternetDatagram> datagrams {};
+    size_t bytes {};
+  };
+  AddressMap<PendingNeighbour> pending_ {};
+  ExpiryQueue pending_expiry_ {};
+
+  size_t pending_neighbour_budget_ { PENDING_NEIGHBOUR_BUDGET_DFLT };
+  size_t pending_total_budget_ { PENDING_TOTAL_BUDGET_DFLT };
+  DropPolicy pending_policy_ { DropPolicy::DropTail };
+  size_t pending_bytes_ {};
+  PendingDrops pending_drops_ {};
+
+  // Queue a datagram until the next hop's Ethernet address is known (asking for it if nobody has yet)
+  void queue_datagram( InternetDatagram&& dgram, AddressNumeric next_hop );
+
+  // The Ethernet address for an IP address, if its ARP cache entry has not expired. An entry that is about to
+  // expire keeps being used while a unicast request asks its owner to confirm it; only if that goes unanswered
+  // does the entry expire, and later datagrams wait for a broadcast request.
+  std::optional<EthernetAddress> resolve( AddressNumeric ip );
 };
@@ -38,6 +38,9 @@ void Reassembler::insert( uint64_t first_index, string data, bool is_last_substr
   }
 
   if ( writer().is_closed() or writer().available_capacity() == 0U ) {
+    if ( stats_ ) {
+      ( writer().is_closed() ? stats_->duplicate_bytes : stats_->beyond_window_bytes ).add( size( data ) );
+    }
     return;
   }
 
@@ -45,13 +48,23 @@ void Reassembler::insert( uint64_t first_index, string data, bool is_last_substr
   const uint64_t unassembled_index { writer().bytes_pushed() };
   const uint64_t unacceptable_index { unassembled_index + writer().available_capacity() };
   if ( first_index + size( data ) <= unassembled_index or first_index >= unacceptable_index ) {
+    if ( stats_ ) {
+      ( first_index >= unacceptable_index ? stats_->beyond_window_bytes : stats_->duplicate_bytes )
+        .add( size( data ) );
+    }
     return; // Out of ranger
   }
   if ( first_index + size( data ) > unacceptable_index ) { // Remove unacceptable bytes
+    if ( stats_ ) {
+      stats_->beyond_window_bytes.add( first_index + size( data ) - unacceptable_index );
+    }
     data.resize( unacceptable_index - first_index );
     is_last_substring = false;
   }
   if ( first_index < unassembled_index ) { // Remove poped/buffered bytes
+    if ( stats_ ) {
+      stats_->duplicate_bytes.add( unassembled_index - first_index );
+    }
     data.erase( 0, unassembled_index - first_index );
     first_index = unassembled_index;
   }
@@ -63,8 +76,16 @@ void Reassembler::insert( uint64_t first_index, string data, bool is_last_substr
   // Can be optimizated !!!
   const auto upper { split( first_index + size( data ) ) };
   const auto lower { split( first_index ) };
+  const uint64_t pending_before { total_pending_ };
   ranges::for_each( ranges::subrange( lower, upper ) | views::values,
                     [&]( const auto& str ) { total_pending_ -= str.size(); } );
+  if ( stats_ ) {
+    // Bytes already waiting in this range are duplicates; new bytes ahead of a gap have to wait
+    stats_->duplicate_bytes.add( pending_before - total_pending_ );
+    if ( first_index > unassembled_index ) {
+      stats_->out_of_order_bytes.add( size( data ) - ( pending_before - total_pending_ ) );
+    }
+  }
   total_pending_ += size( data );
   buf_.emplace_hint( buf_.erase( lower, upper ), first_index, move( data ) );
 
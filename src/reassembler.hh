@@ -1,9 +1,11 @@
 #pragma once
 
 #include "byte_stream.hh"
+#include "tcp_stats.hh"
 
 #include <cstdint>
 #include <map>
+#include <memory>
 #include <optional>
 
 class Reassembler
@@ -37,6 +39,9 @@ public:
   // How many bytes are stored in the Reassembler itself?
   uint64_t bytes_pending() const;
 
+  // Count duplicate, out-of-order and beyond-window bytes in `stats` (if not null)
+  void set_stats( std::shared_ptr<TCPStats> stats ) { stats_ = std::move( stats ); }
+
   // Access output stream reader
   Reader& reader() { return output_.reader(); }
   const Reader& reader() const { return output_.reader(); }
@@ -52,5 +57,7 @@ private:
 
   std::optional<uint64_t> end_index_ {};
 
+  std::shared_ptr<TCPStats> stats_ {};
+
   auto split( uint64_t pos ) noexcept;
 };
@@ -1,10 +1,17 @@
 #include "router.hh"
+#include "log.hh"
+#include "mapped_file.hh"
 
+#include <algorithm>
 #include <bit>
 #include <cstddef>
-#include <iostream>
+#include <cstring>
+#include <fstream>
+#include <mutex>
 #include <optional>
+#include <ostream>
 #include <ranges>
+#include <stdexcept>
 
 using namespace std;
 
@@ -19,16 +26,205 @@ void Router::add_route( const uint32_t route_prefix,
                         const optional<Address> next_hop,
                         const size_t interface_num )
 {
-  cerr << "DEBUG: adding route " << Address::from_ipv4_numeric( route_prefix ).ip() << "/"
-       << static_cast<int>( prefix_length ) << " => " << ( next_hop.has_value() ? next_hop->ip() : "(direct)" )
-       << " on interface " << interface_num << "\n";
+  log_line<LogLevel::Debug>( [&]( ostream& out ) {
+    out << "adding route " << Address::from_ipv4_numeric( route_prefix ).ip() << "/"
+        << static_cast<int>( prefix_length ) << " => " << ( next_hop.has_value() ? next_hop->ip() : "(direct)" )
+        << " on interface " << interface_num;
+  } );
 
-  routing_table_[prefix_length][rotr( route_prefix, 32 - prefix_length )] = { interface_num, next_hop };
+  // Staged in a private copy of the table, so that adding many routes one by one copies the table only once
+  const lock_guard guard { table_writer_ };
+  if ( not staged_table_ ) {
+    staged_table_ = make_shared<RoutingTable>( *routing_table_.load() );
+  }
+  insert_route( *staged_table_, route_prefix, prefix_length, next_hop, interface_num );
+  routes_staged_.store( true, memory_order_release );
+}
+
+void Router::publish_staged_routes() const
+{
+  if ( not routes_staged_.load( memory_order_acquire ) ) {
+    return;
+  }
+  const lock_guard guard { table_writer_ };
+  if ( staged_table_ ) {
+    routing_table_.store( move( staged_table_ ) );
+    staged_table_.reset();
+    routes_staged_.store( false, memory_order_release );
+    table_changed();
+  }
+}
+
+void Router::insert_route( RoutingTable& table,
+                           const uint32_t route_prefix,
+                           const uint8_t prefix_length,
+                           const optional<Address> next_hop,
+                           const size_t interface_num )
+{
+  if ( prefix_length >= table.size() ) {
+    throw runtime_error( "route prefix length " + to_string( prefix_length ) + " is out of range" );
+  }
+  table[prefix_length][rotr( route_prefix, 32 - prefix_length )] = { interface_num, next_hop };
+}
+
+// Size each prefix length's map once, then insert every route
+void Router::load_routes( span<const Route> routes )
+{
+  auto table = make_shared<RoutingTable>();
+  array<size_t, tuple_size_v<RoutingTable>> counts {};
+  for ( const auto& route : routes ) {
+    counts.at( min<size_t>( route.prefix_length, counts.size() - 1 ) ) += 1;
+  }
+  for ( size_t length = 0; length < counts.size(); ++length ) {
+    ( *table )[length].reserve( counts[length] );
+  }
+  for ( const auto& route : routes ) {
+    insert_route( *table, route.prefix, route.prefix_length, route.next_hop, route.interface_num );
+  }
+  const lock_guard guard { table_writer_ };
+  discard_staged_routes();
+  routing_table_.store( move( table ) );
+  table_changed();
+}
+
+void Router::apply_routes( const RouteDiff& diff )
+{
+  const lock_guard guard { table_writer_ }; // so concurrent changes are applied one after the other
+  // (on top of any routes add_route() has staged)
+  auto table = staged_table_ ? move( staged_table_ ) : make_shared<RoutingTable>( *routing_table_.load() );
+  discard_staged_routes();
+  for ( const auto& [prefix, prefix_length] : diff.remove ) {
+    if ( prefix_length < table->size() ) {
+      ( *table )[prefix_length].erase( rotr( prefix, 32 - prefix_length ) );
+    }
+  }
+  for ( const auto& route : diff.add ) {
+    insert_route( *table, route.prefix, route.prefix_length, route.next_hop, route.interface_num );
+  }
+  routing_table_.store( move( table ) );
+  table_changed();
+}
+
+vector<Router::Route> Router::routes() const
+{
+  publish_staged_routes();
+  const shared_ptr<const RoutingTable> table = routing_table_.load();
+  vector<Route> routes;
+  for ( uint8_t length = 0; length < table->size(); ++length ) {
+    const size_t first = routes.size();
+    for ( const auto& [key, route] : ( *table )[length] ) {
+      routes.push_back( { rotl( key, 32 - length ), length, route.second, route.first } );
+    }
+    sort( routes.begin() + first, routes.end(), []( const Route& a, const Route& b ) { return a.prefix < b.prefix; } );
+  }
+  return routes;
+}
+
+namespace {
+
+// Snapshot file: the magic number, the number of routes of each prefix length, then a RouteRecord per route,
+// sorted by prefix length and then prefix. All in host byte order, to be mapped and read in place.
+constexpr array<char, 8> SNAPSHOT_MAGIC { 'M', 'N', 'R', 'O', 'U', 'T', 'E', '2' };
+
+struct RouteRecord
+{
+  uint32_t prefix;
+  uint32_t next_hop; // valid if has_next_hop
+  uint16_t interface_num;
+  uint8_t prefix_length;
+  uint8_t has_next_hop;
+};
+static_assert( sizeof( RouteRecord ) == 12 );
+
+} // namespace
+
+void Router::save_snapshot( const string& path ) const
+{
+  const vector<Route> all_routes = routes();
+  array<uint32_t, tuple_size_v<RoutingTable>> counts {};
+  vector<RouteRecord> records;
+  records.reserve( all_routes.size() );
+  for ( const auto& route : all_routes ) {
+    if ( route.interface_num > UINT16_MAX ) {
+      throw runtime_error( "snapshot cannot record interface " + to_string( route.interface_num ) );
+    }
+    counts.at( route.prefix_length ) += 1;
+    records.push_back( { route.prefix,
+                         route.next_hop.has_value() ? route.next_hop->ipv4_numeric() : 0,
+                         static_cast<uint16_t>( route.interface_num ),
+                         route.prefix_length,
+                         route.next_hop.has_value() } );
+  }
+
+  ofstream out { path, ios::binary | ios::trunc };
+  out.write( SNAPSHOT_MAGIC.data(), SNAPSHOT_MAGIC.size() );
+  out.write( reinterpret_cast<const char*>( counts.data() ), sizeof( counts ) ); // NOLINT(*-reinterpret-cast)
+  out.write( reinterpret_cast<const char*>( records.data() ), // NOLINT(*-reinterpret-cast)
+             static_cast<streamsize>( records.size() * sizeof( RouteRecord ) ) );
+  if ( not out.flush() ) {
+    throw runtime_error( "could not write route snapshot to " + path );
+  }
+}
+
+// One pass over the mapped records, into maps sized from the header
+void Router::load_snapshot( const string& path )
+{
+  const MappedFile file { path };
+  span<const char> data = file.data();
+
+  array<uint32_t, tuple_size_v<RoutingTable>> counts {};
+  if ( data.size() < SNAPSHOT_MAGIC.size() + sizeof( counts )
+       or not equal( SNAPSHOT_MAGIC.begin(), SNAPSHOT_MAGIC.end(), data.begin() ) ) {
+    throw runtime_error( path + " is not a route snapshot" );
+  }
+  memcpy( counts.data(), data.data() + SNAPSHOT_MAGIC.size(), sizeof( counts ) );
+  data = data.subspan( SNAPSHOT_MAGIC.size() + sizeof( counts ) );
+
+  uint64_t total = 0;
+  for ( const uint32_t count : counts ) {
+    total += count;
+  }
+  if ( data.size() != total * sizeof( RouteRecord ) ) {
+    throw runtime_error( path + " is truncated" );
+  }
+
+  auto table = make_shared<RoutingTable>();
+  for ( size_t length = 0; length < counts.size(); ++length ) {
+    ( *table )[length].reserve( counts[length] );
+  }
+  for ( size_t offset = 0; offset < data.size(); offset += sizeof( RouteRecord ) ) {
+    RouteRecord record {};
+    memcpy( &record, data.data() + offset, sizeof( record ) );
+    insert_route( *table,
+                  record.prefix,
+                  record.prefix_length,
+                  record.has_next_hop ? Address::from_ipv4_numeric( record.next_hop ) : optional<Address> {},
+                  record.interface_num );
+  }
+  const lock_guard guard { table_writer_ };
+  discard_staged_routes();
+  routing_table_.store( move( table ) );
+  table_changed();
+}
+
+void Router::set_route_cache( size_t entries )
+{
+  const size_t ways = tuple_size_v<decltype( RouteCacheSet::ways )>;
+  route_cache_.assign( entries == 0 ? 0 : bit_ceil( ( entries + ways - 1 ) / ways ), {} );
+  route_cache_stats_ = {};
 }
 
 // Go through all the interfaces, and route every incoming datagram to its proper outgoing interface.
 void Router::route()
 {
+  // Hold the table for the whole pass, in case apply_routes() swaps in another meanwhile. The generation is read
+  // first: a cache entry can be stamped with a generation older than its table, but never newer.
+  publish_staged_routes();
+  const uint32_t generation = generation_.load( memory_order_acquire );
+  const shared_ptr<const RoutingTable> table = routing_table_.load();
+  const auto lookup = [&]( uint32_t dst ) {
+    return route_cache_.empty() ? match( *table, dst ) : cached_match( *table, generation, dst );
+  };
   for ( const auto& interface : _interfaces ) {
     auto&& datagrams_received { interface->datagrams_received() };
     while ( not datagrams_received.empty() ) {
@@ -41,21 +237,157 @@ void Router::route()
       datagram.header.ttl -= 1;
       datagram.header.compute_checksum();
 
-      const optional<info>& mp { match( datagram.header.dst ) };
+      const optional<info>& mp { lookup( datagram.header.dst ) };
       if ( not mp.has_value() ) {
         continue;
       }
       const auto& [num, next_hop] { mp.value() };
-      _interfaces[num]->send_datagram( datagram,
-                                       next_hop.value_or( Address::from_ipv4_numeric( datagram.header.dst ) ) );
+      const Address next { next_hop.value_or( Address::from_ipv4_numeric( datagram.header.dst ) ) };
+      forward( num, move( datagram ), next );
     }
+
+    // Datagrams still in the packet buffers they arrived in: the header is rewritten in place
+    auto&& packets_received { interface->packets_received() };
+    while ( not packets_received.empty() ) {
+      auto [header, packet] { move( packets_received.front() ) };
+      packets_received.pop();
+
+      if ( header.ttl <= 1 ) {
+        continue;
+      }
+      header.ttl -= 1;
+      header.compute_checksum();
+      packet.remove_prefix( IPv4Header::LENGTH );
+      packet.prepend_header( header );
+
+      const optional<info>& mp { lookup( header.dst ) };
+      if ( not mp.has_value() ) {
+        continue;
+      }
+      const auto& [num, next_hop] { mp.value() };
+      const Address next { next_hop.value_or( Address::from_ipv4_numeric( header.dst ) ) };
+      forward( num, move( packet ), next );
+    }
+  }
+
+  for ( size_t i = 0; i < egress_.size(); ++i ) {
+    drain( i );
+  }
+}
+
+void Router::set_egress_queue( size_t interface_num, unique_ptr<EgressQueue> queue, uint64_t rate_bps )
+{
+  if ( interface_num >= _interfaces.size() ) {
+    throw runtime_error( "set_egress_queue: no interface " + to_string( interface_num ) );
+  }
+  if ( egress_.size() <= interface_num ) {
+    egress_.resize( interface_num + 1 );
+  }
+  egress_[interface_num] = { move( queue ), rate_bps, 0 };
+}
+
+const EgressQueue* Router::egress_queue( size_t interface_num ) const
+{
+  return interface_num < egress_.size() ? egress_[interface_num].queue.get() : nullptr;
+}
+
+void Router::forward( size_t interface_num, InternetDatagram&& datagram, const Address& next_hop )
+{
+  if ( interface_num >= egress_.size() or not egress_[interface_num].queue ) {
+    return _interfaces[interface_num]->send_datagram( move( datagram ), next_hop );
   }
+  const size_t size { datagram.header.len };
+  egress_[interface_num].queue->enqueue( { move( datagram ), next_hop.ipv4_numeric(), current_time_ms_, size } );
 }
 
-[[nodiscard]] auto Router::match( uint32_t addr ) const noexcept -> optional<info>
+// Without an egress queue, the packet is sent on in its buffer. Egress queues hold parsed datagrams, so one
+// queued for a rate-limited interface is copied out of its buffer here.
+void Router::forward( size_t interface_num, PacketBuffer&& packet, const Address& next_hop )
 {
-  auto adaptor = views::filter( [&addr]( const auto& mp ) { return mp.contains( addr >>= 1 ); } )
-                 | views::transform( [&addr]( const auto& mp ) -> info { return mp.at( addr ); } );
-  auto res { routing_table_ | views::reverse | adaptor | views::take( 1 ) }; // just kidding
-  return res.empty() ? nullopt : optional<info> { res.front() };
+  if ( interface_num >= egress_.size() or not egress_[interface_num].queue ) {
+    return _interfaces[interface_num]->send_datagram( move( packet ), next_hop );
+  }
+  InternetDatagram datagram;
+  if ( parse( datagram, packet.view() ) ) {
+    forward( interface_num, move( datagram ), next_hop );
+  }
+}
+
+void Router::drain( size_t interface_num )
+{
+  EgressPort& port { egress_[interface_num] };
+  if ( not port.queue ) {
+    return;
+  }
+  while ( port.rate_bps == 0 or port.credit_bytes > 0 ) {
+    auto item = port.queue->dequeue( current_time_ms_ );
+    if ( not item.has_value() ) {
+      break;
+    }
+    port.credit_bytes -= static_cast<int64_t>( item->size );
+    _interfaces[interface_num]->send_datagram( move( item->dgram ), Address::from_ipv4_numeric( item->next_hop ) );
+  }
+}
+
+void Router::tick( uint64_t ms_since_last_tick )
+{
+  current_time_ms_ += ms_since_last_tick;
+  for ( size_t i = 0; i < egress_.size(); ++i ) {
+    EgressPort& port { egress_[i] };
+    if ( not port.queue ) {
+      continue;
+    }
+    // An idle port may save up a little credit, for a burst of arrivals; a busy one pays off what it overdrew
+    const auto burst = static_cast<int64_t>( max<uint64_t>( port.rate_bps / 8000, 1514 ) );
+    const auto earned = static_cast<int64_t>( port.rate_bps * ms_since_last_tick / 8000 );
+    port.credit_bytes = min( port.credit_bytes + earned, burst );
+    drain( i );
+  }
+}
+
+[[nodiscard]] auto Router::match( const RoutingTable& table, uint32_t addr ) noexcept -> optional<info>
+{
+  // Longest prefix first: a host route (/32) is keyed by the whole address, and each shorter prefix by one bit
+  // fewer of it (down to /0, keyed by 0)
+  for ( size_t length = table.size(); length-- > 0; ) {
+    const uint32_t key { length == 0 ? 0 : addr >> ( 32 - length ) };
+    if ( const auto it = table[length].find( key ); it != table[length].end() ) {
+      return it->second;
+    }
+  }
+  return nullopt;
+}
+
+// Look up `addr` in the route cache, falling back to match() (and caching its answer, including "no route")
+auto Router::cached_match( const RoutingTable& table, uint32_t generation, uint32_t addr ) -> optional<info>
+{
+  // Fibonacci hashing: the top bits of the product pick the set, and spread neighbouring addresses
+  const uint64_t hash { static_cast<uint32_t>( addr * 0x9E37'79B9U ) };
+  auto& ways = route_cache_[hash >> ( 32 - countr_zero( route_cache_.size() ) )].ways;
+
+  const auto hit = ranges::find_if(
+    ways, [&]( const RouteCacheEntry& e ) { return e.generation == generation and e.destination == addr; } );
+  if ( hit == ways.end() ) {
+    ++route_cache_stats_.misses;
+    const optional<info> result { match( table, addr ) };
+    if ( result.has_value() and result->first > UINT16_MAX ) {
+      return result; // can't be cached
+    }
+    shift_right( ways.begin(), ways.end(), 1 ); // evict the least recently used
+    ways.front() = { addr,
+                     generation,
+                     result.has_value() and result->second.has_value() ? result->second->ipv4_numeric() : 0,
+                     static_cast<uint16_t>( result.has_value() ? result->first : 0 ),
+                     result.has_value(),
+                     result.has_value() and result->second.has_value() };
+    return result;
+  }
+  ++route_cache_stats_.hits;
+  rotate( ways.begin(), hit, hit + 1 ); // move to the front
+  const RouteCacheEntry& entry = ways.front();
+  if ( not entry.has_route ) {
+    return nullopt;
+  }
+  return info { entry.interface_num,
+                entry.has_next_hop ? Address::from_ipv4_numeric( entry.next_hop ) : optional<Address> {} };
 }
@@ -1,13 +1,18 @@
 #pragma once
 
 #include "address.hh"
+#include "egress_queue.hh"
 #include "exception.hh"
 #include "network_interface.hh"
 
 #include <array>
+#include <atomic>
 #include <cstdint>
 #include <memory>
+#include <mutex>
 #include <optional>
+#include <span>
+#include <string>
 #include <unordered_map>
 #include <utility>
 #include <vector>
@@ -29,21 +34,144 @@ public:
   // Access an interface by index
   std::shared_ptr<NetworkInterface> interface( const size_t N ) { return _interfaces.at( N ); }
 
-  // Add a route (a forwarding rule)
+  // Add a route (a forwarding rule). Routes added this way are staged in a private copy of the table, which is
+  // published as a whole new table the next time the table is read (by route() or routes()). The copy is made
+  // once for a run of add_route() calls, but again after every publication: to build or change a large table,
+  // prefer load_routes() or apply_routes().
   void add_route( uint32_t route_prefix,
                   uint8_t prefix_length,
                   std::optional<Address> next_hop,
                   size_t interface_num );
 
+  // A route, as loaded in bulk, changed in a batch, or saved in a snapshot
+  struct Route
+  {
+    uint32_t prefix {};
+    uint8_t prefix_length {}; // up to 32
+    std::optional<Address> next_hop {};
+    size_t interface_num {};
+  };
+
+  // Changes to the routing table, applied together
+  struct RouteDiff
+  {
+    std::vector<Route> add {};                           // new routes, or replacements (same prefix and length)
+    std::vector<std::pair<uint32_t, uint8_t>> remove {}; // (prefix, prefix length) of routes to withdraw
+  };
+
+  // Replace the routing table with `routes` (sorted by prefix length, then prefix, as routes() returns them)
+  void load_routes( std::span<const Route> routes );
+
+  // Apply `diff` to a copy of the routing table, then swap the copy in. Safe while another thread routes:
+  // route() sees either the old table or the new one. Concurrent changes are applied one at a time.
+  void apply_routes( const RouteDiff& diff );
+
+  // The routing table, sorted by prefix length and then prefix
+  std::vector<Route> routes() const;
+
+  // Save the routing table to a snapshot file, or replace it with one loaded from a snapshot file
+  void save_snapshot( const std::string& path ) const;
+  void load_snapshot( const std::string& path );
+
+  // Cache route lookups for up to `entries` destinations (rounded up to a power of two; 0 turns the cache off).
+  // The cache is 4-way set-associative, a set to a cache line, and is emptied by any change to the routing table.
+  void set_route_cache( size_t entries );
+
+  // Route cache hits and misses so far (read from the thread that routes)
+  struct RouteCacheStats
+  {
+    uint64_t hits {};
+    uint64_t misses {};
+  };
+  const RouteCacheStats& route_cache_stats() const { return route_cache_stats_; }
+
+  // Hold datagrams routed out of interface `interface_num` in `queue` (null to send them at once, as by
+  // default), and send them at up to `rate_bps` bits/s: as far as the rate allows right after route(), and the
+  // rest as tick() passes time. A rate of 0 is no limit: the queue is drained after each route(), and only
+  // its own drops apply.
+  void set_egress_queue( size_t interface_num, std::unique_ptr<EgressQueue> queue, uint64_t rate_bps );
+
+  // The egress queue of an interface (with its statistics), or null if it has none
+  const EgressQueue* egress_queue( size_t interface_num ) const;
+
   // Route packets between the interfaces
   void route();
 
+  // Let time pass for the egress queues, and send what their rates now allow
+  void tick( uint64_t ms_since_last_tick );
+
 private:
   // The router's collection of network interfaces
   std::vector<std::shared_ptr<NetworkInterface>> _interfaces {};
 
+  // An interface's egress queue, drained by a token bucket (with room for a millisecond's or a datagram's worth
+  // of bytes, whichever is more)
+  struct EgressPort
+  {
+    std::unique_ptr<EgressQueue> queue {};
+    uint64_t rate_bps {};
+    int64_t credit_bytes {};
+  };
+  std::vector<EgressPort> egress_ {};
+  uint64_t current_time_ms_ {};
+
+  // Send a routed datagram out of an interface, or queue it there
+  void forward( size_t interface_num, InternetDatagram&& datagram, const Address& next_hop );
+  void forward( size_t interface_num, PacketBuffer&& packet, const Address& next_hop );
+  void drain( size_t interface_num );
+
+  // A map per prefix length (0 through 32), from the prefix's leading bits to the route's interface and next hop
   using info = std::pair<size_t, std::optional<Address>>;
-  std::array<std::unordered_map<uint32_t, info>, 32> routing_table_ {};
+  using RoutingTable = std::array<std::unordered_map<uint32_t, info>, 33>;
+  // Never changed once published: changes are made to a copy, which replaces it. The copy add_route() stages
+  // routes in is published by the next reader; that doesn't change the routes (only when route() sees them), so
+  // a const reader may do it.
+  mutable std::atomic<std::shared_ptr<const RoutingTable>> routing_table_ { std::make_shared<const RoutingTable>() };
+  mutable std::shared_ptr<RoutingTable> staged_table_ {}; // the table with add_route()'s unpublished routes
+  mutable std::atomic<bool> routes_staged_ {};
+  mutable std::mutex table_writer_ {}; // held by whoever is replacing (or staging changes to) the table
+  void publish_staged_routes() const;
+  void discard_staged_routes() const // with table_writer_ held
+  {
+    staged_table_.reset();
+    routes_staged_.store( false, std::memory_order_release );
+  }
+
+  // Bumped after every change to the table (after the new table is in place), to invalidate the route cache
+  mutable std::atomic<uint32_t> generation_ { 1 };
+
+  // A cached lookup: the route for `destination` as of table generation `generation` (0 for an empty entry)
+  struct alignas( 16 ) RouteCacheEntry
+  {
+    uint32_t destination {};
+    uint32_t generation {};
+    uint32_t next_hop {}; // valid if has_next_hop
+    uint16_t interface_num {};
+    bool has_route {};
+    bool has_next_hop {};
+  };
+  // Entries whose destinations hash alike, most recently used first
+  struct alignas( 64 ) RouteCacheSet
+  {
+    std::array<RouteCacheEntry, 4> ways {};
+  };
+  std::vector<RouteCacheSet> route_cache_ {};
+  RouteCacheStats route_cache_stats_ {};
+
+  void table_changed() const
+  {
+    if ( generation_.fetch_add( 1, std::memory_order_release ) + 1 == 0 ) {
+      generation_.fetch_add( 1, std::memory_order_release ); // 0 marks an empty cache entry
+    }
+  }
+
+  static void insert_route( RoutingTable& table,
+                            uint32_t route_prefix,
+                            uint8_t prefix_length,
+                            std::optional<Address> next_hop,
+                            size_t interface_num );
 
-  [[nodiscard]] auto match( uint32_t ) const noexcept -> std::optional<info>;
+  [[nodiscard]] static auto match( const RoutingTable& table, uint32_t ) noexcept -> std::optional<info>;
+  [[nodiscard]] auto cached_match( const RoutingTable& table, uint32_t generation, uint32_t addr )
+    -> std::optional<info>;
 };
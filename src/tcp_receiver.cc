@@ -26,7 +26,7 @@ void TCPReceiver::receive( TCPSenderMessage message )
   const uint64_t checkpoint { writer().bytes_pushed() + 1 /* SYN */ }; // abs_seqno for expecting payload
   const uint64_t absolute_seqno { message.seqno.unwrap( zero_point_.value(), checkpoint ) };
   const uint64_t stream_index { absolute_seqno + static_cast<uint64_t>( message.SYN ) - 1 /* SYN */ };
-  reassembler_.insert( stream_index, move( message.payload ), message.FIN );
+  reassembler_.insert( stream_index, move( message.payload ).release(), message.FIN );
 }
 
 TCPReceiverMessage TCPReceiver::send() const
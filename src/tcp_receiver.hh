@@ -5,6 +5,7 @@
 #include "tcp_sender_message.hh"
 #include "wrapping_integers.hh"
 
+#include <memory>
 #include <optional>
 
 class TCPReceiver
@@ -22,6 +23,9 @@ public:
   // The TCPReceiver sends TCPReceiverMessages to the peer's TCPSender.
   TCPReceiverMessage send() const;
 
+  // Count what the Reassembler sees in `stats` (if not null)
+  void set_stats( std::shared_ptr<TCPStats> stats ) { reassembler_.set_stats( std::move( stats ) ); }
+
   // Access the output (only Reader is accessible non-const)
   const Reassembler& reassembler() const { return reassembler_; }
   Reader& reader() { return reassembler_.reader(); }
@@ -1,5 +1,6 @@
 #include "tcp_sender.hh"
 #include "tcp_config.hh"
+#include "trace.hh"
 #include "wrapping_integers.hh"
 
 #include <algorithm>
@@ -20,6 +21,34 @@ uint64_t TCPSender::consecutive_retransmissions() const
   return total_retransmission_;
 }
 
+// Should a segment of (at most) `len` payload bytes wait for more data to arrive before it is sent?
+bool TCPSender::hold_small_segment( uint64_t len ) const
+{
+  if ( flushing_ or not SYN_sent_ or window_size_ == 0 ) {
+    return false; // Never delay the SYN or a zero window probe.
+  }
+  if ( reader().bytes_buffered() >= len or writer().is_closed() ) {
+    return false; // The segment is full (up to what the window allows), or carries the last bytes with FIN.
+  }
+  return cork_ or ( nagle_ and total_outstanding_ != 0 );
+}
+
+uint64_t TCPSender::pacing_rate() const
+{
+  if ( not pacing_ ) {
+    return 0;
+  }
+  if ( pacing_rate_Bps_ != 0 ) {
+    return pacing_rate_Bps_;
+  }
+  if ( not has_rtt_sample_ ) {
+    return 0; // No RTT sample yet: don't pace.
+  }
+  // The clock only advances by ticks, so an RTT shorter than one is measured as next to nothing. Pace as if it
+  // took a tick, rather than at a rate so high that pacing would silently stop.
+  return window_size_ * 1'000'000UL / max( srtt_us_, tick_us_ );
+}
+
 void TCPSender::push( const TransmitFunction& transmit )
 {
   while ( ( window_size_ == 0 ? 1 : window_size_ ) > total_outstanding_ ) {
@@ -28,20 +57,18 @@ void TCPSender::push( const TransmitFunction& transmit )
     }
 
     auto msg { make_empty_message() };
-    if ( not SYN_sent_ ) {
-      msg.SYN = true;
-      SYN_sent_ = true;
-    }
+    msg.SYN = not SYN_sent_; // (SYN_sent_ is only set once it has been sent: it may yet be held back below)
 
     const uint64_t remaining { ( window_size_ == 0 ? 1 : window_size_ ) - total_outstanding_ };
     const size_t len { min( TCPConfig::MAX_PAYLOAD_SIZE, remaining - msg.sequence_length() ) };
-    auto&& payload { msg.payload };
-    while ( reader().bytes_buffered() != 0U and payload.size() < len ) {
-      string_view view { reader().peek() };
-      view = view.substr( 0, len - payload.size() );
-      payload += view;
-      input_.reader().pop( view.size() );
+    if ( hold_small_segment( len ) ) {
+      break;
+    }
+    if ( not msg.SYN and window_size_ != 0 and pacing_rate() != 0
+         and not pacer_.allows( min<uint64_t>( len, reader().bytes_buffered() ) ) ) {
+      break; // Wait for tick() to refill the bucket (but never delay the SYN).
     }
+    msg.payload = read_payload( min<uint64_t>( len, reader().bytes_buffered() ) );
 
     if ( not FIN_sent_ and remaining > msg.sequence_length() and reader().is_finished() ) {
       msg.FIN = true;
@@ -53,20 +80,74 @@ void TCPSender::push( const TransmitFunction& transmit )
     }
 
     transmit( msg );
+    SYN_sent_ = true;
     if ( not timer_.is_active() ) {
       timer_.start();
     }
+    if ( pacing_rate() != 0 ) {
+      pacer_.consume( msg.payload.size() );
+    }
+    if ( not rtt_probe_.has_value() ) {
+      rtt_probe_.emplace( next_abs_seqno_ + msg.sequence_length(), current_time_us_ );
+    }
+    outstanding_segments_.push( { next_abs_seqno_, msg.SYN, msg.payload.size(), msg.FIN } );
     next_abs_seqno_ += msg.sequence_length();
     total_outstanding_ += msg.sequence_length();
-    outstanding_message_.emplace( move( msg ) );
   }
 }
 
+void TCPSender::flush( const TransmitFunction& transmit )
+{
+  flushing_ = true;
+  push( transmit );
+  flushing_ = false;
+}
+
 TCPSenderMessage TCPSender::make_empty_message() const
 {
   return { Wrap32::wrap( next_abs_seqno_, isn_ ), false, {}, false, input_.has_error() };
 }
 
+// Pop `len` bytes from the outbound stream: a shared slice of the stream's buffer when they are contiguous,
+// or else a single copy into a string reserved up front.
+SharedString TCPSender::read_payload( uint64_t len )
+{
+  const SharedString slice { reader().peek_shared() };
+  if ( slice.size() >= len ) {
+    input_.reader().pop( len );
+    return slice.substr( 0, len );
+  }
+
+  string payload;
+  payload.reserve( len );
+  while ( payload.size() < len ) {
+    const string_view view { reader().peek().substr( 0, len - payload.size() ) };
+    payload += view;
+    input_.reader().pop( view.size() );
+  }
+  return payload;
+}
+
+TCPSenderMessage TCPSender::make_retransmission() const
+{
+  const auto& segment { outstanding_segments_.front() };
+  TCPSenderMessage msg { Wrap32::wrap( segment.abs_seqno, isn_ ), segment.SYN, {}, segment.FIN, input_.has_error() };
+
+  const uint64_t len { segment.payload_size };
+  if ( const SharedString slice { reader().peek_retained( 0 ) }; slice.size() >= len ) {
+    msg.payload = slice.substr( 0, len );
+    return msg;
+  }
+
+  string payload;
+  payload.reserve( len );
+  while ( payload.size() < len ) {
+    payload += string_view { reader().peek_retained( payload.size() ) }.substr( 0, len - payload.size() );
+  }
+  msg.payload = move( payload );
+  return msg;
+}
+
 void TCPSender::receive( const TCPReceiverMessage& msg )
 {
   if ( input_.has_error() ) {
@@ -77,6 +158,14 @@ void TCPSender::receive( const TCPReceiverMessage& msg )
     return;
   }
 
+  if ( stats_ and msg.window_size == 0 and window_size_ != 0 ) {
+    stats_->zero_window_events.add();
+  }
+  if constexpr ( TRACING_ENABLED ) {
+    if ( msg.window_size != window_size_ ) {
+      trace_event( TraceEvent::WindowChange, 0, 0, window_size_, msg.window_size );
+    }
+  }
   window_size_ = msg.window_size;
   if ( not msg.ackno.has_value() ) {
     return;
@@ -86,34 +175,80 @@ void TCPSender::receive( const TCPReceiverMessage& msg )
     return;
   }
   bool has_acknowledgment { false };
-  while ( not outstanding_message_.empty() ) {
-    const auto& message { outstanding_message_.front() };
-    if ( ack_abs_seqno_ + message.sequence_length() > recv_ack_abs_seqno ) {
+  const uint64_t ack_abs_seqno_before { ack_abs_seqno_ };
+  while ( not outstanding_segments_.empty() ) {
+    const auto& segment { outstanding_segments_.front() };
+    if ( ack_abs_seqno_ + segment.sequence_length() > recv_ack_abs_seqno ) {
       break; // Must be fully acknowledged by the TCP receiver.
     }
     has_acknowledgment = true;
-    ack_abs_seqno_ += message.sequence_length();
-    total_outstanding_ -= message.sequence_length();
-    outstanding_message_.pop();
+    ack_abs_seqno_ += segment.sequence_length();
+    total_outstanding_ -= segment.sequence_length();
+    input_.reader().release( segment.payload_size );
+    outstanding_segments_.pop();
+  }
+  if ( rtt_probe_.has_value() and rtt_probe_->first <= ack_abs_seqno_ ) {
+    // An acknowledgment within the same tick took less time than the clock can tell: count a microsecond.
+    const uint64_t sample_us { max<uint64_t>( current_time_us_ - rtt_probe_->second, 1 ) };
+    srtt_us_ = has_rtt_sample_ ? ( 7 * srtt_us_ + sample_us ) / 8 : sample_us;
+    has_rtt_sample_ = true;
+    rtt_probe_.reset();
+    if ( stats_ ) {
+      stats_->record_RTT( sample_us / 1000, srtt_us_ / 1000 );
+    }
   }
   if ( has_acknowledgment ) {
+    if constexpr ( TRACING_ENABLED ) {
+      trace_event( TraceEvent::Ack,
+                   0,
+                   Wrap32::wrap( ack_abs_seqno_, isn_ ).raw_value(),
+                   ack_abs_seqno_ - ack_abs_seqno_before,
+                   window_size_,
+                   TraceFlag::ACK );
+    }
     total_retransmission_ = 0;
     timer_.reload( initial_RTO_ms_ );
-    outstanding_message_.empty() ? timer_.stop() : timer_.start();
+    outstanding_segments_.empty() ? timer_.stop() : timer_.start();
   }
 }
 
 void TCPSender::tick( uint64_t ms_since_last_tick, const TransmitFunction& transmit )
 {
-  if ( timer_.tick( ms_since_last_tick ).is_expired() ) {
-    if ( outstanding_message_.empty() ) {
-      return;
+  current_time_us_ += ms_since_last_tick * 1000;
+  tick_us_ = max<uint64_t>( ms_since_last_tick, 1 ) * 1000;
+  if ( stats_ ) {
+    // Data waiting while the window is full, or an open connection with nothing to send
+    if ( reader().bytes_buffered() != 0 and total_outstanding_ >= max<uint64_t>( window_size_, 1 ) ) {
+      stats_->window_limited_ms.add( ms_since_last_tick );
+    } else if ( SYN_sent_ and reader().bytes_buffered() == 0 and not writer().is_closed() ) {
+      stats_->app_limited_ms.add( ms_since_last_tick );
+    }
+  }
+
+  if ( timer_.tick( ms_since_last_tick ).is_expired() and not outstanding_segments_.empty() ) {
+    rtt_probe_.reset(); // Karn's algorithm: an ACK can't tell the retransmission from the original.
+    const TCPSenderMessage retransmission { make_retransmission() };
+    if constexpr ( TRACING_ENABLED ) {
+      trace_event( TraceEvent::TimerFired, 0, 0, total_retransmission_, window_size_ );
+      trace_event( TraceEvent::Retransmit,
+                   retransmission.seqno.raw_value(),
+                   0,
+                   retransmission.sequence_length(),
+                   window_size_ );
+    }
+    transmit( retransmission );
+    if ( stats_ ) {
+      ( window_size_ == 0 ? stats_->retransmits_window_probe : stats_->retransmits_timeout ).add();
     }
-    transmit( outstanding_message_.front() );
     if ( window_size_ != 0 ) {
       total_retransmission_ += 1;
       timer_.exponential_backoff();
     }
     timer_.reset();
   }
+
+  if ( const uint64_t rate { pacing_rate() }; rate != 0 ) {
+    pacer_.refill( rate, ms_since_last_tick );
+    push( transmit ); // Send what the bucket held back.
+  }
 }
@@ -1,12 +1,18 @@
 #pragma once
 
 #include "byte_stream.hh"
+#include "tcp_config.hh"
 #include "tcp_receiver_message.hh"
 #include "tcp_sender_message.hh"
+#include "tcp_stats.hh"
 
+#include <algorithm>
 #include <cstdint>
 #include <functional>
+#include <memory>
+#include <optional>
 #include <queue>
+#include <utility>
 
 class RetransmissionTimer
 {
@@ -32,13 +38,39 @@ private:
   uint64_t timer_ {};
 };
 
+// Token bucket that spaces out transmissions. Tokens are kept in millibytes, so that a rate in
+// bytes per second refills exactly `rate` tokens per millisecond.
+class PacingBucket
+{
+public:
+  static constexpr uint64_t MIN_DEPTH_BYTES { 2 * TCPConfig::MAX_PAYLOAD_SIZE };
+  static constexpr uint64_t MAX_DEPTH_BYTES { 4 * TCPConfig::MAX_PAYLOAD_SIZE };
+
+  [[nodiscard]] constexpr auto allows( uint64_t bytes ) const noexcept -> bool { return tokens_ >= bytes * 1000; }
+  constexpr auto consume( uint64_t bytes ) noexcept -> void { tokens_ -= std::min( tokens_, bytes * 1000 ); }
+  constexpr auto refill( uint64_t rate_Bps, uint64_t ms_since_last_tick ) noexcept -> void
+  {
+    // The bucket holds a tick's worth of tokens, so that the tick interval doesn't cap the rate, but never more
+    // than a few segments: a long tick would otherwise release a whole window as one burst. (So with long ticks
+    // and a fast rate, the sender is held to MAX_DEPTH_BYTES per tick.)
+    const uint64_t depth {
+      std::clamp( rate_Bps * ms_since_last_tick, MIN_DEPTH_BYTES * 1000, MAX_DEPTH_BYTES * 1000 ) };
+    tokens_ = std::min( depth, tokens_ + rate_Bps * ms_since_last_tick );
+  }
+
+private:
+  uint64_t tokens_ { MIN_DEPTH_BYTES * 1000 };
+};
+
 class TCPSender
 {
 public:
   /* Construct TCP sender with given default Retransmission Timeout and possible ISN */
   TCPSender( ByteStream&& input, Wrap32 isn, uint64_t initial_RTO_ms )
     : input_( std::move( input ) ), isn_( isn ), initial_RTO_ms_( initial_RTO_ms ), timer_( initial_RTO_ms )
-  {}
+  {
+    input_.reader().set_retain( true ); // Unacknowledged bytes stay in the stream until the peer acknowledges them.
+  }
 
   /* Generate an empty TCPSenderMessage */
   TCPSenderMessage make_empty_message() const;
@@ -52,9 +84,25 @@ public:
   /* Push bytes from the outbound stream */
   void push( const TransmitFunction& transmit );
 
+  /* Push bytes from the outbound stream, including any sub-MSS data held back by Nagle or cork */
+  void flush( const TransmitFunction& transmit );
+
   /* Time has passed by the given # of milliseconds since the last time the tick() method was called */
   void tick( uint64_t ms_since_last_tick, const TransmitFunction& transmit );
 
+  /* Segment coalescing (both off by default) */
+  void set_nagle( bool enabled ) { nagle_ = enabled; } // Hold sub-MSS data while data is in flight (RFC 896)
+  void set_cork( bool enabled ) { cork_ = enabled; }   // Hold sub-MSS data until uncorked or flushed
+
+  /* Pacing (off by default): space segments at `rate_Bps` bytes/s, or at window / smoothed RTT if zero */
+  void set_pacing( bool enabled, uint64_t rate_Bps = 0 ) { pacing_ = enabled, pacing_rate_Bps_ = rate_Bps; }
+  uint64_t pacing_rate() const; // Current pacing rate in bytes/s (0 if not pacing)
+  uint64_t smoothed_RTT_ms() const { return srtt_us_ / 1000; }
+  uint64_t smoothed_RTT_us() const { return srtt_us_; }
+
+  /* Record retransmissions, window and RTT statistics in `stats` (if not null) */
+  void set_stats( std::shared_ptr<TCPStats> stats ) { stats_ = std::move( stats ); }
+
   // Accessors
   uint64_t sequence_numbers_in_flight() const;  // How many sequence numbers are outstanding?
   uint64_t consecutive_retransmissions() const; // How many consecutive *re*transmissions have happened?
@@ -78,8 +126,40 @@ private:
   uint64_t next_abs_seqno_ {};
   uint64_t ack_abs_seqno_ {};
   uint16_t window_size_ { 1 };
-  std::queue<TCPSenderMessage> outstanding_message_ {};
+
+  // Retransmission index: the payload stays in input_ (retained), only segment boundaries are recorded here.
+  struct OutstandingSegment
+  {
+    uint64_t abs_seqno {};
+    bool SYN {};
+    uint64_t payload_size {};
+    bool FIN {};
+
+    uint64_t sequence_length() const { return SYN + payload_size + FIN; }
+  };
+  std::queue<OutstandingSegment> outstanding_segments_ {};
+  TCPSenderMessage make_retransmission() const; // Rebuild the oldest outstanding segment from retained bytes
+  SharedString read_payload( uint64_t len );
+
+  bool nagle_ {};
+  bool cork_ {};
+  bool flushing_ {};
+  bool hold_small_segment( uint64_t len ) const;
+
+  bool pacing_ {};
+  uint64_t pacing_rate_Bps_ {};
+  PacingBucket pacer_ {};
+
+  // RTT estimation (RFC 6298), timing one segment at a time and never a retransmitted one (Karn's algorithm).
+  // In microseconds, so that a smoothed RTT under a millisecond doesn't round down to nothing.
+  uint64_t current_time_us_ {};
+  uint64_t tick_us_ { 1000 }; // the last tick's interval: RTT samples are no finer than this
+  bool has_rtt_sample_ {};
+  uint64_t srtt_us_ {};
+  std::optional<std::pair<uint64_t, uint64_t>> rtt_probe_ {}; // (abs_seqno that acknowledges it, time sent)
 
   uint64_t total_outstanding_ {};
   uint64_t total_retransmission_ {};
+
+  std::shared_ptr<TCPStats> stats_ {};
 };
@@ -1,5 +1,9 @@
 #include "wrapping_integers.hh"
 
+#include <cstddef>
+#include <span>
+#include <stdexcept>
+
 using namespace std;
 
 Wrap32 Wrap32::wrap( uint64_t n, Wrap32 zero_point )
@@ -12,6 +16,56 @@ Wrap32 Wrap32::wrap( uint64_t n, Wrap32 zero_point )
   return zero_point + static_cast<uint32_t>( n );
 }
 
+namespace {
+
+/*
+ * Unwrapping against a fixed checkpoint, reduced to two thresholds on the offset from the zero point.
+ * The answer is the offset placed in the checkpoint's 2^32 block, then moved up or down one block:
+ *  - It moves up if it would otherwise lie more than 2^31 below the checkpoint.
+ *  - It moves down if it would otherwise lie more than 2^31 above the checkpoint.
+ *  - It never moves below zero or past the last block.
+ * A threshold that cannot apply is set so that no offset crosses it.
+ * Unwrapping is then two compares and two adds, without branches, which pays off across a batch (where the
+ * loop vectorizes) but not for a single unwrap, where the branches of Wrap32::unwrap are cheaper.
+ */
+class Unwrapper
+{
+public:
+  explicit Unwrapper( uint64_t checkpoint )
+    : high_( checkpoint & LAST ), up_below_( up_threshold( checkpoint ) ), down_above_( down_threshold( checkpoint ) )
+  {}
+
+  uint64_t operator()( uint32_t offset ) const
+  {
+    return ( high_ | offset ) + ( uint64_t { offset < up_below_ } << 32 ) - ( uint64_t { offset > down_above_ } << 32 );
+  }
+
+private:
+  static constexpr uint32_t HALF { 1U << 31 };
+  static constexpr uint64_t LAST { ~uint64_t { UINT32_MAX } };
+
+  uint64_t high_;       // the checkpoint's block
+  uint32_t up_below_;   // offsets below this belong in the next block up
+  uint32_t down_above_; // offsets above this belong in the block below
+
+  // (Bitwise operators, not logical ones, so that these don't branch either)
+  static uint32_t up_threshold( uint64_t checkpoint )
+  {
+    const auto low = static_cast<uint32_t>( checkpoint );
+    const bool applies = ( low > HALF ) & ( checkpoint < LAST );
+    return ( low - HALF ) & ( 0U - applies );
+  }
+
+  static uint32_t down_threshold( uint64_t checkpoint )
+  {
+    const auto low = static_cast<uint32_t>( checkpoint );
+    const bool applies = ( low < HALF ) & ( checkpoint > UINT32_MAX );
+    return ( low + HALF ) | ( applies - 1U );
+  }
+};
+
+} // namespace
+
 uint64_t Wrap32::unwrap( Wrap32 zero_point, uint64_t checkpoint ) const
 {
   const uint64_t n_low32 { this->raw_value_ - zero_point.raw_value_ };
@@ -25,3 +79,25 @@ uint64_t Wrap32::unwrap( Wrap32 zero_point, uint64_t checkpoint ) const
   }
   return res;
 }
+
+void Wrap32::unwrap_batch( span<const Wrap32> seqnos, Wrap32 zero_point, uint64_t checkpoint, span<uint64_t> out )
+{
+  if ( out.size() < seqnos.size() ) {
+    throw runtime_error( "Wrap32::unwrap_batch: output shorter than input" );
+  }
+
+  const Unwrapper unwrapper { checkpoint };
+  const uint32_t zero { zero_point.raw_value_ };
+
+  // Blocks of a fixed size vectorize even under -O2's cautious cost model; the remainder is done one at a time
+  constexpr size_t BLOCK { 8 };
+  size_t i {};
+  for ( ; i + BLOCK <= seqnos.size(); i += BLOCK ) {
+    for ( size_t j = 0; j < BLOCK; ++j ) {
+      out[i + j] = unwrapper( seqnos[i + j].raw_value_ - zero );
+    }
+  }
+  for ( ; i < seqnos.size(); ++i ) {
+    out[i] = unwrapper( seqnos[i].raw_value_ - zero );
+  }
+}
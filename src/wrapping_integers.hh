@@ -1,6 +1,7 @@
 #pragma once
 
 #include <cstdint>
+#include <span>
 
 /*
  * The Wrap32 type represents a 32-bit unsigned integer that:
@@ -25,6 +26,19 @@ public:
    */
   uint64_t unwrap( Wrap32 zero_point, uint64_t checkpoint ) const;
 
+  /*
+   * Unwrap many sequence numbers against the same zero point and checkpoint (e.g. the acknowledgments and SACK
+   * blocks of a burst of segments), writing out[i] = seqnos[i].unwrap( zero_point, checkpoint ). `out` must be
+   * at least as long as `seqnos` (or this throws). The loop has no branches, so the compiler can vectorize it.
+   */
+  static void unwrap_batch( std::span<const Wrap32> seqnos,
+                            Wrap32 zero_point,
+                            uint64_t checkpoint,
+                            std::span<uint64_t> out );
+
+  /* The raw 32-bit value, as it appears on the wire. */
+  uint32_t raw_value() const { return raw_value_; }
+
   Wrap32 operator+( uint32_t n ) const { return Wrap32 { raw_value_ + n }; }
   bool operator==( const Wrap32& other ) const { return raw_value_ == other.raw_value_; }
 
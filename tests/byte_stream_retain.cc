@@ -0,0 +1,70 @@
+#include "byte_stream.hh"
+#include "byte_stream_test_harness.hh"
+
+#include <exception>
+#include <iostream>
+
+using namespace std;
+
+int main()
+{
+  try {
+    {
+      ByteStreamTestHarness test { "retained bytes can be peeked until released", 15 };
+
+      test.execute( SetRetain { true } );
+      test.execute( Push { "cat" } );
+      test.execute( Push { "tac" } );
+      test.execute( Push { "dog" } );
+      test.execute( Pop { 7 } );
+      test.execute( AvailableCapacity { 13 } ); // retained bytes don't count against the capacity
+      test.execute( PeekRetained { 0, "cat" } );
+      test.execute( PeekRetained { 1, "at" } );
+      test.execute( PeekRetained { 3, "tac" } );
+      test.execute( PeekRetained { 6, "d" } ); // only what has been popped
+      test.execute( PeekRetained { 7, "" } );
+      test.execute( PeekRetained { 4, "ac" } ); // behind the last peek
+
+      test.execute( Release { 4 } );
+      test.execute( PeekRetained { 0, "ac" } );
+      test.execute( PeekRetained { 2, "d" } );
+      test.execute( Release { 2 } );
+      test.execute( PeekRetained { 0, "d" } );
+
+      test.execute( Pop { 2 } );
+      test.execute( PeekRetained { 1, "og" } );
+      test.execute( Push { "emu" } );
+      test.execute( Pop { 3 } );
+      test.execute( PeekRetained { 3, "emu" } );
+
+      test.execute( SetRetain { false } );
+      test.execute( PeekRetained { 0, "" } );
+      test.execute( Peek { "" } );
+    }
+
+    {
+      ByteStreamTestHarness test { "peeking at retained bytes in order", 100000 };
+
+      test.execute( SetRetain { true } );
+      string expected;
+      for ( char c = 'a'; c <= 'z'; ++c ) {
+        test.execute( Push { string( 1000, c ) } );
+        expected += string( 1000, c );
+      }
+      test.execute( Pop { expected.size() } );
+      uint64_t released {};
+      for ( uint64_t index = 0; index < expected.size(); index += 500 ) {
+        test.execute( PeekRetained { index - released, expected.substr( index, 1000 - index % 1000 ) } );
+        if ( index % 2000 == 1500 ) {
+          test.execute( Release { 500 } );
+          released += 500;
+        }
+      }
+    }
+  } catch ( const exception& e ) {
+    cerr << "Exception: " << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -55,6 +55,24 @@ struct Pop : public Action<ByteStream>
   void execute( ByteStream& bs ) const override { bs.reader().pop( len_ ); }
 };
 
+struct SetRetain : public Action<ByteStream>
+{
+  bool retain_;
+
+  explicit SetRetain( bool retain ) : retain_( retain ) {}
+  std::string description() const override { return std::string( retain_ ? "retain" : "stop retaining" ); }
+  void execute( ByteStream& bs ) const override { bs.reader().set_retain( retain_ ); }
+};
+
+struct Release : public Action<ByteStream>
+{
+  uint64_t len_;
+
+  explicit Release( uint64_t len ) : len_( len ) {}
+  std::string description() const override { return "release( " + std::to_string( len_ ) + " )"; }
+  void execute( ByteStream& bs ) const override { bs.reader().release( len_ ); }
+};
+
 /* expectations */
 
 struct Peek : public Expectation<ByteStream>
@@ -107,6 +125,30 @@ struct PeekOnce : public Peek
   }
 };
 
+struct PeekRetained : public Expectation<ByteStream>
+{
+  uint64_t offset_;
+  std::string output_;
+
+  PeekRetained( uint64_t offset, std::string output ) : offset_( offset ), output_( move( output ) ) {}
+
+  std::string description() const override
+  {
+    return "peek_retained( " + std::to_string( offset_ ) + " ) gives exactly \"" + Printer::prettify( output_ )
+           + "\"";
+  }
+
+  void execute( ByteStream& bs ) const override
+  {
+    const std::string peeked { std::string_view { bs.reader().peek_retained( offset_ ) } };
+    if ( peeked != output_ ) {
+      throw ExpectationViolation { "Expected exactly \"" + Printer::prettify( output_ ) + "\" at retained offset "
+                                   + std::to_string( offset_ ) + ", but found \"" + Printer::prettify( peeked )
+                                   + "\"" };
+    }
+  }
+};
+
 struct IsClosed : public ConstExpectBool<ByteStream>
 {
   using ConstExpectBool::ConstExpectBool;
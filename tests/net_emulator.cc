@@ -0,0 +1,262 @@
+#include "emulator_adapter.hh"
+#include "fd_adapter.hh"
+
+#include <algorithm>
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+namespace {
+
+void expect( bool condition, const string& what )
+{
+  if ( not condition ) {
+    throw runtime_error( what );
+  }
+}
+
+// What reached the far end of the link: which segment (by its sequence number), and when
+struct Arrival
+{
+  uint32_t seqno;
+  uint64_t time_ms;
+};
+
+// An adapter that records each segment written to it, with the emulated time
+class RecordingAdapter : public FdAdapterBase
+{
+  shared_ptr<vector<Arrival>> arrivals_;
+  uint64_t now_ms_ {};
+
+public:
+  explicit RecordingAdapter( shared_ptr<vector<Arrival>> arrivals ) : arrivals_( move( arrivals ) ) {}
+
+  optional<TCPMessage> read() { return {}; }
+  void write( const TCPMessage& msg ) { arrivals_->push_back( { msg.sender.seqno.raw_value(), now_ms_ } ); }
+  void tick( const size_t ms_since_last_tick ) { now_ms_ += ms_since_last_tick; }
+};
+
+// A link with a fixed seed, and the record of what crossed it
+struct Link
+{
+  shared_ptr<vector<Arrival>> arrivals { make_shared<vector<Arrival>>() };
+  EmulatorAdapter<RecordingAdapter> emulator;
+
+  explicit Link( const EmulatorConfig& config, unsigned seed = 1 )
+    : emulator( RecordingAdapter { arrivals }, config, default_random_engine { seed } )
+  {}
+
+  // Write segment number `n`, with `payload_size` bytes of payload
+  void write( uint32_t n, size_t payload_size = 0 )
+  {
+    TCPMessage msg;
+    msg.sender.seqno = Wrap32 { n };
+    msg.sender.payload = string( payload_size, 'x' );
+    emulator.write( msg );
+  }
+
+  void run( uint64_t ms )
+  {
+    for ( uint64_t i = 0; i < ms; ++i ) {
+      emulator.tick( 1 );
+    }
+  }
+};
+
+void test_delay_and_jitter()
+{
+  EmulatorConfig config;
+  config.delay_ms = 50;
+  Link fixed { config };
+  fixed.write( 0 );
+  fixed.run( 49 );
+  expect( fixed.arrivals->empty(), "segment released before the delay" );
+  fixed.run( 1 );
+  expect( fixed.arrivals->size() == 1 and fixed.arrivals->front().time_ms == 50, "segment not released at 50 ms" );
+
+  config.jitter_ms = 20;
+  Link jittery { config };
+  for ( uint32_t n = 0; n < 500; ++n ) {
+    jittery.write( n );
+  }
+  jittery.run( 49 );
+  expect( jittery.arrivals->empty(), "jitter released a segment before the delay" );
+  jittery.run( 22 );
+  expect( jittery.arrivals->size() == 500 and jittery.emulator.stats().delivered == 500,
+          "segments still held after delay + jitter" );
+  const auto [earliest, latest] = minmax_element(
+    jittery.arrivals->begin(), jittery.arrivals->end(), []( auto& a, auto& b ) { return a.time_ms < b.time_ms; } );
+  expect( earliest->time_ms == 50 and latest->time_ms == 70, "jitter does not span [delay, delay + jitter]" );
+  expect( not is_sorted( jittery.arrivals->begin(),
+                         jittery.arrivals->end(),
+                         []( auto& a, auto& b ) { return a.seqno < b.seqno; } ),
+          "jitter never let a segment overtake another" );
+}
+
+void test_queue()
+{
+  // 1000-byte segments on a link that sends one per millisecond, behind a queue of 10
+  const size_t payload { 1000 - IPv4Header::LENGTH - TCPSegment::HEADER_LENGTH };
+  EmulatorConfig config;
+  config.rate_bps = 8'000'000;
+  config.queue_limit_bytes = 10'000;
+  Link drop_tail { config };
+  for ( uint32_t n = 0; n < 25; ++n ) {
+    drop_tail.write( n, payload );
+  }
+  expect( drop_tail.emulator.stats().dropped_queue == 15, "drop-tail queue did not drop what did not fit" );
+  drop_tail.run( 20 );
+  expect( drop_tail.arrivals->size() == 10, "wrong number of segments through the drop-tail queue" );
+  for ( uint32_t n = 0; n < 10; ++n ) {
+    expect( drop_tail.arrivals->at( n ).seqno == n and drop_tail.arrivals->at( n ).time_ms == n + 1,
+            "segment " + to_string( n ) + " not serialized in turn at the link rate" );
+  }
+
+  // Once it has drained, the queue takes segments again
+  drop_tail.write( 99, payload );
+  drop_tail.run( 1 );
+  expect( drop_tail.arrivals->back().seqno == 99 and drop_tail.emulator.stats().dropped_queue == 15,
+          "drained queue did not admit a segment" );
+
+  // RED drops early, long before the queue is full
+  config.queue_limit_bytes = 1'000'000;
+  config.queue = QueueDiscipline::RED;
+  config.red_min_bytes = 2'000;
+  config.red_max_bytes = 20'000;
+  Link red { config };
+  for ( uint32_t n = 0; n < 300; ++n ) {
+    red.write( n, payload );
+  }
+  const uint64_t dropped { red.emulator.stats().dropped_queue };
+  expect( dropped > 0 and dropped < 300, "RED did not drop early (" + to_string( dropped ) + " dropped)" );
+  red.run( 300 );
+  expect( red.arrivals->size() + dropped == 300, "RED lost track of segments" );
+}
+
+// The lengths of the runs of consecutive segments (out of `count`) that did not arrive
+vector<size_t> loss_bursts( const vector<Arrival>& arrivals, uint32_t count )
+{
+  vector<bool> arrived( count );
+  for ( const auto& arrival : arrivals ) {
+    arrived.at( arrival.seqno ) = true;
+  }
+  vector<size_t> bursts;
+  size_t run {};
+  for ( uint32_t n = 0; n <= count; ++n ) {
+    if ( n < count and not arrived[n] ) {
+      ++run;
+    } else if ( run != 0 ) {
+      bursts.push_back( run );
+      run = 0;
+    }
+  }
+  return bursts;
+}
+
+void test_loss()
+{
+  const uint32_t count { 20'000 };
+
+  // Independent loss: about 10%, rarely two in a row
+  EmulatorConfig independent;
+  independent.loss_good = 0.1;
+  Link random { independent };
+  for ( uint32_t n = 0; n < count; ++n ) {
+    random.write( n );
+  }
+  random.run( 1 );
+  const uint64_t lost { random.emulator.stats().dropped_loss };
+  expect( lost > count / 12 and lost < count / 8, "independent loss rate far from 10%" );
+  expect( lost + random.arrivals->size() == count, "lost segments delivered" );
+  const auto singles = loss_bursts( *random.arrivals, count );
+  expect( lost < singles.size() * 5 / 4, "independent losses came in bursts" );
+
+  // Gilbert-Elliott: one segment in 21 spends time in the bad state (losing everything), for 5 on average
+  EmulatorConfig bursty;
+  bursty.p_good_to_bad = 0.01;
+  bursty.p_bad_to_good = 0.2;
+  Link burst { bursty };
+  for ( uint32_t n = 0; n < count; ++n ) {
+    burst.write( n );
+  }
+  burst.run( 1 );
+  const uint64_t burst_lost { burst.emulator.stats().dropped_loss };
+  expect( burst_lost > count / 30 and burst_lost < count / 15, "Gilbert-Elliott loss rate far from 1 in 21" );
+  const auto bursts = loss_bursts( *burst.arrivals, count );
+  expect( burst_lost > bursts.size() * 3, "Gilbert-Elliott losses did not come in bursts" );
+}
+
+void test_duplicate_and_reorder()
+{
+  const uint32_t count { 2000 };
+
+  EmulatorConfig config;
+  config.duplicate = 0.25;
+  Link duplicating { config };
+  for ( uint32_t n = 0; n < count; ++n ) {
+    duplicating.write( n );
+  }
+  duplicating.run( 1 );
+  const uint64_t duplicated { duplicating.emulator.stats().duplicated };
+  expect( duplicated > count / 5 and duplicated < count * 3 / 10, "duplication rate far from 25%" );
+  expect( duplicating.arrivals->size() == count + duplicated, "duplicates not delivered" );
+
+  // One segment a millisecond over a 10 ms link: a reordered one skips the delay (leaving at the next tick),
+  // and overtakes those in flight
+  config.duplicate = 0;
+  config.delay_ms = 10;
+  config.reorder = 0.1;
+  Link reordering { config };
+  for ( uint32_t n = 0; n < count; ++n ) {
+    reordering.write( n );
+    reordering.run( 1 );
+  }
+  reordering.run( 10 );
+  const uint64_t reordered { reordering.emulator.stats().reordered };
+  expect( reordered > count / 15 and reordered < count * 2 / 15, "reordering rate far from 10%" );
+  expect( reordering.arrivals->size() == count, "reordered segments lost" );
+  uint64_t early {};
+  for ( const auto& arrival : *reordering.arrivals ) {
+    expect( arrival.time_ms == arrival.seqno + 1 or arrival.time_ms == arrival.seqno + 10,
+            "segment " + to_string( arrival.seqno ) + " released at neither its send time nor after the delay" );
+    early += arrival.time_ms == arrival.seqno + 1;
+  }
+  expect( early == reordered, "reordered segments did not skip the delay" );
+
+  // The same seed gives the same link
+  Link again { config };
+  for ( uint32_t n = 0; n < count; ++n ) {
+    again.write( n );
+    again.run( 1 );
+  }
+  again.run( 10 );
+  expect( equal( again.arrivals->begin(),
+                 again.arrivals->end(),
+                 reordering.arrivals->begin(),
+                 reordering.arrivals->end(),
+                 []( auto& a, auto& b ) { return a.seqno == b.seqno and a.time_ms == b.time_ms; } ),
+          "same seed, different link" );
+}
+
+} // namespace
+
+int main()
+{
+  try {
+    test_delay_and_jitter();
+    test_queue();
+    test_loss();
+    test_duplicate_and_reorder();
+  } catch ( const exception& e ) {
+    cerr << "\033[31;1mError: " << e.what() << "\033[m\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,322 @@
+#include "fragment_reassembler.hh"
+#include "network_interface.hh"
+
+#include <algorithm>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+namespace {
+
+void expect( bool condition, const string& what )
+{
+  if ( not condition ) {
+    throw runtime_error( what );
+  }
+}
+
+string payload_of( const InternetDatagram& dgram )
+{
+  string payload;
+  for ( const auto& buf : dgram.payload ) {
+    payload.append( buf );
+  }
+  return payload;
+}
+
+// A datagram from `src` with identification `id`, carrying `length` bytes of a recognizable pattern
+InternetDatagram datagram( uint32_t src, uint16_t id, size_t length, bool df = false )
+{
+  InternetDatagram dgram;
+  dgram.header.src = src;
+  dgram.header.dst = Address { "10.0.0.9" }.ipv4_numeric();
+  dgram.header.id = id;
+  dgram.header.df = df;
+  dgram.header.len = IPv4Header::LENGTH + length;
+  string payload( length, 0 );
+  for ( size_t i = 0; i < length; ++i ) {
+    payload[i] = static_cast<char>( ( i * 7 + id ) % 251 ); // NOLINT(*-magic-numbers)
+  }
+  dgram.payload.push_back( move( payload ) );
+  dgram.header.compute_checksum();
+  return dgram;
+}
+
+// Serialize and parse again, as if the datagram had crossed a link
+InternetDatagram over_the_wire( const InternetDatagram& dgram )
+{
+  InternetDatagram received;
+  expect( parse( received, serialize( dgram ) ), "datagram does not parse (bad checksum?)" );
+  return received;
+}
+
+void expect_whole( const optional<InternetDatagram>& whole, const InternetDatagram& original, const string& context )
+{
+  expect( whole.has_value(), context + ": datagram was not reassembled" );
+  const InternetDatagram received { over_the_wire( *whole ) };
+  expect( not received.header.mf and received.header.offset == 0 and received.header.len == original.header.len
+            and received.header.id == original.header.id,
+          context + ": reassembled header is wrong" );
+  expect( payload_of( received ) == payload_of( original ), context + ": reassembled payload is wrong" );
+}
+
+void test_fragment_datagram()
+{
+  const InternetDatagram original { datagram( 1, 7, 4000 ) };
+  auto fragments = fragment_datagram( InternetDatagram { original }, 1500 );
+  expect( fragments.size() == 3, "expected 3 fragments" );
+  const vector<pair<size_t, uint16_t>> layout { { 1480, 0 }, { 1480, 185 }, { 1040, 370 } };
+  for ( size_t i = 0; i < fragments.size(); ++i ) {
+    const InternetDatagram fragment { over_the_wire( fragments[i] ) };
+    expect( fragment.header.payload_length() == layout[i].first and fragment.header.offset == layout[i].second
+              and fragment.header.mf == ( i + 1 < fragments.size() ),
+            "fragment " + to_string( i ) + " has the wrong length, offset or MF flag" );
+  }
+
+  // Fragments of a fragment keep the offsets of the original, and MF on all but the original's last piece
+  auto pieces = fragment_datagram( move( fragments[1] ), 600 );
+  expect( pieces.size() == 3 and pieces[0].header.offset == 185 and pieces[1].header.offset == 185 + 72
+            and pieces[2].header.mf,
+          "re-fragmenting a fragment went wrong" );
+
+  expect( fragment_datagram( datagram( 1, 7, 1480 ), 1500 ).size() == 1, "a datagram that fits was fragmented" );
+  expect( fragment_datagram( datagram( 1, 7, 4000, true ), 1500 ).empty(), "a DF datagram was fragmented" );
+}
+
+void test_reassembly_orders()
+{
+  const InternetDatagram original { datagram( 1, 42, 10000 ) };
+  const auto fragments = fragment_datagram( InternetDatagram { original }, 576 );
+
+  // Not a fragment: straight through
+  FragmentReassembler reassembler;
+  expect_whole( reassembler.push( InternetDatagram { original } ), original, "whole datagram" );
+
+  // In order, in reverse, and shuffled
+  vector<size_t> order( fragments.size() );
+  for ( size_t i = 0; i < order.size(); ++i ) {
+    order[i] = i;
+  }
+  vector<vector<size_t>> orders { order, { order.rbegin(), order.rend() } };
+  default_random_engine rng { 5 }; // NOLINT(*-msc51-cpp)
+  for ( int i = 0; i < 10; ++i ) {
+    ranges::shuffle( order, rng );
+    orders.push_back( order );
+  }
+  for ( const auto& sequence : orders ) {
+    optional<InternetDatagram> whole;
+    for ( size_t i = 0; i < sequence.size(); ++i ) {
+      expect( not whole.has_value(), "datagram reassembled before its last fragment" );
+      whole = reassembler.push( over_the_wire( fragments[sequence[i]] ) );
+    }
+    expect_whole( whole, original, "fragments out of order" );
+    expect( reassembler.datagrams_held() == 0 and reassembler.bytes_held() == 0, "reassembler kept state" );
+  }
+
+  // Two datagrams with the same identification but different sources, interleaved
+  const InternetDatagram other { datagram( 2, 42, 3000 ) };
+  const auto other_fragments = fragment_datagram( InternetDatagram { other }, 1500 );
+  reassembler.push( InternetDatagram { fragments[0] } );
+  reassembler.push( InternetDatagram { other_fragments[0] } );
+  expect( reassembler.datagrams_held() == 2, "interleaved datagrams share state" );
+  optional<InternetDatagram> whole;
+  for ( size_t i = 1; i < other_fragments.size(); ++i ) {
+    whole = reassembler.push( InternetDatagram { other_fragments[i] } );
+  }
+  expect_whole( whole, other, "interleaved datagram" );
+  for ( size_t i = 1; i < fragments.size(); ++i ) {
+    whole = reassembler.push( InternetDatagram { fragments[i] } );
+  }
+  expect_whole( whole, original, "interleaved datagram" );
+}
+
+void test_duplicates_and_overlaps()
+{
+  const InternetDatagram original { datagram( 1, 9, 3000 ) };
+  const auto fragments = fragment_datagram( InternetDatagram { original }, 820 );
+  expect( fragments.size() == 4, "expected 4 fragments" );
+
+  // Exact duplicates, in order and out of order, are ignored
+  FragmentReassembler reassembler;
+  reassembler.push( InternetDatagram { fragments[0] } );
+  reassembler.push( InternetDatagram { fragments[0] } );
+  reassembler.push( InternetDatagram { fragments[2] } );
+  reassembler.push( InternetDatagram { fragments[2] } );
+  reassembler.push( InternetDatagram { fragments[3] } );
+  expect( reassembler.stats().duplicates == 2, "duplicates not counted" );
+  expect_whole( reassembler.push( InternetDatagram { fragments[1] } ), original, "with duplicates" );
+
+  // A fragment that overlaps another partly drops the whole datagram
+  const auto overlap_by_8 = [&]( size_t i ) {
+    InternetDatagram shifted { fragments[i] };
+    shifted.header.offset -= 1;
+    shifted.header.compute_checksum();
+    return shifted;
+  };
+  for ( const size_t overlapping : { 1, 3 } ) {
+    FragmentReassembler fresh;
+    fresh.push( InternetDatagram { fragments[0] } );
+    fresh.push( InternetDatagram { fragments[2] } );
+    fresh.push( overlap_by_8( overlapping ) );
+    expect( fresh.stats().overlaps == 1 and fresh.datagrams_held() == 0 and fresh.bytes_held() == 0,
+            "overlapping fragment did not drop the datagram" );
+    for ( const auto& fragment : fragments ) {
+      fresh.push( InternetDatagram { fragment } );
+    }
+    expect( fresh.stats().reassembled == 1, "datagram not reassembled when sent again" );
+  }
+
+  // So does a last fragment that disagrees with what has arrived
+  FragmentReassembler short_end;
+  short_end.push( InternetDatagram { fragments[2] } );
+  InternetDatagram early_end { fragments[1] };
+  early_end.header.mf = false;
+  early_end.header.compute_checksum();
+  short_end.push( move( early_end ) );
+  expect( short_end.stats().overlaps == 1 and short_end.datagrams_held() == 0, "inconsistent end not detected" );
+
+  // Misaligned and empty fragments are invalid
+  FragmentReassembler strict;
+  InternetDatagram misaligned { fragments[0] };
+  misaligned.payload.front().resize( 801 );
+  misaligned.header.len = IPv4Header::LENGTH + 801;
+  strict.push( move( misaligned ) );
+  InternetDatagram empty { fragments[1] };
+  empty.payload.clear();
+  empty.header.len = IPv4Header::LENGTH;
+  strict.push( move( empty ) );
+  expect( strict.stats().invalid == 2 and strict.datagrams_held() == 0, "invalid fragments accepted" );
+}
+
+void test_limits()
+{
+  const InternetDatagram original { datagram( 1, 3, 3000 ) };
+  const auto fragments = fragment_datagram( InternetDatagram { original }, 1500 );
+
+  // A datagram whose fragments don't all arrive in time is dropped
+  FragmentReassembler reassembler { { 1024 * 1024, 1000 } };
+  reassembler.push( InternetDatagram { fragments[0] } );
+  reassembler.tick( 999 );
+  expect( reassembler.datagrams_held() == 1, "partial datagram expired early" );
+  reassembler.tick( 1 );
+  expect( reassembler.datagrams_held() == 0 and reassembler.stats().expired == 1, "partial datagram did not expire" );
+  reassembler.push( InternetDatagram { fragments[1] } );
+  reassembler.push( InternetDatagram { fragments[2] } );
+  expect( reassembler.stats().reassembled == 0, "datagram reassembled without its expired fragment" );
+
+  // A flood of first fragments that never complete stays within the budget, and the oldest are evicted
+  const size_t budget { 64 * 1024 };
+  FragmentReassembler flooded { { budget, 30'000 } };
+  for ( uint16_t id = 0; id < 1000; ++id ) {
+    auto flood = fragment_datagram( datagram( 3, id, 1000 ), 500 );
+    flooded.push( move( flood[0] ) );
+    expect( flooded.bytes_held() <= budget, "reassembler exceeded its budget" );
+  }
+  expect( flooded.stats().evicted > 900, "flood was not evicted" );
+  optional<InternetDatagram> whole;
+  for ( const auto& fragment : fragments ) {
+    whole = flooded.push( InternetDatagram { fragment } );
+  }
+  expect_whole( whole, original, "after a flood" );
+
+  // Making room for a fragment never evicts the datagram it belongs to, even when that is the oldest
+  FragmentReassembler tight { { 5000, 1000 } };
+  tight.push( InternetDatagram { fragments[0] } );
+  tight.push( move( fragment_datagram( datagram( 4, 3, 3000 ), 1500 )[0] ) );
+  whole = tight.push( InternetDatagram { fragments[1] } );
+  expect( tight.datagrams_held() == 1 and tight.stats().evicted == 1, "wrong datagram evicted to make room" );
+  whole = tight.push( InternetDatagram { fragments[2] } );
+  expect_whole( whole, original, "after making room" );
+
+  // Duplicates and overlaps are turned away before room is made, so they never evict another datagram
+  FragmentReassembler crowded { { 5000, 1000 } };
+  const auto other = fragment_datagram( datagram( 4, 3, 3000 ), 1500 );
+  crowded.push( InternetDatagram { fragments[0] } );
+  crowded.push( InternetDatagram { other[0] } );
+  crowded.push( InternetDatagram { other[0] } );
+  crowded.push( move( fragment_datagram( datagram( 4, 3, 3000 ), 1000 )[0] ) );
+  expect( crowded.stats().duplicates == 1 and crowded.stats().overlaps == 1 and crowded.stats().evicted == 0,
+          "duplicate or overlapping fragment evicted another datagram" );
+  crowded.push( InternetDatagram { fragments[1] } );
+  whole = crowded.push( InternetDatagram { fragments[2] } );
+  expect_whole( whole, original, "after duplicates and overlaps with a full budget" );
+
+  // A completed datagram leaves nothing behind, so a later one with the same key gets a timeout of its own
+  tight.tick( 500 );
+  tight.push( InternetDatagram { fragments[0] } );
+  tight.tick( 999 );
+  expect( tight.datagrams_held() == 1 and tight.stats().expired == 0, "reused key expired with the old datagram" );
+  tight.tick( 1 );
+  expect( tight.datagrams_held() == 0 and tight.bytes_held() == 0 and tight.stats().expired == 1,
+          "reused key did not expire" );
+}
+
+// An output port that hands frames straight to another interface
+class Wire : public NetworkInterface::OutputPort
+{
+public:
+  weak_ptr<NetworkInterface> peer {};
+  uint64_t frames {};
+
+  void transmit( const NetworkInterface& n [[maybe_unused]], const EthernetFrame& x ) override
+  {
+    ++frames;
+    peer.lock()->recv_frame( x );
+  }
+};
+
+void test_network_interface()
+{
+  const auto wire_a = make_shared<Wire>();
+  const auto wire_b = make_shared<Wire>();
+  const auto a
+    = make_shared<NetworkInterface>( "a", wire_a, EthernetAddress { 2, 0, 0, 0, 0, 1 }, Address { "10.0.0.1" } );
+  const auto b
+    = make_shared<NetworkInterface>( "b", wire_b, EthernetAddress { 2, 0, 0, 0, 0, 2 }, Address { "10.0.0.9" } );
+  wire_a->peer = b;
+  wire_b->peer = a;
+  a->set_mtu( 576 );
+
+  // Without reassembly, fragments are passed up as they are (after ARP resolves the next hop)
+  const InternetDatagram original { datagram( Address { "10.0.0.1" }.ipv4_numeric(), 77, 2000 ) };
+  a->send_datagram( original, Address { "10.0.0.9" } );
+  expect( a->fragmentation_stats().fragmented == 1 and a->fragmentation_stats().fragments == 4,
+          "interface did not fragment the datagram" );
+  expect( wire_a->frames == 5 and b->datagrams_received().size() == 4, "fragments did not cross the wire" );
+  while ( not b->datagrams_received().empty() ) {
+    b->datagrams_received().pop();
+  }
+
+  // With it, the whole datagram arrives
+  b->enable_reassembly();
+  a->send_datagram( original, Address { "10.0.0.9" } );
+  expect( b->datagrams_received().size() == 1, "datagram was not reassembled" );
+  expect_whole( b->datagrams_received().front(), original, "network interface" );
+
+  // Too big, with DF set: dropped
+  a->send_datagram( datagram( 1, 78, 2000, true ), Address { "10.0.0.9" } );
+  expect( a->fragmentation_stats().dropped_dont_fragment == 1 and a->fragmentation_stats().fragmented == 2,
+          "DF datagram was not dropped" );
+}
+
+} // namespace
+
+int main()
+{
+  try {
+    test_fragment_datagram();
+    test_reassembly_orders();
+    test_duplicates_and_overlaps();
+    test_limits();
+    test_network_interface();
+  } catch ( const exception& e ) {
+    cerr << "\033[31;1mError: " << e.what() << "\033[m\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -108,6 +108,59 @@ int main()
         make_frame( target_eth, another_eth, EthernetHeader::TYPE_IPv4, serialize( reply_datagram ) ), {} ) );
     }
 
+    {
+      const EthernetAddress local_eth = random_private_ethernet_address();
+      NetworkInterfaceTestHarness test {
+        "datagrams waiting for ARP are sent in one batch", local_eth, Address( "4.3.2.1", 0 ) };
+
+      const auto first = make_datagram( "5.6.7.8", "13.12.11.10" );
+      const auto second = make_datagram( "5.6.7.8", "13.12.11.11" );
+      const auto third = make_datagram( "5.6.7.8", "13.12.11.12" );
+      const auto elsewhere = make_datagram( "5.6.7.8", "13.12.11.13" );
+      test.execute( SendDatagram { first, Address( "192.168.0.1", 0 ) } );
+      test.execute( SendDatagram { elsewhere, Address( "192.168.0.2", 0 ) } );
+      test.execute( SendDatagram { second, Address( "192.168.0.1", 0 ) } );
+      test.execute( SendDatagram { third, Address( "192.168.0.1", 0 ) } );
+      test.execute( ExpectFrame { make_frame(
+        local_eth,
+        ETHERNET_BROADCAST,
+        EthernetHeader::TYPE_ARP,
+        serialize( make_arp( ARPMessage::OPCODE_REQUEST, local_eth, "4.3.2.1", {}, "192.168.0.1" ) ) ) } );
+      test.execute( ExpectFrame { make_frame(
+        local_eth,
+        ETHERNET_BROADCAST,
+        EthernetHeader::TYPE_ARP,
+        serialize( make_arp( ARPMessage::OPCODE_REQUEST, local_eth, "4.3.2.1", {}, "192.168.0.2" ) ) ) } );
+      test.execute( ExpectNoFrame {} );
+      test.execute( ExpectNoBatch {} );
+
+      // the reply releases the three datagrams for that next hop in one batch, in order, addressed to it
+      const EthernetAddress target_eth = random_private_ethernet_address();
+      test.execute( ReceiveFrame {
+        make_frame(
+          target_eth,
+          local_eth,
+          EthernetHeader::TYPE_ARP, // NOLINTNEXTLINE(*-suspicious-*)
+          serialize( make_arp( ARPMessage::OPCODE_REPLY, target_eth, "192.168.0.1", local_eth, "4.3.2.1" ) ) ),
+        {} } );
+      test.execute( ExpectBatch { 3 } );
+      test.execute( ExpectNoBatch {} );
+      test.execute(
+        ExpectFrame { make_frame( local_eth, target_eth, EthernetHeader::TYPE_IPv4, serialize( first ) ) } );
+      test.execute(
+        ExpectFrame { make_frame( local_eth, target_eth, EthernetHeader::TYPE_IPv4, serialize( second ) ) } );
+      test.execute(
+        ExpectFrame { make_frame( local_eth, target_eth, EthernetHeader::TYPE_IPv4, serialize( third ) ) } );
+      test.execute( ExpectNoFrame {} );
+
+      // once the mapping is known, a datagram goes out on its own
+      test.execute( SendDatagram { first, Address( "192.168.0.1", 0 ) } );
+      test.execute(
+        ExpectFrame { make_frame( local_eth, target_eth, EthernetHeader::TYPE_IPv4, serialize( first ) ) } );
+      test.execute( ExpectNoBatch {} );
+      test.execute( ExpectNoFrame {} );
+    }
+
     {
       const EthernetAddress local_eth = random_private_ethernet_address();
       const EthernetAddress remote_eth = random_private_ethernet_address();
@@ -320,6 +373,220 @@ int main()
         serialize( make_arp( ARPMessage::OPCODE_REQUEST, local_eth, "10.0.0.1", {}, "10.0.0.5" ) ) ) } );
       test.execute( ExpectNoFrame {} );
     }
+
+    for ( const auto policy : { NetworkInterface::DropPolicy::DropTail, NetworkInterface::DropPolicy::DropOldest } ) {
+      const bool drop_tail = policy == NetworkInterface::DropPolicy::DropTail;
+      const EthernetAddress local_eth = random_private_ethernet_address();
+      const EthernetAddress remote_eth = random_private_ethernet_address();
+      NetworkInterfaceTestHarness test {
+        drop_tail ? "pending datagrams are bounded (drop-tail)" : "pending datagrams are bounded (drop-oldest)",
+        local_eth,
+        Address( "1.2.3.4", 0 ) };
+
+      // room for two 25-byte datagrams per next hop
+      test.execute( SetPendingLimits { 50, 1000, policy } );
+
+      const auto datagram1 = make_datagram( "5.6.7.8", "13.12.11.10" );
+      const auto datagram2 = make_datagram( "5.6.7.8", "13.12.11.11" );
+      const auto datagram3 = make_datagram( "5.6.7.8", "13.12.11.12" );
+      test.execute( SendDatagram { datagram1, Address( "10.0.0.1", 0 ) } );
+      test.execute( ExpectFrame {
+        make_frame( local_eth,
+                    ETHERNET_BROADCAST,
+                    EthernetHeader::TYPE_ARP,
+                    serialize( make_arp( ARPMessage::OPCODE_REQUEST, local_eth, "1.2.3.4", {}, "10.0.0.1" ) ) ) } );
+      test.execute( SendDatagram { datagram2, Address( "10.0.0.1", 0 ) } );
+      test.execute( SendDatagram { datagram3, Address( "10.0.0.1", 0 ) } );
+      test.execute( ExpectNoFrame {} );
+      test.execute( ExpectPendingDrops { 1, 0 } );
+
+      test.execute( ReceiveFrame {
+        make_frame( remote_eth,
+                    local_eth,
+                    EthernetHeader::TYPE_ARP,
+                    serialize( make_arp( ARPMessage::OPCODE_REPLY, remote_eth, "10.0.0.1", local_eth, "1.2.3.4" ) ) ),
+        {} } );
+      test.execute( ExpectFrame { make_frame( local_eth,
+                                              remote_eth,
+                                              EthernetHeader::TYPE_IPv4,
+                                              serialize( drop_tail ? datagram1 : datagram2 ) ) } );
+      test.execute( ExpectFrame { make_frame( local_eth,
+                                              remote_eth,
+                                              EthernetHeader::TYPE_IPv4,
+                                              serialize( drop_tail ? datagram2 : datagram3 ) ) } );
+      test.execute( ExpectNoFrame {} );
+    }
+
+    {
+      const EthernetAddress local_eth = random_private_ethernet_address();
+      const EthernetAddress remote_eth1 = random_private_ethernet_address();
+      const EthernetAddress remote_eth2 = random_private_ethernet_address();
+      NetworkInterfaceTestHarness test {
+        "drop-oldest only drops from a next hop that can make room", local_eth, Address( "1.2.3.4", 0 ) };
+
+      test.execute( SetPendingLimits { 1000, 100, NetworkInterface::DropPolicy::DropOldest } );
+      const auto a1 = make_datagram( "5.6.7.8", "13.12.11.10" );
+      const auto a2 = make_datagram( "5.6.7.8", "13.12.11.11" );
+      const auto a3 = make_datagram( "5.6.7.8", "13.12.11.12" );
+      const auto a4 = make_datagram( "5.6.7.8", "13.12.11.13" );
+      const auto b1 = make_datagram( "5.6.7.8", "13.12.11.20" );
+      const auto b2 = make_datagram( "5.6.7.8", "13.12.11.21" );
+      for ( const auto& dgram : { a1, a2, a3 } ) {
+        test.execute( SendDatagram { dgram, Address( "10.0.0.1", 0 ) } );
+      }
+      test.execute( SendDatagram { b1, Address( "10.0.0.2", 0 ) } );
+      test.execute( ExpectFrame {
+        make_frame( local_eth,
+                    ETHERNET_BROADCAST,
+                    EthernetHeader::TYPE_ARP,
+                    serialize( make_arp( ARPMessage::OPCODE_REQUEST, local_eth, "1.2.3.4", {}, "10.0.0.1" ) ) ) } );
+      test.execute( ExpectFrame {
+        make_frame( local_eth,
+                    ETHERNET_BROADCAST,
+                    EthernetHeader::TYPE_ARP,
+                    serialize( make_arp( ARPMessage::OPCODE_REQUEST, local_eth, "1.2.3.4", {}, "10.0.0.2" ) ) ) } );
+      test.execute( ExpectPendingDrops { 0, 0 } );
+
+      // only the overall budget is exceeded from here on: 100 bytes are held, in room for 75
+      test.execute( SetPendingLimits { 1000, 75, NetworkInterface::DropPolicy::DropOldest } );
+
+      // emptying 10.0.0.2's queue would not make room, so it is kept and the new datagram dropped
+      test.execute( SendDatagram { b2, Address( "10.0.0.2", 0 ) } );
+      test.execute( ExpectPendingDrops { 1, 0 } );
+
+      // 10.0.0.1's queue can make room by dropping its two oldest
+      test.execute( SendDatagram { a4, Address( "10.0.0.1", 0 ) } );
+      test.execute( ExpectPendingDrops { 3, 0 } );
+      test.execute( ExpectNoFrame {} );
+
+      test.execute( ReceiveFrame {
+        make_frame( remote_eth1,
+                    local_eth,
+                    EthernetHeader::TYPE_ARP,
+                    serialize( make_arp( ARPMessage::OPCODE_REPLY, remote_eth1, "10.0.0.1", local_eth, "1.2.3.4" ) ) ),
+        {} } );
+      test.execute(
+        ExpectFrame { make_frame( local_eth, remote_eth1, EthernetHeader::TYPE_IPv4, serialize( a3 ) ) } );
+      test.execute(
+        ExpectFrame { make_frame( local_eth, remote_eth1, EthernetHeader::TYPE_IPv4, serialize( a4 ) ) } );
+      test.execute( ReceiveFrame {
+        make_frame( remote_eth2,
+                    local_eth,
+                    EthernetHeader::TYPE_ARP,
+                    serialize( make_arp( ARPMessage::OPCODE_REPLY, remote_eth2, "10.0.0.2", local_eth, "1.2.3.4" ) ) ),
+        {} } );
+      test.execute(
+        ExpectFrame { make_frame( local_eth, remote_eth2, EthernetHeader::TYPE_IPv4, serialize( b1 ) ) } );
+      test.execute( ExpectNoFrame {} );
+    }
+
+    {
+      const EthernetAddress local_eth = random_private_ethernet_address();
+      const EthernetAddress remote_eth = random_private_ethernet_address();
+      NetworkInterfaceTestHarness test {
+        "pending datagrams expire with their ARP request", local_eth, Address( "1.2.3.4", 0 ) };
+
+      test.execute( SendDatagram { make_datagram( "5.6.7.8", "13.12.11.10" ), Address( "10.0.0.1", 0 ) } );
+      test.execute( ExpectFrame {
+        make_frame( local_eth,
+                    ETHERNET_BROADCAST,
+                    EthernetHeader::TYPE_ARP,
+                    serialize( make_arp( ARPMessage::OPCODE_REQUEST, local_eth, "1.2.3.4", {}, "10.0.0.1" ) ) ) } );
+      test.execute( Tick { 5010 } );
+      test.execute( ExpectPendingDrops { 0, 1 } );
+
+      // a late reply teaches the mapping, but the datagram is gone
+      test.execute( ReceiveFrame {
+        make_frame( remote_eth,
+                    local_eth,
+                    EthernetHeader::TYPE_ARP,
+                    serialize( make_arp( ARPMessage::OPCODE_REPLY, remote_eth, "10.0.0.1", local_eth, "1.2.3.4" ) ) ),
+        {} } );
+      test.execute( ExpectNoFrame {} );
+    }
+
+    {
+      const EthernetAddress local_eth = random_private_ethernet_address();
+      const EthernetAddress remote_eth = random_private_ethernet_address();
+      NetworkInterfaceTestHarness test {
+        "mappings in use are refreshed before they expire", local_eth, Address( "1.2.3.4", 0 ) };
+
+      test.execute( ReceiveFrame {
+        make_frame( remote_eth,
+                    local_eth,
+                    EthernetHeader::TYPE_ARP,
+                    serialize( make_arp( ARPMessage::OPCODE_REPLY, remote_eth, "10.0.0.1", local_eth, "1.2.3.4" ) ) ),
+        {} } );
+
+      // with four seconds to live, the mapping is still used, and its owner is asked to confirm it
+      test.execute( Tick { 26000 } );
+      const auto datagram = make_datagram( "5.6.7.8", "13.12.11.10" );
+      test.execute( SendDatagram { datagram, Address( "10.0.0.1", 0 ) } );
+      test.execute( ExpectFrame {
+        make_frame( local_eth,
+                    remote_eth,
+                    EthernetHeader::TYPE_ARP,
+                    serialize( make_arp( ARPMessage::OPCODE_REQUEST, local_eth, "1.2.3.4", {}, "10.0.0.1" ) ) ) } );
+      test.execute(
+        ExpectFrame { make_frame( local_eth, remote_eth, EthernetHeader::TYPE_IPv4, serialize( datagram ) ) } );
+
+      // only once
+      const auto datagram2 = make_datagram( "5.6.7.8", "13.12.11.11" );
+      test.execute( SendDatagram { datagram2, Address( "10.0.0.1", 0 ) } );
+      test.execute(
+        ExpectFrame { make_frame( local_eth, remote_eth, EthernetHeader::TYPE_IPv4, serialize( datagram2 ) ) } );
+      test.execute( ExpectNoFrame {} );
+
+      // the reply extends the mapping past its original expiry
+      test.execute( ReceiveFrame {
+        make_frame( remote_eth,
+                    local_eth,
+                    EthernetHeader::TYPE_ARP,
+                    serialize( make_arp( ARPMessage::OPCODE_REPLY, remote_eth, "10.0.0.1", local_eth, "1.2.3.4" ) ) ),
+        {} } );
+      test.execute( Tick { 10000 } );
+      const auto datagram3 = make_datagram( "5.6.7.8", "13.12.11.12" );
+      test.execute( SendDatagram { datagram3, Address( "10.0.0.1", 0 ) } );
+      test.execute(
+        ExpectFrame { make_frame( local_eth, remote_eth, EthernetHeader::TYPE_IPv4, serialize( datagram3 ) ) } );
+      test.execute( ExpectNoFrame {} );
+    }
+
+    {
+      const EthernetAddress local_eth = random_private_ethernet_address();
+      const EthernetAddress remote_eth = random_private_ethernet_address();
+      NetworkInterfaceTestHarness test {
+        "unanswered refresh falls back to a broadcast request", local_eth, Address( "1.2.3.4", 0 ) };
+
+      test.execute( ReceiveFrame {
+        make_frame( remote_eth,
+                    local_eth,
+                    EthernetHeader::TYPE_ARP,
+                    serialize( make_arp( ARPMessage::OPCODE_REPLY, remote_eth, "10.0.0.1", local_eth, "1.2.3.4" ) ) ),
+        {} } );
+
+      test.execute( Tick { 27000 } );
+      const auto datagram = make_datagram( "5.6.7.8", "13.12.11.10" );
+      test.execute( SendDatagram { datagram, Address( "10.0.0.1", 0 ) } );
+      test.execute( ExpectFrame {
+        make_frame( local_eth,
+                    remote_eth,
+                    EthernetHeader::TYPE_ARP,
+                    serialize( make_arp( ARPMessage::OPCODE_REQUEST, local_eth, "1.2.3.4", {}, "10.0.0.1" ) ) ) } );
+      test.execute(
+        ExpectFrame { make_frame( local_eth, remote_eth, EthernetHeader::TYPE_IPv4, serialize( datagram ) ) } );
+      test.execute( ExpectNoFrame {} );
+
+      // no reply: the mapping expires on schedule, and the next datagram waits for a broadcast request
+      test.execute( Tick { 3000 } );
+      test.execute( SendDatagram { make_datagram( "5.6.7.8", "13.12.11.11" ), Address( "10.0.0.1", 0 ) } );
+      test.execute( ExpectFrame {
+        make_frame( local_eth,
+                    ETHERNET_BROADCAST,
+                    EthernetHeader::TYPE_ARP,
+                    serialize( make_arp( ARPMessage::OPCODE_REQUEST, local_eth, "1.2.3.4", {}, "10.0.0.1" ) ) ) } );
+      test.execute( ExpectNoFrame {} );
+    }
   } catch ( const exception& e ) {
     cerr << e.what() << endl;
     return EXIT_FAILURE;
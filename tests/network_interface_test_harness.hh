@@ -1,7 +1,10 @@
 #pragma once
 
 #include <compare>
+#include <numeric>
 #include <optional>
+#include <queue>
+#include <span>
 #include <utility>
 
 #include "arp_message.hh"
@@ -12,7 +15,15 @@ class FramesOut : public NetworkInterface::OutputPort
 {
 public:
   std::queue<EthernetFrame> frames {};
+  std::queue<size_t> batches {}; // the size of each transmit_batch() call (whose frames join `frames` too)
   void transmit( const NetworkInterface& n [[maybe_unused]], const EthernetFrame& x ) override { frames.push( x ); }
+  void transmit_batch( const NetworkInterface& n [[maybe_unused]], std::span<const EthernetFrame> xs ) override
+  {
+    batches.push( xs.size() );
+    for ( const auto& x : xs ) {
+      frames.push( x );
+    }
+  }
 };
 
 using Output = std::shared_ptr<FramesOut>;
@@ -26,8 +37,7 @@ public:
                                const Address& ip_address )
     : TestHarness( move( test_name ), "eth=" + to_string( ethernet_address ) + ", ip=" + ip_address.ip(), [&] {
       const Output output { std::make_shared<FramesOut>() };
-      const NetworkInterface iface { "test", output, ethernet_address, ip_address };
-      return InterfaceAndOutput { iface, output };
+      return InterfaceAndOutput { NetworkInterface { "test", output, ethernet_address, ip_address }, output };
     }() )
   {}
 };
@@ -137,6 +147,38 @@ struct ExpectNoFrame : public Expectation<InterfaceAndOutput>
   }
 };
 
+struct ExpectBatch : public Expectation<InterfaceAndOutput>
+{
+  size_t size;
+
+  std::string description() const override { return "batch of " + to_string( size ) + " frames transmitted"; }
+  void execute( InterfaceAndOutput& interface ) const override
+  {
+    auto& batches = interface.second->batches;
+    if ( batches.empty() ) {
+      throw ExpectationViolation( "NetworkInterface was expected to transmit a batch of frames, but did not" );
+    }
+    const size_t actual = batches.front();
+    batches.pop();
+    if ( actual != size ) {
+      throw ExpectationViolation( "batch size", size, actual );
+    }
+  }
+
+  explicit ExpectBatch( size_t s ) : size( s ) {}
+};
+
+struct ExpectNoBatch : public Expectation<InterfaceAndOutput>
+{
+  std::string description() const override { return "no batch of frames transmitted"; }
+  void execute( InterfaceAndOutput& interface ) const override
+  {
+    if ( not interface.second->batches.empty() ) {
+      throw ExpectationViolation( "NetworkInterface transmitted a batch of frames although none was expected" );
+    }
+  }
+};
+
 struct Tick : public Action<InterfaceAndOutput>
 {
   size_t _ms;
@@ -147,6 +189,50 @@ struct Tick : public Action<InterfaceAndOutput>
   explicit Tick( const size_t ms ) : _ms( ms ) {}
 };
 
+struct SetPendingLimits : public Action<InterfaceAndOutput>
+{
+  size_t neighbour_budget;
+  size_t total_budget;
+  NetworkInterface::DropPolicy policy;
+
+  std::string description() const override
+  {
+    return "pending queue budget set to " + to_string( neighbour_budget ) + " bytes per next hop, "
+           + to_string( total_budget ) + " bytes in total, "
+           + ( policy == NetworkInterface::DropPolicy::DropTail ? "drop-tail" : "drop-oldest" );
+  }
+  void execute( InterfaceAndOutput& interface ) const override
+  {
+    interface.first.set_pending_limits( neighbour_budget, total_budget, policy );
+  }
+
+  SetPendingLimits( size_t n, size_t t, NetworkInterface::DropPolicy p )
+    : neighbour_budget( n ), total_budget( t ), policy( p )
+  {}
+};
+
+struct ExpectPendingDrops : public Expectation<InterfaceAndOutput>
+{
+  uint64_t overflow;
+  uint64_t expired;
+
+  std::string description() const override
+  {
+    return to_string( overflow ) + " pending datagrams dropped for space and " + to_string( expired )
+           + " for expiry";
+  }
+  void execute( InterfaceAndOutput& interface ) const override
+  {
+    const auto& drops = interface.first.pending_drops();
+    if ( drops.overflow != overflow or drops.expired != expired ) {
+      throw ExpectationViolation( "NetworkInterface dropped " + to_string( drops.overflow ) + " for space and "
+                                  + to_string( drops.expired ) + " for expiry" );
+    }
+  }
+
+  ExpectPendingDrops( uint64_t o, uint64_t e ) : overflow( o ), expired( e ) {}
+};
+
 inline std::string summary( const EthernetFrame& frame )
 {
   std::string out = frame.header.to_string() + " payload: ";
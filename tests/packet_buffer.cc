@@ -0,0 +1,168 @@
+#include "arp_message.hh"
+#include "packet_buffer.hh"
+#include "router.hh"
+
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+using namespace std;
+
+namespace {
+
+void expect( bool condition, const string& what )
+{
+  if ( not condition ) {
+    throw runtime_error( what );
+  }
+}
+
+bool throws( const auto& action )
+{
+  try {
+    action();
+  } catch ( const runtime_error& ) {
+    return true;
+  }
+  return false;
+}
+
+void test_moved_from()
+{
+  PacketBuffer packet;
+  packet.append( "hello" );
+  PacketBuffer moved { move( packet ) };
+  expect( moved.view() == "hello", "moving a packet changed it" );
+  expect( packet.view().empty() and packet.empty(), "moved-from packet is not empty" ); // NOLINT(*-use-after-move)
+
+  // A moved-from packet has no room to grow into, and says so
+  expect( packet.headroom() == 0 and packet.tailroom() == 0, "moved-from packet claims room" );
+  expect( packet.prepend( 0 ).empty() and packet.append( 0 ).empty(), "moved-from packet grew" );
+  expect( throws( [&] { packet.prepend( 1 ); } ), "moved-from packet prepended" );
+  expect( throws( [&] { packet.append( "x" ); } ), "moved-from packet appended" );
+
+  PacketBuffer assigned;
+  assigned = move( moved );
+  expect( assigned.view() == "hello", "move-assigning a packet changed it" );
+}
+
+void test_other_thread()
+{
+  const uint64_t in_use { PacketBuffer::pool_stats().blocks_in_use };
+  vector<PacketBuffer> packets( 10 );
+  expect( PacketBuffer::pool_stats().blocks_in_use == in_use + 10, "pool did not count the blocks in use" );
+
+  // Destroyed on another thread: that thread's pool is untouched, and this one counts them off
+  uint64_t other_in_use {};
+  uint64_t other_free {};
+  thread other { [&] {
+    packets.clear();
+    other_in_use = PacketBuffer::pool_stats().blocks_in_use;
+    other_free = PacketBuffer::pool_stats().blocks_free;
+  } };
+  other.join();
+  expect( other_in_use == 0 and other_free == 0, "another thread's pool took this thread's blocks" );
+  expect( PacketBuffer::pool_stats().blocks_in_use == in_use, "blocks released elsewhere still counted in use" );
+
+  // Destroyed after the thread that allocated them has exited
+  thread producer { [&] {
+    packets.resize( 3 );
+    packets.front().append( "from a thread that has gone" );
+  } };
+  producer.join();
+  expect( packets.front().view() == "from a thread that has gone", "packet outlived by its data" );
+  packets.clear();
+  expect( PacketBuffer::pool_stats().blocks_in_use == in_use, "another thread's blocks counted here" );
+}
+
+} // namespace
+
+// An output port that keeps the packet buffers sent through it (and counts frames sent any other way)
+class PacketPort : public NetworkInterface::OutputPort
+{
+public:
+  vector<PacketBuffer> packets {};
+  uint64_t frames {};
+
+  void transmit( const NetworkInterface& n [[maybe_unused]], const EthernetFrame& x [[maybe_unused]] ) override
+  {
+    ++frames;
+  }
+  void transmit_packet( const NetworkInterface& n [[maybe_unused]], PacketBuffer&& packet ) override
+  {
+    packets.push_back( move( packet ) );
+  }
+};
+
+void test_router_forwarding()
+{
+  const EthernetAddress in_eth { 0x02, 0, 0, 0, 0, 1 };
+  const EthernetAddress out_eth { 0x02, 0, 0, 0, 0, 2 };
+  const EthernetAddress neighbour_eth { 0x02, 0, 0, 0, 0, 3 };
+  auto in_port = make_shared<PacketPort>();
+  auto out_port = make_shared<PacketPort>();
+  Router router;
+  router.add_interface( make_shared<NetworkInterface>( "in", in_port, in_eth, Address { "10.0.0.1" } ) );
+  router.add_interface( make_shared<NetworkInterface>( "out", out_port, out_eth, Address { "10.1.0.1" } ) );
+  router.add_route( Address { "10.1.0.0" }.ipv4_numeric(), 16, {}, 1 );
+
+  // The neighbour's Ethernet address is known, so the datagram can go straight out
+  ARPMessage arp;
+  arp.opcode = ARPMessage::OPCODE_REPLY;
+  arp.sender_ethernet_address = neighbour_eth;
+  arp.sender_ip_address = Address { "10.1.0.9" }.ipv4_numeric();
+  arp.target_ethernet_address = out_eth;
+  arp.target_ip_address = Address { "10.1.0.1" }.ipv4_numeric();
+  router.interface( 1 )->recv_frame( { { out_eth, neighbour_eth, EthernetHeader::TYPE_ARP }, serialize( arp ) } );
+
+  // A datagram arrives in a packet buffer, with link padding after it
+  InternetDatagram dgram;
+  dgram.header.src = Address { "10.0.0.9" }.ipv4_numeric();
+  dgram.header.dst = Address { "10.1.0.9" }.ipv4_numeric();
+  dgram.header.ttl = 64;
+  dgram.header.len = IPv4Header::LENGTH + 5;
+  dgram.header.compute_checksum();
+  dgram.payload.emplace_back( "hello" );
+  PacketBuffer frame;
+  for ( const auto& buf : serialize( dgram ) ) {
+    frame.append( buf );
+  }
+  frame.append( "padding" );
+  frame.prepend_header( EthernetHeader { in_eth, neighbour_eth, EthernetHeader::TYPE_IPv4 } );
+  router.interface( 0 )->recv_frame( move( frame ) );
+  expect( router.interface( 0 )->packets_received().size() == 1
+            and router.interface( 0 )->datagrams_received().empty(),
+          "received datagram was not left in its packet buffer" );
+
+  // ... and leaves in the same buffer, with its TTL (and checksum) rewritten and the padding gone
+  router.route();
+  expect( out_port->packets.size() == 1 and out_port->frames == 0, "datagram was not forwarded in its buffer" );
+  EthernetFrame sent;
+  expect( parse( sent, out_port->packets.front().view() ), "forwarded frame does not parse" );
+  InternetDatagram forwarded;
+  expect( sent.header.dst == neighbour_eth and parse( forwarded, sent.payload ), "forwarded datagram is invalid" );
+  expect( forwarded.header.ttl == 63, "forwarded datagram's TTL was not decremented" );
+  string payload;
+  for ( const auto& buf : forwarded.payload ) {
+    payload.append( buf );
+  }
+  expect( payload == "hello", "forwarded datagram's payload changed: \"" + payload + "\"" );
+}
+
+int main()
+{
+  try {
+    test_moved_from();
+    test_other_thread();
+    test_router_forwarding();
+  } catch ( const exception& e ) {
+    cerr << "\033[31;1mError: " << e.what() << "\033[m\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
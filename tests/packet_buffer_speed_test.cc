@@ -0,0 +1,173 @@
+#include "arp_message.hh"
+#include "network_interface.hh"
+#include "packet_buffer.hh"
+#include "tcp_over_ip.hh"
+
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <new>
+#include <random>
+
+using namespace std;
+using namespace std::chrono;
+
+// Count every heap allocation made by the program
+namespace {
+uint64_t allocations {};       // NOLINT(*-avoid-non-const-global-variables)
+uint64_t bytes_allocated {};   // NOLINT(*-avoid-non-const-global-variables)
+} // namespace
+
+void* operator new( size_t size )
+{
+  ++allocations;
+  bytes_allocated += size;
+  if ( void* ptr = malloc( size == 0 ? 1 : size ) ) { // NOLINT(*-no-malloc, *-owning-memory)
+    return ptr;
+  }
+  throw bad_alloc {};
+}
+
+void operator delete( void* ptr ) noexcept
+{
+  free( ptr ); // NOLINT(*-no-malloc, *-owning-memory)
+}
+
+void operator delete( void* ptr, size_t size [[maybe_unused]] ) noexcept
+{
+  free( ptr ); // NOLINT(*-no-malloc, *-owning-memory)
+}
+
+// An output port that "sends" frames by serializing them, the way a file descriptor write would
+class CountingPort : public NetworkInterface::OutputPort
+{
+public:
+  uint64_t bytes {};
+
+  void transmit( const NetworkInterface& n [[maybe_unused]], const EthernetFrame& x ) override
+  {
+    for ( const auto& buf : serialize( x ) ) {
+      bytes += buf.size();
+    }
+  }
+
+  void transmit_packet( const NetworkInterface& n [[maybe_unused]], PacketBuffer&& packet ) override
+  {
+    bytes += packet.view().size();
+  }
+};
+
+class Adapter : public TCPOverIPv4Adapter
+{
+public:
+  Adapter()
+  {
+    config_mut().source = Address { "10.0.0.1", 1234 };
+    config_mut().destination = Address { "10.0.0.2", 80 };
+  }
+};
+
+void speed_test( const size_t num_packets, const size_t payload_size, const bool use_packet_buffers )
+{
+  const EthernetAddress local_eth { 0x02, 0, 0, 0, 0, 1 };
+  const EthernetAddress remote_eth { 0x02, 0, 0, 0, 0, 2 };
+  const Address next_hop { "10.0.0.2" };
+
+  auto port = make_shared<CountingPort>();
+  NetworkInterface interface { "bench", port, local_eth, Address { "10.0.0.1" } };
+  Adapter adapter;
+
+  // Teach the interface the next hop's Ethernet address
+  ARPMessage arp;
+  arp.opcode = ARPMessage::OPCODE_REPLY;
+  arp.sender_ethernet_address = remote_eth;
+  arp.sender_ip_address = next_hop.ipv4_numeric();
+  arp.target_ethernet_address = local_eth;
+  arp.target_ip_address = Address { "10.0.0.1" }.ipv4_numeric();
+  interface.recv_frame( EthernetFrame { { local_eth, remote_eth, EthernetHeader::TYPE_ARP }, serialize( arp ) } );
+
+  // Generate the segment to be sent
+  TCPMessage msg;
+  msg.sender.payload = [&] {
+    default_random_engine rd { payload_size };
+    uniform_int_distribution<char> ud;
+    string ret;
+    for ( size_t i = 0; i < payload_size; ++i ) {
+      ret += ud( rd );
+    }
+    return ret;
+  }();
+  msg.receiver.ackno = Wrap32 { 0 };
+
+  const auto send_one = [&] {
+    if ( use_packet_buffers ) {
+      PacketBuffer packet;
+      adapter.wrap_tcp_in_ip( msg, packet );
+      interface.send_datagram( move( packet ), next_hop );
+    } else {
+      interface.send_datagram( adapter.wrap_tcp_in_ip( msg ), next_hop );
+    }
+  };
+
+  send_one(); // warm up (e.g. the packet buffer pool)
+
+  const uint64_t allocations_before = allocations;
+  const uint64_t bytes_allocated_before = bytes_allocated;
+  port->bytes = 0;
+
+  const auto start_time = steady_clock::now();
+  for ( size_t i = 0; i < num_packets; ++i ) {
+    send_one();
+  }
+  const auto stop_time = steady_clock::now();
+
+  const size_t frame_size = EthernetHeader::LENGTH + IPv4Header::LENGTH + TCPSegment::HEADER_LENGTH + payload_size;
+  if ( port->bytes != num_packets * frame_size ) {
+    throw runtime_error( "Mismatch between frames sent and bytes transmitted" );
+  }
+
+  const double allocations_per_packet
+    = static_cast<double>( allocations - allocations_before ) / static_cast<double>( num_packets );
+  const double bytes_allocated_per_packet
+    = static_cast<double>( bytes_allocated - bytes_allocated_before ) / static_cast<double>( num_packets );
+  const auto test_duration = duration_cast<duration<double>>( stop_time - start_time );
+  const double gigabits_per_second = 8 * static_cast<double>( port->bytes ) / test_duration.count() / 1e9;
+  const PacketBuffer::PoolStats pool = PacketBuffer::pool_stats();
+
+  fstream debug_output;
+  debug_output.open( "/dev/tty" );
+
+  const string name = use_packet_buffers ? "PacketBuffer" : "vector<string>";
+  cout << "Transmit path with " << name << " payloads of " << payload_size << " bytes: " << fixed
+       << setprecision( 2 ) << allocations_per_packet << " allocations (" << bytes_allocated_per_packet
+       << " bytes) per packet, " << gigabits_per_second << " Gbit/s; pool holds "
+       << pool.blocks_in_use + pool.blocks_free << " blocks (" << pool.blocks_allocated << " allocated, "
+       << pool.blocks_reused << " reused).\n";
+
+  debug_output << "             Transmit path (" << name << "): " << fixed << setprecision( 2 )
+               << allocations_per_packet << " allocations/packet, " << gigabits_per_second << " Gbit/s\n";
+
+  if ( use_packet_buffers and allocations != allocations_before ) {
+    throw runtime_error( "PacketBuffer transmit path allocated memory in steady state." );
+  }
+}
+
+void program_body()
+{
+  speed_test( 200'000, 1000, false );
+  speed_test( 200'000, 1000, true );
+}
+
+int main()
+{
+  try {
+    program_body();
+  } catch ( const exception& e ) {
+    cerr << "Exception: " << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,110 @@
+#include "peer_test_harness.hh"
+#include "tcp_config.hh"
+
+#include <exception>
+#include <iostream>
+
+using namespace std;
+
+int main()
+{
+  try {
+    TCPConfig cfg;
+    cfg.isn = Wrap32 { 1000 };
+    cfg.recv_capacity = 3 * TCPConfig::MAX_PAYLOAD_SIZE;
+
+    {
+      TCPPeerTestHarness test { "Two full-sized segments are acknowledged at once, less waits for the timer", cfg };
+
+      test.execute( SynArrives {} );
+      test.execute( ExpectSyn {} );
+      test.execute( DataArrives { 0, 1000 } );
+      test.execute( ExpectNoSegment {} );
+      test.execute( DataArrives { 1000, 1000 } );
+      test.execute( ExpectAck { 2000, 1000 } );
+      test.execute( ExpectNoSegment {} );
+
+      test.execute( DataArrives { 2000, 500 } );
+      test.execute( Tick { cfg.ack_delay - 1U } );
+      test.execute( ExpectNoSegment {} );
+      test.execute( Tick { 1 } );
+      test.execute( ExpectAck { 2500, 500 } );
+      test.execute( ExpectNoSegment {} );
+    }
+
+    {
+      TCPPeerTestHarness test { "The window closing, a zero-window probe, and the window opening again", cfg };
+
+      test.execute( SynArrives {} );
+      test.execute( ExpectSyn {} );
+      test.execute( DataArrives { 0, 1000 } );
+      test.execute( DataArrives { 1000, 1000 } );
+      test.execute( ExpectAck { 2000, 1000 } );
+
+      // The ACK that closes the window is delayed like any other
+      test.execute( DataArrives { 2000, 1000 } );
+      test.execute( ExpectNoSegment {} );
+      test.execute( Tick { cfg.ack_delay } );
+      test.execute( ExpectAck { 3000, 0 } );
+
+      // A probe of the zero window is acknowledged at once, even when (having room for a byte again) it is
+      // accepted
+      test.execute( ReadInbound { 1 } );
+      test.execute( DataArrives { 3000, 1 } );
+      test.execute( ExpectAck { 3001, 0 } );
+
+      // Once the application has opened the window, the next segment is acknowledged at once
+      test.execute( ReadInbound { 1999 } );
+      test.execute( Tick { 1 } );
+      test.execute( ExpectNoSegment {} );
+      test.execute( DataArrives { 3001, 100 } );
+      test.execute( ExpectAck { 3101, 1899 } );
+
+      // A window that grows by less than half the buffer leaves data waiting for the timer
+      test.execute( DataArrives { 3101, 100 } );
+      test.execute( ExpectNoSegment {} );
+      test.execute( ReadInbound { 1000 } );
+      test.execute( Tick { 1 } );
+      test.execute( ExpectNoSegment {} );
+      test.execute( Tick { cfg.ack_delay - 1U } );
+      test.execute( ExpectAck { 3201, 2799 } );
+      test.execute( ExpectNoSegment {} );
+
+      // ... but once a sender held below a full-sized segment has room for one, waiting data is acknowledged
+      test.execute( DataArrives { 3201, 1000 } );
+      test.execute( DataArrives { 4201, 1000 } );
+      test.execute( ExpectAck { 5201, 799 } );
+      test.execute( DataArrives { 5201, 500 } );
+      test.execute( ExpectNoSegment {} );
+      test.execute( ReadInbound { 2000 } );
+      test.execute( Tick { 1 } );
+      test.execute( ExpectAck { 5701, 2299 } );
+      test.execute( ExpectNoSegment {} );
+    }
+
+    {
+      TCPConfig big_cfg;
+      big_cfg.isn = Wrap32 { 1000 };
+      TCPPeerTestHarness test { "An application reading every segment still gets one ACK per two segments",
+                                big_cfg };
+
+      test.execute( SynArrives {} );
+      test.execute( ExpectSyn {} );
+      for ( uint64_t i = 0; i < 100; i++ ) {
+        test.execute( DataArrives { i * 1000, 1000 } );
+        if ( i % 2 == 1 ) {
+          test.execute( ExpectAck { ( i + 1 ) * 1000, TCPConfig::DEFAULT_CAPACITY - 1000 } );
+        }
+        test.execute( ExpectNoSegment {} );
+        test.execute( ReadInbound { 1000 } );
+        test.execute( Tick { 1 } );
+        test.execute( ExpectNoSegment {} );
+      }
+    }
+  } catch ( const exception& e ) {
+    cerr << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
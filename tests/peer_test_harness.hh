@@ -0,0 +1,143 @@
+#pragma once
+
+#include "common.hh"
+#include "tcp_config.hh"
+#include "tcp_peer.hh"
+#include "tcp_segment.hh"
+#include "wrapping_integers.hh"
+
+#include <optional>
+#include <queue>
+#include <sstream>
+#include <string>
+#include <utility>
+
+// A TCPPeer driven from the other end of the connection, whose ISN is 0
+struct PeerAndOutput
+{
+  TCPPeer peer;
+  std::queue<TCPMessage> output {};
+  std::optional<Wrap32> ackno {}; // what the other end acknowledges, once the peer has sent its SYN
+
+  auto make_transmit()
+  {
+    return [&]( TCPMessage x ) {
+      if ( x.sender.SYN ) {
+        ackno = x.sender.seqno + 1;
+      }
+      output.push( std::move( x ) );
+    };
+  }
+};
+
+class TCPPeerTestHarness : public TestHarness<PeerAndOutput>
+{
+public:
+  TCPPeerTestHarness( std::string name, const TCPConfig& config )
+    : TestHarness( move( name ),
+                   "isn=" + to_string( config.isn ) + ", recv_capacity=" + std::to_string( config.recv_capacity )
+                     + ", ack_delay=" + std::to_string( config.ack_delay ),
+                   { TCPPeer { config } } )
+  {}
+};
+
+struct SynArrives : public Action<PeerAndOutput>
+{
+  std::string description() const override { return "SYN arrives"; }
+  void execute( PeerAndOutput& p ) const override
+  {
+    p.peer.receive( { { Wrap32 { 0 }, true, {}, false, false }, { p.ackno, UINT16_MAX, false } },
+                    p.make_transmit() );
+  }
+};
+
+// `length` bytes arriving at stream index `index`
+struct DataArrives : public Action<PeerAndOutput>
+{
+  uint64_t index_;
+  size_t length_;
+
+  DataArrives( uint64_t index, size_t length ) : index_( index ), length_( length ) {}
+  std::string description() const override
+  {
+    return std::to_string( length_ ) + " bytes arrive at stream index " + std::to_string( index_ );
+  }
+  void execute( PeerAndOutput& p ) const override
+  {
+    const TCPSenderMessage data {
+      Wrap32 { static_cast<uint32_t>( index_ + 1 ) }, false, std::string( length_, 'x' ), false, false };
+    p.peer.receive( { data, { p.ackno, UINT16_MAX, false } }, p.make_transmit() );
+  }
+};
+
+struct ReadInbound : public Action<PeerAndOutput>
+{
+  uint64_t length_;
+
+  explicit ReadInbound( uint64_t length ) : length_( length ) {}
+  std::string description() const override { return "application reads " + std::to_string( length_ ) + " bytes"; }
+  void execute( PeerAndOutput& p ) const override { p.peer.inbound_reader().pop( length_ ); }
+};
+
+struct Tick : public Action<PeerAndOutput>
+{
+  uint64_t ms_;
+
+  explicit Tick( uint64_t ms ) : ms_( ms ) {}
+  std::string description() const override { return std::to_string( ms_ ) + " ms pass"; }
+  void execute( PeerAndOutput& p ) const override { p.peer.tick( ms_, p.make_transmit() ); }
+};
+
+struct ExpectSyn : public Expectation<PeerAndOutput>
+{
+  std::string description() const override { return "SYN sent"; }
+  void execute( PeerAndOutput& p ) const override
+  {
+    if ( p.output.empty() or not p.output.front().sender.SYN ) {
+      throw ExpectationViolation( "expected a SYN, but none was sent" );
+    }
+    p.output.pop();
+  }
+};
+
+// An acknowledgment of everything up to stream index `index`, advertising `window`
+struct ExpectAck : public Expectation<PeerAndOutput>
+{
+  uint64_t index_;
+  uint16_t window_;
+
+  ExpectAck( uint64_t index, uint16_t window ) : index_( index ), window_( window ) {}
+  std::string description() const override
+  {
+    return "ACK sent for stream index " + std::to_string( index_ ) + " with window " + std::to_string( window_ );
+  }
+  void execute( PeerAndOutput& p ) const override
+  {
+    if ( p.output.empty() ) {
+      throw ExpectationViolation( "expected an ACK, but none was sent" );
+    }
+    const TCPReceiverMessage& ack = p.output.front().receiver;
+    const std::optional<Wrap32> expected { Wrap32 { static_cast<uint32_t>( index_ + 1 ) } };
+    if ( ack.ackno != expected ) {
+      throw ExpectationViolation( "ackno", expected, ack.ackno );
+    }
+    if ( ack.window_size != window_ ) {
+      throw ExpectationViolation( "window_size", window_, ack.window_size );
+    }
+    p.output.pop();
+  }
+};
+
+struct ExpectNoSegment : public Expectation<PeerAndOutput>
+{
+  std::string description() const override { return "nothing sent"; }
+  void execute( PeerAndOutput& p ) const override
+  {
+    if ( not p.output.empty() ) {
+      std::ostringstream o;
+      o << "TCPPeer sent an unexpected segment (seqno=" << p.output.front().sender.seqno
+        << ", ackno=" << to_string( p.output.front().receiver.ackno ) << ")";
+      throw ExpectationViolation( o.str() );
+    }
+  }
+};
@@ -0,0 +1,234 @@
+#include "egress_queue.hh"
+#include "router.hh"
+
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+namespace {
+
+// An output port that counts the frames sent through it
+class CountingPort : public NetworkInterface::OutputPort
+{
+public:
+  uint64_t frames {};
+
+  void transmit( const NetworkInterface& n [[maybe_unused]], const EthernetFrame& x [[maybe_unused]] ) override
+  {
+    ++frames;
+  }
+};
+
+// A TCP datagram from `src`:`port` (to port 80), of `size` bytes, joining a queue at `now_ms`
+QueuedDatagram datagram( uint32_t src, uint16_t port, size_t size, uint64_t now_ms )
+{
+  InternetDatagram dgram;
+  dgram.header.src = src;
+  dgram.header.dst = Address { "10.0.0.9" }.ipv4_numeric();
+  dgram.header.len = size;
+  dgram.payload.emplace_back( string {
+    static_cast<char>( port >> 8 ), static_cast<char>( port & 0xff ), 0, 80 } ); // NOLINT(*-magic-numbers)
+  const uint32_t next_hop { dgram.header.dst };
+  return { move( dgram ), next_hop, now_ms, size };
+}
+
+void expect( bool condition, const string& what )
+{
+  if ( not condition ) {
+    throw runtime_error( what );
+  }
+}
+
+void test_fifo()
+{
+  FIFOQueue queue { { 3, 10000 } };
+  for ( uint16_t port = 1; port <= 5; ++port ) {
+    queue.enqueue( datagram( 1, port, 100, port ) );
+  }
+  expect( queue.packets() == 3 and queue.bytes() == 300, "FIFO holds more than its packet limit" );
+  expect( queue.stats().dropped_overflow == 2, "FIFO did not drop the arrivals past its limit" );
+
+  for ( uint16_t port = 1; port <= 3; ++port ) {
+    auto item = queue.dequeue( 10 );
+    expect( item.has_value() and static_cast<uint8_t>( item->dgram.payload.front()[1] ) == port,
+            "FIFO sent datagrams out of order" );
+  }
+  expect( not queue.dequeue( 10 ).has_value() and queue.bytes() == 0, "FIFO not empty" );
+  expect( queue.stats().sojourn_max_ms == 9 and queue.stats().sojourn_last_ms == 7
+            and queue.stats().mean_sojourn_ms() == 8,
+          "FIFO sojourn statistics are wrong" );
+
+  FIFOQueue small { { 100, 250 } };
+  for ( uint16_t port = 1; port <= 3; ++port ) {
+    small.enqueue( datagram( 1, port, 100, 0 ) );
+  }
+  expect( small.packets() == 2 and small.stats().dropped_overflow == 1, "FIFO holds more than its byte limit" );
+}
+
+// Offer 11 datagrams of one flow every 10 ms to a queue that sends 10, for `duration_ms`
+EgressStats overload( EgressQueue& queue, uint64_t duration_ms )
+{
+  for ( uint64_t now = 0; now < duration_ms; ++now ) {
+    queue.enqueue( datagram( 1, 1000, 1000, now ) );
+    if ( now % 10 == 0 ) {
+      queue.enqueue( datagram( 1, 1000, 1000, now ) );
+    }
+    queue.dequeue( now );
+  }
+  return queue.stats();
+}
+
+void test_codel()
+{
+  const EgressLimits roomy { 100000, 100000000 };
+  FIFOQueue fifo { roomy };
+  CoDelQueue codel { roomy };
+  const auto fifo_stats = overload( fifo, 10000 );
+  const auto codel_stats = overload( codel, 10000 );
+
+  // The FIFO's standing queue only grows; CoDel drops enough to keep it near the target
+  expect( fifo_stats.dropped_aqm == 0 and fifo_stats.sojourn_last_ms > 500, "FIFO queue did not build up" );
+  expect( codel_stats.dropped_aqm > 0, "CoDel did not drop" );
+  expect( codel_stats.sojourn_last_ms < 50, "CoDel did not bound the sojourn time" );
+  expect( codel_stats.mean_sojourn_ms() < fifo_stats.mean_sojourn_ms() / 4, "CoDel did not reduce the delay" );
+
+  // A queue that stays below the target never drops
+  CoDelQueue light { roomy };
+  for ( uint64_t now = 0; now < 1000; ++now ) {
+    light.enqueue( datagram( 1, 1000, 1500, now ) );
+    light.enqueue( datagram( 1, 1000, 1500, now ) );
+    light.dequeue( now );
+    light.dequeue( now );
+  }
+  expect( light.stats().dropped_aqm == 0 and light.stats().dequeued == 2000, "CoDel dropped from a short queue" );
+}
+
+void test_fq_codel()
+{
+  // A bulk flow offers twice what the link sends; a sparse flow sends a small datagram every 20 ms
+  // (with a fixed salt, so that the flows hash into separate queues on every run)
+  FQCoDelConfig config;
+  config.perturbation = 1;
+  FQCoDelQueue queue { { 1000, 10000000 }, config };
+  const uint32_t bulk { 1 };
+  const uint32_t sparse { 2 };
+  const uint32_t other { 3 };
+  const size_t bulk_flow { queue.flow_of( datagram( bulk, 1000, 100, 0 ).dgram ) };
+  const size_t sparse_flow { queue.flow_of( datagram( sparse, 2000, 100, 0 ).dgram ) };
+  const size_t other_flow { queue.flow_of( datagram( other, 3000, 100, 0 ).dgram ) };
+  expect( bulk_flow != sparse_flow and bulk_flow != other_flow and sparse_flow != other_flow,
+          "test flows share an FQ-CoDel queue" );
+  FQCoDelQueue same_salt { {}, config };
+  expect( same_salt.flow_of( datagram( bulk, 1000, 100, 0 ).dgram ) == bulk_flow,
+          "FQ-CoDel hashed a flow differently under the same salt" );
+  uint64_t sparse_sent {};
+  uint64_t sparse_sojourn_max {};
+  for ( uint64_t now = 0; now < 5000; ++now ) {
+    queue.enqueue( datagram( bulk, 1000, 1500, now ) );
+    queue.enqueue( datagram( bulk, 1000, 1500, now ) );
+    if ( now % 20 == 0 ) {
+      queue.enqueue( datagram( sparse, 2000, 100, now ) );
+    }
+    if ( auto item = queue.dequeue( now ); item.has_value() and item->dgram.header.src == sparse ) {
+      ++sparse_sent;
+      sparse_sojourn_max = max( sparse_sojourn_max, now - item->enqueue_ms );
+    }
+  }
+
+  expect( sparse_sent == 250, "FQ-CoDel did not send every datagram of the sparse flow" );
+  // (it waits for no more than the bulk flow's quantum: two datagrams)
+  expect( sparse_sojourn_max <= 2, "FQ-CoDel delayed the sparse flow behind the bulk one" );
+  expect( queue.stats().dropped_aqm + queue.stats().dropped_overflow > 0, "FQ-CoDel did not drop from the bulk flow" );
+
+  // Once full, it drops from the longest queue rather than the arriving flow
+  FQCoDelQueue full { { 10, 1000000 }, config };
+  for ( uint16_t i = 0; i < 10; ++i ) {
+    full.enqueue( datagram( bulk, 1000, 100, 0 ) );
+  }
+  full.enqueue( datagram( sparse, 2000, 100, 0 ) );
+  expect( full.packets() == 10 and full.stats().dropped_overflow == 1, "FQ-CoDel exceeded its limit" );
+  bool sparse_kept {};
+  while ( auto item = full.dequeue( 0 ) ) {
+    sparse_kept |= item->dgram.header.src == sparse;
+  }
+  expect( sparse_kept, "FQ-CoDel dropped the arrival instead of from the longest queue" );
+
+  // A new flow that empties goes to the old flows even when there are none, so that refilled it waits behind a
+  // flow that is new since
+  FQCoDelQueue rounds { {}, config };
+  rounds.enqueue( datagram( bulk, 1000, 100, 0 ) );
+  rounds.enqueue( datagram( sparse, 2000, 100, 0 ) );
+  rounds.enqueue( datagram( sparse, 2000, 100, 0 ) );
+  expect( rounds.dequeue( 0 )->dgram.header.src == bulk, "FQ-CoDel did not serve the first new flow first" );
+  expect( rounds.dequeue( 0 )->dgram.header.src == sparse, "FQ-CoDel did not move on to the next new flow" );
+  rounds.enqueue( datagram( bulk, 1000, 100, 0 ) );
+  rounds.enqueue( datagram( other, 3000, 100, 0 ) );
+  expect( rounds.dequeue( 0 )->dgram.header.src == sparse, "FQ-CoDel cut a new flow's round short" );
+  expect( rounds.dequeue( 0 )->dgram.header.src == other, "an emptied new flow jumped ahead of a newer one" );
+  expect( rounds.dequeue( 0 )->dgram.header.src == bulk, "FQ-CoDel lost the refilled flow" );
+  expect( not rounds.dequeue( 0 ).has_value(), "FQ-CoDel not empty" );
+}
+
+// `count` 20-byte datagrams arrive on interface 0
+void arrive( Router& router, int count )
+{
+  for ( int i = 0; i < count; ++i ) {
+    auto item = datagram( 1, 1000, IPv4Header::LENGTH, 0 );
+    item.dgram.payload.clear();
+    item.dgram.header.compute_checksum();
+    router.interface( 0 )->recv_frame(
+      { { { 0x02, 0, 0, 0, 0, 0 }, { 0x02, 0, 0, 0, 0, 0x99 }, EthernetHeader::TYPE_IPv4 }, serialize( item.dgram ) } );
+  }
+}
+
+void test_router_egress()
+{
+  Router router;
+  vector<shared_ptr<CountingPort>> ports;
+  for ( uint8_t i = 0; i < 2; ++i ) {
+    ports.push_back( make_shared<CountingPort>() );
+    router.add_interface( make_shared<NetworkInterface>(
+      "eth" + to_string( i ), ports.back(), EthernetAddress { 0x02, 0, 0, 0, 0, i }, Address { "10.0.0.1" } ) );
+  }
+  router.add_route( 0, 0, {}, 1 );
+  expect( router.egress_queue( 1 ) == nullptr, "interface has an egress queue before one is set" );
+
+  // 20-byte datagrams at 160 kbit/s: one a millisecond
+  router.set_egress_queue( 1, make_unique<FIFOQueue>(), 160000 );
+  arrive( router, 3 );
+  router.route();
+  const EgressQueue& queue { *router.egress_queue( 1 ) };
+  expect( queue.packets() == 3 and ports[1]->frames == 0, "router sent datagrams before earning the credit" );
+
+  router.tick( 1 );
+  expect( queue.stats().dequeued == 1 and ports[1]->frames == 1, "router did not send one datagram after 1 ms" );
+  router.tick( 2 );
+  expect( queue.stats().dequeued == 3 and queue.stats().sojourn_max_ms == 3, "router did not drain its queue" );
+
+  // A rate of 0 is no limit: route() sends everything queued
+  router.set_egress_queue( 1, make_unique<FIFOQueue>(), 0 );
+  arrive( router, 3 );
+  router.route();
+  const EgressQueue& unlimited { *router.egress_queue( 1 ) };
+  expect( unlimited.packets() == 0 and unlimited.stats().dequeued == 3, "unlimited egress port held datagrams" );
+}
+
+} // namespace
+
+int main()
+{
+  try {
+    test_fifo();
+    test_codel();
+    test_fq_codel();
+    test_router_egress();
+  } catch ( const exception& e ) {
+    cerr << "\033[31;1mError: " << e.what() << "\033[m\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,229 @@
+#include "arp_message.hh"
+#include "network_interface.hh"
+#include "router.hh"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <random>
+
+#include <unistd.h>
+
+using namespace std;
+using namespace std::chrono;
+
+// Do two (sorted) tables hold the same routes?
+bool same_routes( const vector<Router::Route>& a, const vector<Router::Route>& b )
+{
+  return ranges::equal( a, b, []( const Router::Route& x, const Router::Route& y ) {
+    return x.prefix == y.prefix and x.prefix_length == y.prefix_length and x.next_hop == y.next_hop
+           and x.interface_num == y.interface_num;
+  } );
+}
+
+// A fresh file in the temporary directory (so that concurrent runs don't share it)
+string temporary_file()
+{
+  string path { ( filesystem::temp_directory_path() / "router_speed_test_XXXXXX" ).string() };
+  const int fd { mkstemp( path.data() ) };
+  if ( fd < 0 ) {
+    throw runtime_error( "could not create a temporary file" );
+  }
+  close( fd );
+  return path;
+}
+
+// An output port that counts the frames sent through it
+class CountingPort : public NetworkInterface::OutputPort
+{
+public:
+  uint64_t frames {};
+
+  void transmit( const NetworkInterface& n [[maybe_unused]], const EthernetFrame& x [[maybe_unused]] ) override
+  {
+    ++frames;
+  }
+};
+
+EthernetAddress make_ethernet_address( uint8_t n )
+{
+  return { 0x02, 0, 0, 0, 0, n };
+}
+
+// The frame an interface would receive if `sender` were answering its ARP request
+EthernetFrame arp_reply( const EthernetAddress& sender_eth,
+                         const Address& sender_ip,
+                         const EthernetAddress& target_eth,
+                         const Address& target_ip )
+{
+  ARPMessage arp;
+  arp.opcode = ARPMessage::OPCODE_REPLY;
+  arp.sender_ethernet_address = sender_eth;
+  arp.sender_ip_address = sender_ip.ipv4_numeric();
+  arp.target_ethernet_address = target_eth;
+  arp.target_ip_address = target_ip.ipv4_numeric();
+  return { { target_eth, sender_eth, EthernetHeader::TYPE_ARP }, serialize( arp ) };
+}
+
+void speed_test( const size_t num_routes,
+                 const size_t num_packets,
+                 const size_t random_seed,
+                 const size_t cache_entries = 0 )
+{
+  constexpr size_t num_interfaces = 4;
+  constexpr size_t num_distinct_frames = 4096;
+  constexpr size_t burst = 64; // frames received between calls to route()
+
+  default_random_engine rd { random_seed };
+
+  // Each interface sits on its own /24 (10.i.0.0), with one gateway (10.i.0.2) whose address is already known
+  Router router;
+  vector<shared_ptr<CountingPort>> ports;
+  vector<Address> gateways;
+  for ( size_t i = 0; i < num_interfaces; ++i ) {
+    const string subnet = "10." + to_string( i ) + ".0.";
+    const EthernetAddress local_eth = make_ethernet_address( 2 * i + 1 );
+    const EthernetAddress gateway_eth = make_ethernet_address( 2 * i + 2 );
+    const Address local_ip { subnet + "1" };
+    gateways.emplace_back( subnet + "2" );
+
+    ports.push_back( make_shared<CountingPort>() );
+    router.add_interface( make_shared<NetworkInterface>( "eth" + to_string( i ), ports.back(), local_eth, local_ip ) );
+    router.interface( i )->recv_frame( arp_reply( gateway_eth, gateways.back(), local_eth, local_ip ) );
+  }
+
+  // Random prefixes of every length from /8 to /24, each via some interface's gateway, plus a default route
+  vector<pair<uint32_t, uint8_t>> prefixes;
+  vector<Router::Route> routes { { 0, 0, gateways.at( 0 ), 0 } };
+  uniform_int_distribution<uint32_t> random_address;
+  uniform_int_distribution<uint8_t> random_length { 8, 24 };
+  uniform_int_distribution<size_t> random_interface { 0, num_interfaces - 1 };
+  for ( size_t i = 0; i < num_routes; ++i ) {
+    const uint8_t length = random_length( rd );
+    const uint32_t prefix = random_address( rd ) & ~( UINT32_MAX >> length );
+    const size_t interface_num = random_interface( rd );
+    routes.push_back( { prefix, length, gateways.at( interface_num ), interface_num } );
+    prefixes.emplace_back( prefix, length );
+  }
+  ranges::sort( routes, {}, []( const auto& route ) { return pair { route.prefix_length, route.prefix }; } );
+
+  // Load the table in bulk, then again from a snapshot of it
+  const auto load_start_time = steady_clock::now();
+  router.load_routes( routes );
+  const auto load_stop_time = steady_clock::now();
+
+  const vector<Router::Route> saved = router.routes();
+  const string snapshot = temporary_file();
+  router.save_snapshot( snapshot );
+  const auto snapshot_start_time = steady_clock::now();
+  router.load_snapshot( snapshot );
+  const auto snapshot_stop_time = steady_clock::now();
+  remove( snapshot.c_str() );
+  if ( not same_routes( router.routes(), saved ) ) {
+    throw runtime_error( "Routes loaded from the snapshot differ from those saved" );
+  }
+
+  // And one route at a time
+  Router one_by_one;
+  const auto add_start_time = steady_clock::now();
+  for ( const auto& route : routes ) {
+    one_by_one.add_route( route.prefix, route.prefix_length, route.next_hop, route.interface_num );
+  }
+  if ( not same_routes( one_by_one.routes(), saved ) ) {
+    throw runtime_error( "Routes added one at a time differ from those loaded in bulk" );
+  }
+  const auto add_stop_time = steady_clock::now();
+  router.set_route_cache( cache_entries );
+
+  // Datagrams to addresses inside the routes' prefixes (and some that only the default route matches),
+  // arriving on interface 0
+  vector<EthernetFrame> frames;
+  uniform_int_distribution<size_t> random_route { 0, prefixes.size() };
+  for ( size_t i = 0; i < num_distinct_frames; ++i ) {
+    InternetDatagram dgram;
+    dgram.header.src = Address { "192.168.0.1" }.ipv4_numeric();
+    dgram.header.dst = random_address( rd );
+    if ( const size_t route = random_route( rd ); route < prefixes.size() ) {
+      const auto [prefix, length] = prefixes.at( route );
+      dgram.header.dst = prefix | ( dgram.header.dst & ( UINT32_MAX >> length ) );
+    }
+    dgram.payload.emplace_back( string( 64, 'x' ) );
+    dgram.header.len = IPv4Header::LENGTH + dgram.payload.front().size();
+    dgram.header.compute_checksum();
+    frames.push_back(
+      { { make_ethernet_address( 1 ), make_ethernet_address( 2 ), EthernetHeader::TYPE_IPv4 }, serialize( dgram ) } );
+  }
+
+  NetworkInterface& incoming = *router.interface( 0 );
+
+  const auto start_time = steady_clock::now();
+  for ( size_t i = 0; i < num_packets; i += burst ) {
+    for ( size_t j = i; j < i + burst; ++j ) {
+      incoming.recv_frame( frames[j % num_distinct_frames] );
+    }
+    router.route();
+  }
+  const auto stop_time = steady_clock::now();
+
+  uint64_t frames_sent = 0;
+  for ( const auto& port : ports ) {
+    frames_sent += port->frames;
+  }
+  const size_t packets_routed = ( num_packets + burst - 1 ) / burst * burst;
+  if ( frames_sent != packets_routed ) {
+    throw runtime_error( "Mismatch between datagrams received and frames sent" );
+  }
+
+  const auto test_duration = duration_cast<duration<double>>( stop_time - start_time );
+  const double load_ms = duration_cast<duration<double, milli>>( load_stop_time - load_start_time ).count();
+  const double snapshot_ms
+    = duration_cast<duration<double, milli>>( snapshot_stop_time - snapshot_start_time ).count();
+  const double add_ms = duration_cast<duration<double, milli>>( add_stop_time - add_start_time ).count();
+  const double ns_per_packet = 1e9 * test_duration.count() / static_cast<double>( packets_routed );
+  const double million_packets_per_second = 1e3 / ns_per_packet;
+
+  fstream debug_output;
+  debug_output.open( "/dev/tty" );
+
+  string cache_description;
+  if ( cache_entries != 0 ) {
+    const auto& stats = router.route_cache_stats();
+    cache_description = ", " + to_string( cache_entries ) + "-entry route cache ("
+                        + to_string( 100 * stats.hits / ( stats.hits + stats.misses ) ) + "% hits)";
+  }
+
+  cout << "Router with " << num_interfaces << " interfaces and " << num_routes + 1 << " routes"
+       << cache_description << " forwarded " << packets_routed << " packets: " << fixed << setprecision( 2 )
+       << million_packets_per_second << " Mpps, " << ns_per_packet << " ns/packet. Loading the table took "
+       << load_ms << " ms in bulk, " << snapshot_ms << " ms from a snapshot, " << add_ms
+       << " ms one route at a time.\n";
+
+  debug_output << "             Router forwarding (" << num_routes + 1 << " routes" << cache_description
+               << "): " << fixed << setprecision( 2 ) << million_packets_per_second << " Mpps, " << ns_per_packet
+               << " ns/packet (table loads in " << snapshot_ms << " ms)\n";
+}
+
+void program_body()
+{
+  speed_test( 10, 1'000'000, 1 );
+  speed_test( 1'000, 1'000'000, 2 );
+  speed_test( 100'000, 1'000'000, 3 );
+  speed_test( 100'000, 1'000'000, 3, 8192 );
+}
+
+int main()
+{
+  try {
+    program_body();
+  } catch ( const exception& e ) {
+    cerr << "Exception: " << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
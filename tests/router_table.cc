@@ -0,0 +1,277 @@
+#include "router.hh"
+
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+using namespace std;
+
+namespace {
+
+// An output port that counts the frames sent through it
+class CountingPort : public NetworkInterface::OutputPort
+{
+public:
+  uint64_t frames {};
+
+  void transmit( const NetworkInterface& n [[maybe_unused]], const EthernetFrame& x [[maybe_unused]] ) override
+  {
+    ++frames;
+  }
+};
+
+uint32_t ip( const string& str )
+{
+  return Address { str }.ipv4_numeric();
+}
+
+string describe( const vector<Router::Route>& routes )
+{
+  string str;
+  for ( const auto& route : routes ) {
+    str += Address::from_ipv4_numeric( route.prefix ).ip() + "/" + to_string( route.prefix_length ) + " => "
+           + ( route.next_hop.has_value() ? route.next_hop->ip() : "(direct)" ) + " on "
+           + to_string( route.interface_num ) + "\n";
+  }
+  return str;
+}
+
+void expect_routes( const string& context, const Router& router, const vector<Router::Route>& expected )
+{
+  if ( describe( router.routes() ) != describe( expected ) ) {
+    throw runtime_error( context + ": expected routes\n" + describe( expected ) + "but found\n"
+                         + describe( router.routes() ) );
+  }
+}
+
+// A fresh file in the temporary directory (so that concurrent runs don't share it)
+string temporary_file()
+{
+  string path { ( filesystem::temp_directory_path() / "router_table_XXXXXX" ).string() };
+  const int fd { mkstemp( path.data() ) };
+  if ( fd < 0 ) {
+    throw runtime_error( "could not create a temporary file" );
+  }
+  close( fd );
+  return path;
+}
+
+// Give a router four interfaces (eth0 to eth3, with Ethernet addresses 02:00:00:00:00:0n)
+vector<shared_ptr<CountingPort>> add_interfaces( Router& router )
+{
+  vector<shared_ptr<CountingPort>> ports;
+  for ( uint8_t i = 0; i < 4; ++i ) {
+    ports.push_back( make_shared<CountingPort>() );
+    router.add_interface( make_shared<NetworkInterface>(
+      "eth" + to_string( i ), ports.back(), EthernetAddress { 0x02, 0, 0, 0, 0, i }, Address { "10.0.0.1" } ) );
+  }
+  return ports;
+}
+
+// Route a datagram for `destination` in through interface 0
+void route( Router& router, const string& destination )
+{
+  InternetDatagram dgram;
+  dgram.header.src = ip( "192.168.0.2" );
+  dgram.header.dst = ip( destination );
+  dgram.header.len = IPv4Header::LENGTH;
+  dgram.header.compute_checksum();
+  router.interface( 0 )->recv_frame(
+    { { { 0x02, 0, 0, 0, 0, 0 }, { 0x02, 0, 0, 0, 0, 0x99 }, EthernetHeader::TYPE_IPv4 }, serialize( dgram ) } );
+  router.route();
+}
+
+// Route a datagram for `destination`, and return the interface that sent it on
+// (each destination is new, so the interface sends exactly one frame: its ARP request)
+size_t forward( Router& router, const vector<shared_ptr<CountingPort>>& ports, const string& destination )
+{
+  vector<uint64_t> before;
+  for ( const auto& port : ports ) {
+    before.push_back( port->frames );
+  }
+
+  route( router, destination );
+
+  for ( size_t i = 0; i < ports.size(); ++i ) {
+    if ( ports[i]->frames != before[i] ) {
+      return i;
+    }
+  }
+  throw runtime_error( "datagram for " + destination + " was not forwarded" );
+}
+
+void expect_forward( Router& router,
+                     const vector<shared_ptr<CountingPort>>& ports,
+                     const string& destination,
+                     size_t expected )
+{
+  if ( const size_t actual = forward( router, ports, destination ); actual != expected ) {
+    throw runtime_error( "datagram for " + destination + " left on interface " + to_string( actual )
+                         + " instead of " + to_string( expected ) );
+  }
+}
+
+void test_router_table()
+{
+  const vector<Router::Route> routes {
+    { 0, 0, Address { "10.0.0.2" }, 0 },
+    { ip( "18.0.0.0" ), 8, {}, 1 },
+    { ip( "171.64.0.0" ), 16, Address { "10.1.0.2" }, 1 },
+    { ip( "171.67.0.0" ), 16, {}, 2 },
+    { ip( "171.67.76.0" ), 24, {}, 3 },
+  };
+
+  // add_route, one at a time, and load_routes, all at once, give the same table
+  Router one_by_one;
+  for ( const auto& route : routes ) {
+    one_by_one.add_route( route.prefix, route.prefix_length, route.next_hop, route.interface_num );
+  }
+  expect_routes( "add_route", one_by_one, routes );
+
+  Router router;
+  const auto ports = add_interfaces( router );
+  router.load_routes( routes );
+  expect_routes( "load_routes", router, routes );
+  expect_forward( router, ports, "1.2.3.4", 0 );
+  expect_forward( router, ports, "18.5.6.7", 1 );
+  expect_forward( router, ports, "171.67.1.1", 2 );
+  expect_forward( router, ports, "171.67.76.46", 3 );
+
+  // A snapshot restores the same table
+  const string path = temporary_file();
+  router.save_snapshot( path );
+  Router restored;
+  restored.load_snapshot( path );
+  remove( path.c_str() );
+  expect_routes( "load_snapshot", restored, routes );
+
+  // A diff withdraws, replaces and adds routes at once
+  Router::RouteDiff diff;
+  diff.remove.emplace_back( ip( "171.67.76.0" ), 24 );
+  diff.remove.emplace_back( ip( "99.0.0.0" ), 8 ); // not in the table
+  diff.add.push_back( { ip( "18.0.0.0" ), 8, {}, 2 } );
+  diff.add.push_back( { ip( "171.67.128.0" ), 17, {}, 3 } );
+  router.apply_routes( diff );
+  expect_routes( "apply_routes",
+                 router,
+                 {
+                   { 0, 0, Address { "10.0.0.2" }, 0 },
+                   { ip( "18.0.0.0" ), 8, {}, 2 },
+                   { ip( "171.64.0.0" ), 16, Address { "10.1.0.2" }, 1 },
+                   { ip( "171.67.0.0" ), 16, {}, 2 },
+                   { ip( "171.67.128.0" ), 17, {}, 3 },
+                 } );
+  expect_forward( router, ports, "18.5.6.8", 2 );
+  expect_forward( router, ports, "171.67.76.47", 2 );
+  expect_forward( router, ports, "171.67.200.1", 3 );
+
+  // Routes added one at a time (and not yet seen) are kept by apply_routes, and replaced by load_routes
+  Router staged;
+  staged.add_route( ip( "18.0.0.0" ), 8, {}, 1 );
+  Router::RouteDiff another;
+  another.add.push_back( { ip( "171.67.0.0" ), 16, {}, 2 } );
+  staged.apply_routes( another );
+  staged.add_route( ip( "171.64.0.0" ), 16, Address { "10.1.0.2" }, 1 );
+  expect_routes( "add_route and apply_routes",
+                 staged,
+                 {
+                   { ip( "18.0.0.0" ), 8, {}, 1 },
+                   { ip( "171.64.0.0" ), 16, Address { "10.1.0.2" }, 1 },
+                   { ip( "171.67.0.0" ), 16, {}, 2 },
+                 } );
+  staged.add_route( ip( "99.0.0.0" ), 8, {}, 1 );
+  staged.load_routes( routes );
+  expect_routes( "add_route and load_routes", staged, routes );
+
+  // A host route (/32) is the longest prefix of all, and survives a snapshot
+  Router host;
+  const auto host_ports = add_interfaces( host );
+  host.load_routes( routes );
+  host.add_route( ip( "171.67.76.46" ), 32, {}, 0 );
+  expect_forward( host, host_ports, "171.67.76.46", 0 );
+  expect_forward( host, host_ports, "171.67.76.45", 3 );
+
+  vector<Router::Route> with_host { routes };
+  with_host.push_back( { ip( "171.67.76.46" ), 32, {}, 0 } );
+  const string host_path = temporary_file();
+  host.save_snapshot( host_path );
+  Router host_restored;
+  const auto restored_ports = add_interfaces( host_restored );
+  host_restored.load_snapshot( host_path );
+  remove( host_path.c_str() );
+  expect_routes( "load_snapshot with a host route", host_restored, with_host );
+  expect_forward( host_restored, restored_ports, "171.67.76.46", 0 );
+
+  // ... and can be withdrawn
+  Router::RouteDiff withdraw;
+  withdraw.remove.emplace_back( ip( "171.67.76.46" ), 32 );
+  host_restored.apply_routes( withdraw );
+  expect_routes( "apply_routes removing a host route", host_restored, routes );
+  expect_forward( host_restored, restored_ports, "171.67.76.46", 3 );
+}
+
+void expect_cache_stats( const Router& router, uint64_t hits, uint64_t misses )
+{
+  const auto& stats = router.route_cache_stats();
+  if ( stats.hits != hits or stats.misses != misses ) {
+    throw runtime_error( "expected " + to_string( hits ) + " route cache hits and " + to_string( misses )
+                         + " misses, but found " + to_string( stats.hits ) + " and " + to_string( stats.misses ) );
+  }
+}
+
+void test_route_cache()
+{
+  Router router;
+  const auto ports = add_interfaces( router );
+  router.add_route( ip( "18.0.0.0" ), 8, {}, 1 );
+  router.add_route( ip( "171.67.0.0" ), 16, Address { "10.1.0.2" }, 2 );
+  router.set_route_cache( 6 ); // rounded up to 8
+
+  expect_forward( router, ports, "18.1.1.1", 1 );
+  expect_cache_stats( router, 0, 1 );
+  route( router, "18.1.1.1" ); // queued behind the ARP request, but routed from the cache
+  expect_cache_stats( router, 1, 1 );
+  expect_forward( router, ports, "171.67.1.1", 2 );
+  route( router, "171.67.1.1" );
+  expect_cache_stats( router, 2, 2 );
+
+  // Destinations without a route are cached too
+  route( router, "99.1.1.1" );
+  route( router, "99.1.1.1" );
+  expect_cache_stats( router, 3, 3 );
+
+  // Any change to the table invalidates the cache
+  Router::RouteDiff diff;
+  diff.add.push_back( { ip( "18.0.0.0" ), 8, {}, 2 } );
+  router.apply_routes( diff );
+  expect_forward( router, ports, "18.1.1.1", 2 );
+  expect_cache_stats( router, 3, 4 );
+
+  router.add_route( ip( "18.1.0.0" ), 16, {}, 3 );
+  expect_forward( router, ports, "18.1.1.1", 3 );
+  expect_cache_stats( router, 3, 5 );
+
+  router.add_route( ip( "99.0.0.0" ), 8, {}, 1 );
+  expect_forward( router, ports, "99.1.1.1", 1 );
+  expect_cache_stats( router, 3, 6 );
+}
+
+} // namespace
+
+int main()
+{
+  try {
+    test_router_table();
+    test_route_cache();
+  } catch ( const exception& e ) {
+    cerr << "\033[31;1mError: " << e.what() << "\033[m\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,125 @@
+#include "random.hh"
+#include "sender_test_harness.hh"
+
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <string>
+
+using namespace std;
+
+int main()
+{
+  try {
+    auto rd = get_random_engine();
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn( rd() );
+      cfg.isn = isn;
+
+      TCPSenderTestHarness test { "Nagle holds small writes while data is in flight", cfg };
+      test.execute( SetNagle { true } );
+      test.execute( Push {} );
+      test.execute( ExpectMessage {}.with_no_flags().with_syn( true ).with_payload_size( 0 ).with_seqno( isn ) );
+      test.execute( AckReceived { Wrap32 { isn + 1 } }.with_win( 5000 ) );
+      test.execute( Push( "a" ) );
+      test.execute( ExpectMessage {}.with_no_flags().with_data( "a" ).with_seqno( isn + 1 ) );
+      test.execute( Push( "b" ) );
+      test.execute( ExpectNoSegment {} );
+      test.execute( Push( "c" ) );
+      test.execute( ExpectNoSegment {} );
+      test.execute( ExpectSeqnosInFlight { 1 } );
+      test.execute( AckReceived { Wrap32 { isn + 2 } }.with_win( 5000 ) );
+      test.execute( ExpectMessage {}.with_no_flags().with_data( "bc" ).with_seqno( isn + 2 ) );
+      test.execute( ExpectNoSegment {} );
+    }
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn( rd() );
+      cfg.isn = isn;
+
+      TCPSenderTestHarness test { "Nagle still sends full segments and the FIN", cfg };
+      test.execute( SetNagle { true } );
+      test.execute( Push {} );
+      test.execute( ExpectMessage {}.with_no_flags().with_syn( true ).with_payload_size( 0 ).with_seqno( isn ) );
+      test.execute( AckReceived { Wrap32 { isn + 1 } }.with_win( 5000 ) );
+      test.execute( Push( "x" ) );
+      test.execute( ExpectMessage {}.with_no_flags().with_data( "x" ).with_seqno( isn + 1 ) );
+      test.execute( Push( string( TCPConfig::MAX_PAYLOAD_SIZE + 10, 'y' ) ) );
+      test.execute( ExpectMessage {}.with_no_flags().with_payload_size( TCPConfig::MAX_PAYLOAD_SIZE ) );
+      test.execute( ExpectNoSegment {} );
+      test.execute( Close {} );
+      test.execute( ExpectMessage {}.with_payload_size( 10 ).with_fin( true ) );
+      test.execute( ExpectNoSegment {} );
+    }
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn( rd() );
+      cfg.isn = isn;
+
+      TCPSenderTestHarness test { "Cork holds small writes until flushed", cfg };
+      test.execute( Push {} );
+      test.execute( ExpectMessage {}.with_no_flags().with_syn( true ).with_payload_size( 0 ).with_seqno( isn ) );
+      test.execute( AckReceived { Wrap32 { isn + 1 } }.with_win( 5000 ) );
+      test.execute( SetCork { true } );
+      test.execute( Push( "abc" ) );
+      test.execute( ExpectNoSegment {} );
+      test.execute( Push( "def" ) );
+      test.execute( ExpectNoSegment {} );
+      test.execute( ExpectSeqnosInFlight { 0 } );
+      test.execute( Flush {} );
+      test.execute( ExpectMessage {}.with_no_flags().with_data( "abcdef" ).with_seqno( isn + 1 ) );
+      test.execute( ExpectNoSegment {} );
+      test.execute( Push( "ghi" ) );
+      test.execute( ExpectNoSegment {} );
+      test.execute( SetCork { false } );
+      test.execute( Push {} );
+      test.execute( ExpectMessage {}.with_no_flags().with_data( "ghi" ).with_seqno( isn + 7 ) );
+      test.execute( ExpectNoSegment {} );
+    }
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn( rd() );
+      cfg.isn = isn;
+
+      TCPSenderTestHarness test { "Cork does not hold back a zero-window probe", cfg };
+      test.execute( Push {} );
+      test.execute( ExpectMessage {}.with_no_flags().with_syn( true ).with_payload_size( 0 ).with_seqno( isn ) );
+      test.execute( AckReceived { Wrap32 { isn + 1 } }.with_win( 0 ) );
+      test.execute( SetCork { true } );
+      test.execute( Push( "abc" ) );
+      test.execute( ExpectMessage {}.with_no_flags().with_data( "a" ).with_seqno( isn + 1 ) );
+      test.execute( ExpectNoSegment {} );
+    }
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn( rd() );
+      cfg.isn = isn;
+
+      TCPSenderTestHarness test { "Cork does not hold back the SYN, even once there is a window", cfg };
+      test.execute( SetCork { true } );
+      test.execute( Receive { { std::nullopt, 5000 } }.without_push() ); // e.g. from the peer's SYN
+      test.execute( Push {} );
+      test.execute( ExpectMessage {}.with_no_flags().with_syn( true ).with_payload_size( 0 ).with_seqno( isn ) );
+      test.execute( ExpectNoSegment {} );
+      test.execute( AckReceived { Wrap32 { isn + 1 } }.with_win( 5000 ) );
+      test.execute( Push( "abc" ) );
+      test.execute( ExpectNoSegment {} );
+      test.execute( SetCork { false } );
+      test.execute( Push {} );
+      test.execute( ExpectMessage {}.with_no_flags().with_data( "abc" ).with_seqno( isn + 1 ) );
+      test.execute( ExpectNoSegment {} );
+    }
+  } catch ( const exception& e ) {
+    cerr << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,123 @@
+#include "random.hh"
+#include "sender_test_harness.hh"
+
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <string>
+
+using namespace std;
+
+int main()
+{
+  try {
+    auto rd = get_random_engine();
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn( rd() );
+      cfg.isn = isn;
+      cfg.rt_timeout = 10000;
+
+      TCPSenderTestHarness test { "Pacing spaces out a window of segments", cfg };
+      test.execute( SetPacing { 100'000 } ); // 100 bytes per millisecond
+      test.execute( Push {} );
+      test.execute( ExpectMessage {}.with_no_flags().with_syn( true ).with_payload_size( 0 ).with_seqno( isn ) );
+      test.execute( AckReceived { Wrap32 { isn + 1 } }.with_win( 10000 ) );
+      test.execute( Push( string( 5 * TCPConfig::MAX_PAYLOAD_SIZE, 'x' ) ) );
+      // The bucket starts with two segments' worth of tokens.
+      test.execute( ExpectMessage {}.with_payload_size( TCPConfig::MAX_PAYLOAD_SIZE ).with_seqno( isn + 1 ) );
+      test.execute( ExpectMessage {}.with_payload_size( TCPConfig::MAX_PAYLOAD_SIZE ) );
+      test.execute( ExpectNoSegment {} );
+      test.execute( Tick { 5 } );
+      test.execute( ExpectNoSegment {} );
+      test.execute( Tick { 5 } );
+      test.execute( ExpectMessage {}.with_payload_size( TCPConfig::MAX_PAYLOAD_SIZE ) );
+      test.execute( ExpectNoSegment {} );
+      test.execute( Tick { 20 } );
+      test.execute( ExpectMessage {}.with_payload_size( TCPConfig::MAX_PAYLOAD_SIZE ) );
+      test.execute( ExpectMessage {}.with_payload_size( TCPConfig::MAX_PAYLOAD_SIZE ) );
+      test.execute( ExpectNoSegment {} );
+      test.execute( ExpectSeqnosInFlight { 5 * TCPConfig::MAX_PAYLOAD_SIZE } );
+    }
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn( rd() );
+      cfg.isn = isn;
+      cfg.rt_timeout = 10000;
+
+      TCPSenderTestHarness test { "Pacing without a configured rate follows window / RTT", cfg };
+      test.execute( SetPacing { 0 } );
+      test.execute( Push {} );
+      test.execute( ExpectMessage {}.with_no_flags().with_syn( true ).with_payload_size( 0 ).with_seqno( isn ) );
+      test.execute( Tick { 10 } );
+      test.execute( AckReceived { Wrap32 { isn + 1 } }.with_win( 4000 ) ); // 4000 bytes per 10 ms
+      test.execute( Push( string( 3 * TCPConfig::MAX_PAYLOAD_SIZE, 'x' ) ) );
+      test.execute( ExpectMessage {}.with_payload_size( TCPConfig::MAX_PAYLOAD_SIZE ) );
+      test.execute( ExpectMessage {}.with_payload_size( TCPConfig::MAX_PAYLOAD_SIZE ) );
+      test.execute( ExpectNoSegment {} );
+      test.execute( Tick { 2 } );
+      test.execute( ExpectNoSegment {} );
+      test.execute( Tick { 1 } );
+      test.execute( ExpectMessage {}.with_payload_size( TCPConfig::MAX_PAYLOAD_SIZE ) );
+      test.execute( ExpectNoSegment {} );
+    }
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn( rd() );
+      cfg.isn = isn;
+      cfg.rt_timeout = 10000;
+
+      TCPSenderTestHarness test { "Pacing takes an RTT under a tick to be a tick", cfg };
+      test.execute( SetPacing { 0 } );
+      test.execute( Push {} );
+      test.execute( ExpectMessage {}.with_no_flags().with_syn( true ).with_payload_size( 0 ).with_seqno( isn ) );
+      test.execute( ExpectPacingRate { 0 } ); // no RTT sample yet
+      test.execute( Tick { 1 } );
+      test.execute( AckReceived { Wrap32 { isn + 1 } }.with_win( 4000 ) );
+      test.execute( ExpectPacingRate { 4'000'000 } ); // 4000 bytes per millisecond
+      test.execute( Push( string( TCPConfig::MAX_PAYLOAD_SIZE, 'x' ) ) );
+      test.execute( ExpectMessage {}.with_payload_size( TCPConfig::MAX_PAYLOAD_SIZE ) );
+      // Acknowledged within the same tick: the smoothed RTT falls to 875 us, but the rate stays at a window per
+      // tick rather than pacing stopping altogether
+      test.execute( AckReceived { Wrap32 { isn + 1 + TCPConfig::MAX_PAYLOAD_SIZE } }.with_win( 4000 ) );
+      test.execute( ExpectPacingRate { 4'000'000 } );
+    }
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn( rd() );
+      cfg.isn = isn;
+      cfg.rt_timeout = 10000;
+
+      TCPSenderTestHarness test { "Pacing still spreads out sends when the RTT is under a tick", cfg };
+      test.execute( SetPacing { 0 } );
+      test.execute( Push {} );
+      test.execute( ExpectMessage {}.with_no_flags().with_syn( true ).with_payload_size( 0 ).with_seqno( isn ) );
+      // Acknowledged before any time passes: the RTT is measured as 1 us
+      test.execute( AckReceived { Wrap32 { isn + 1 } }.with_win( 10000 ) );
+      test.execute( Push( string( 10 * TCPConfig::MAX_PAYLOAD_SIZE, 'x' ) ) );
+      test.execute( ExpectMessage {}.with_payload_size( TCPConfig::MAX_PAYLOAD_SIZE ).with_seqno( isn + 1 ) );
+      test.execute( ExpectMessage {}.with_payload_size( TCPConfig::MAX_PAYLOAD_SIZE ) );
+      test.execute( ExpectNoSegment {} );
+      // A long tick refills no more than the bucket's depth of four segments, not the whole window
+      for ( int round = 0; round < 2; ++round ) {
+        test.execute( Tick { 10 } );
+        test.execute( ExpectPacingRate { 1'000'000 } ); // a window per 10 ms tick
+        for ( int i = 0; i < 4; ++i ) {
+          test.execute( ExpectMessage {}.with_payload_size( TCPConfig::MAX_PAYLOAD_SIZE ) );
+        }
+        test.execute( ExpectNoSegment {} );
+      }
+      test.execute( ExpectSeqnosInFlight { 10 * TCPConfig::MAX_PAYLOAD_SIZE } );
+    }
+  } catch ( const exception& e ) {
+    cerr << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,79 @@
+#include "random.hh"
+#include "sender_test_harness.hh"
+
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <string>
+
+using namespace std;
+
+int main()
+{
+  try {
+    auto rd = get_random_engine();
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn( rd() );
+      cfg.isn = isn;
+
+      TCPSenderTestHarness test { "Retransmissions, zero windows and limited time are counted", cfg };
+      test.execute( RecordStats {} );
+      test.execute( Push {} );
+      test.execute( ExpectMessage {}.with_syn( true ).with_seqno( isn ) );
+      test.execute( AckReceived { isn + 1 } );
+
+      // A timeout with the window open
+      test.execute( Push( "hello" ) );
+      test.execute( ExpectMessage {}.with_data( "hello" ).with_seqno( isn + 1 ) );
+      test.execute( Tick { cfg.rt_timeout - 1U } );
+      test.execute( ExpectNoSegment {} );
+      test.execute( Tick { 1 } );
+      test.execute( ExpectMessage {}.with_data( "hello" ).with_seqno( isn + 1 ) );
+      test.execute( ExpectStat { "retransmits_timeout", &TCPStats::retransmits_timeout, 1 } );
+      test.execute( ExpectStat { "retransmits_window_probe", &TCPStats::retransmits_window_probe, 0 } );
+      test.execute( ExpectStat { "app_limited_ms", &TCPStats::app_limited_ms, cfg.rt_timeout } );
+      test.execute( ExpectStat { "window_limited_ms", &TCPStats::window_limited_ms, 0 } );
+      test.execute( ExpectStat { "zero_window_events", &TCPStats::zero_window_events, 0 } );
+
+      // The window closes with data waiting: a probe, sent again on each timeout
+      test.execute( Receive { { isn + 6, 0 } }.without_push() );
+      test.execute( ExpectStat { "zero_window_events", &TCPStats::zero_window_events, 1 } );
+      test.execute( Push( "xyz" ) );
+      test.execute( ExpectMessage {}.with_data( "x" ).with_seqno( isn + 6 ) );
+      test.execute( Tick { cfg.rt_timeout } );
+      test.execute( ExpectMessage {}.with_data( "x" ).with_seqno( isn + 6 ) );
+      test.execute( ExpectNoSegment {} );
+      test.execute( ExpectStat { "retransmits_timeout", &TCPStats::retransmits_timeout, 1 } );
+      test.execute( ExpectStat { "retransmits_window_probe", &TCPStats::retransmits_window_probe, 1 } );
+      test.execute( ExpectStat { "window_limited_ms", &TCPStats::window_limited_ms, cfg.rt_timeout } );
+      test.execute( ExpectStat { "app_limited_ms", &TCPStats::app_limited_ms, cfg.rt_timeout } );
+
+      // A window of one byte keeps the sender window-limited; closing again is a second event
+      test.execute( Receive { { isn + 7, 1 } } );
+      test.execute( ExpectMessage {}.with_data( "y" ).with_seqno( isn + 7 ) );
+      test.execute( Tick { 500 } );
+      test.execute( ExpectNoSegment {} );
+      test.execute( ExpectStat { "window_limited_ms", &TCPStats::window_limited_ms, cfg.rt_timeout + 500U } );
+      test.execute( Receive { { isn + 8, 0 } } );
+      test.execute( ExpectMessage {}.with_data( "z" ).with_seqno( isn + 8 ) );
+      test.execute( ExpectStat { "zero_window_events", &TCPStats::zero_window_events, 2 } );
+
+      // Everything acknowledged and the window open: the application is the limit again
+      test.execute( Receive { { isn + 9, 1000 } } );
+      test.execute( Tick { 300 } );
+      test.execute( ExpectNoSegment {} );
+      test.execute( ExpectStat { "app_limited_ms", &TCPStats::app_limited_ms, cfg.rt_timeout + 300U } );
+      test.execute( ExpectStat { "window_limited_ms", &TCPStats::window_limited_ms, cfg.rt_timeout + 500U } );
+      test.execute( ExpectStat { "retransmits_timeout", &TCPStats::retransmits_timeout, 1 } );
+      test.execute( ExpectStat { "retransmits_window_probe", &TCPStats::retransmits_window_probe, 1 } );
+    }
+  } catch ( const exception& e ) {
+    cerr << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
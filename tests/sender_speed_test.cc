@@ -0,0 +1,108 @@
+#include "tcp_config.hh"
+#include "tcp_sender.hh"
+#include "tcp_sender_message.hh"
+
+#include <chrono>
+#include <cstddef>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <queue>
+#include <random>
+
+using namespace std;
+using namespace std::chrono;
+
+void speed_test( const size_t input_len,   // NOLINT(bugprone-easily-swappable-parameters)
+                 const size_t capacity,    // NOLINT(bugprone-easily-swappable-parameters)
+                 const size_t random_seed, // NOLINT(bugprone-easily-swappable-parameters)
+                 const size_t write_size,  // NOLINT(bugprone-easily-swappable-parameters)
+                 const uint16_t window )
+{
+  // Generate the data to be written
+  const string data = [&random_seed, &input_len] {
+    default_random_engine rd { random_seed };
+    uniform_int_distribution<char> ud;
+    string ret;
+    for ( size_t i = 0; i < input_len; ++i ) {
+      ret += ud( rd );
+    }
+    return ret;
+  }();
+
+  // Split the data into segments before writing
+  queue<string> split_data;
+  for ( size_t i = 0; i < data.size(); i += write_size ) {
+    split_data.emplace( data.substr( i, write_size ) );
+  }
+
+  const Wrap32 isn { static_cast<uint32_t>( random_seed ) };
+  TCPSender sender { ByteStream { capacity }, isn, TCPConfig::TIMEOUT_DFLT };
+  string output_data;
+  output_data.reserve( data.size() );
+  uint64_t next_ackno {};
+  size_t segments {};
+
+  const auto transmit = [&]( const TCPSenderMessage& msg ) {
+    output_data += msg.payload;
+    next_ackno += msg.sequence_length();
+    ++segments;
+  };
+
+  const auto start_time = steady_clock::now();
+  while ( not sender.reader().is_finished() or sender.sequence_numbers_in_flight() != 0 ) {
+    while ( not split_data.empty() and split_data.front().size() <= sender.writer().available_capacity() ) {
+      sender.writer().push( move( split_data.front() ) );
+      split_data.pop();
+    }
+    if ( split_data.empty() and not sender.writer().is_closed() ) {
+      sender.writer().close();
+    }
+
+    sender.push( transmit );
+    sender.receive( { Wrap32::wrap( next_ackno, isn ), window, false } );
+  }
+
+  const auto stop_time = steady_clock::now();
+
+  if ( data != output_data ) {
+    throw runtime_error( "Mismatch between data written and sent" );
+  }
+
+  auto test_duration = duration_cast<duration<double>>( stop_time - start_time );
+  auto bytes_per_second = static_cast<double>( input_len ) / test_duration.count();
+  auto bits_per_second = 8 * bytes_per_second;
+  auto gigabits_per_second = bits_per_second / 1e9;
+
+  fstream debug_output;
+  debug_output.open( "/dev/tty" );
+
+  cout << "TCPSender with capacity=" << capacity << ", write_size=" << write_size << ", window=" << window
+       << " sent " << segments << " segments at " << fixed << setprecision( 2 ) << gigabits_per_second
+       << " Gbit/s.\n";
+
+  debug_output << "             TCPSender throughput: " << fixed << setprecision( 2 ) << gigabits_per_second
+               << " Gbit/s\n";
+
+  if ( gigabits_per_second < 0.1 ) {
+    throw runtime_error( "TCPSender did not meet minimum speed of 0.1 Gbit/s." );
+  }
+}
+
+void program_body()
+{
+  speed_test( 1e7, 64000, 789, 1500, 65535 );
+  speed_test( 1e7, 64000, 790, 128, 65535 );
+}
+
+int main()
+{
+  try {
+    program_body();
+  } catch ( const exception& e ) {
+    cerr << "Exception: " << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
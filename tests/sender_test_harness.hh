@@ -5,8 +5,10 @@
 #include "tcp_receiver_message.hh"
 #include "tcp_segment.hh"
 #include "tcp_sender.hh"
+#include "tcp_stats.hh"
 #include "wrapping_integers.hh"
 
+#include <memory>
 #include <optional>
 #include <queue>
 #include <sstream>
@@ -18,6 +20,7 @@ struct SenderAndOutput
 {
   TCPSender sender;
   std::queue<TCPSenderMessage> output {};
+  std::shared_ptr<TCPStats> stats {};
 
   auto make_transmit()
   {
@@ -80,6 +83,32 @@ struct ExpectConsecutiveRetransmissions : public ExpectNumber<SenderAndOutput, u
   uint64_t value( SenderAndOutput& ss ) const override { return ss.sender.consecutive_retransmissions(); }
 };
 
+struct ExpectPacingRate : public ExpectNumber<SenderAndOutput, uint64_t>
+{
+  using ExpectNumber::ExpectNumber;
+  std::string name() const override { return "pacing_rate"; }
+  uint64_t value( SenderAndOutput& ss ) const override { return ss.sender.pacing_rate(); }
+};
+
+// One of the TCPStats counters, once RecordStats has given the sender somewhere to keep them
+struct ExpectStat : public ExpectNumber<SenderAndOutput, uint64_t>
+{
+  std::string name_;
+  StatCounter TCPStats::*counter_;
+
+  ExpectStat( std::string name, StatCounter TCPStats::*counter, uint64_t value )
+    : ExpectNumber( value ), name_( std::move( name ) ), counter_( counter )
+  {}
+  std::string name() const override { return "stats." + name_; }
+  uint64_t value( SenderAndOutput& ss ) const override
+  {
+    if ( not ss.stats ) {
+      throw std::runtime_error( "inconsistent test: ExpectStat without RecordStats" );
+    }
+    return ( ss.stats.get()->*counter_ ).value();
+  }
+};
+
 struct ExpectNoSegment : public Expectation<SenderAndOutput>
 {
   std::string description() const override { return "nothing to send"; }
@@ -104,6 +133,49 @@ struct HasError : public ExpectBool<SenderAndOutput>
   bool value( SenderAndOutput& ss ) const override { return ss.sender.writer().has_error(); }
 };
 
+struct SetNagle : public Action<SenderAndOutput>
+{
+  bool enabled_;
+
+  explicit SetNagle( bool enabled ) : enabled_( enabled ) {}
+  std::string description() const override { return std::string( enabled_ ? "enable" : "disable" ) + " Nagle"; }
+  void execute( SenderAndOutput& ss ) const override { ss.sender.set_nagle( enabled_ ); }
+};
+
+struct SetCork : public Action<SenderAndOutput>
+{
+  bool enabled_;
+
+  explicit SetCork( bool enabled ) : enabled_( enabled ) {}
+  std::string description() const override { return enabled_ ? "cork" : "uncork"; }
+  void execute( SenderAndOutput& ss ) const override { ss.sender.set_cork( enabled_ ); }
+};
+
+struct SetPacing : public Action<SenderAndOutput>
+{
+  uint64_t rate_Bps_;
+
+  explicit SetPacing( uint64_t rate_Bps ) : rate_Bps_( rate_Bps ) {}
+  std::string description() const override { return "pace at " + std::to_string( rate_Bps_ ) + " bytes/s"; }
+  void execute( SenderAndOutput& ss ) const override { ss.sender.set_pacing( true, rate_Bps_ ); }
+};
+
+struct RecordStats : public Action<SenderAndOutput>
+{
+  std::string description() const override { return "record statistics"; }
+  void execute( SenderAndOutput& ss ) const override
+  {
+    ss.stats = std::make_shared<TCPStats>();
+    ss.sender.set_stats( ss.stats );
+  }
+};
+
+struct Flush : public Action<SenderAndOutput>
+{
+  std::string description() const override { return "flush TCPSender"; }
+  void execute( SenderAndOutput& ss ) const override { ss.sender.flush( ss.make_transmit() ); }
+};
+
 struct Push : public Action<SenderAndOutput>
 {
   std::string data_;
@@ -0,0 +1,206 @@
+#include "emulator_adapter.hh"
+#include "fd_adapter.hh"
+#include "tcp_config.hh"
+#include "tcp_peer.hh"
+#include "tuntap_adapter.hh"
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <ctime>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <queue>
+#include <random>
+
+using namespace std;
+using namespace std::chrono;
+
+// One end of an in-process wire: what is written at one end is read at the other
+class LoopbackAdapter : public FdAdapterBase
+{
+  shared_ptr<queue<TCPMessage>> inbound_;
+  shared_ptr<queue<TCPMessage>> outbound_;
+
+public:
+  LoopbackAdapter( shared_ptr<queue<TCPMessage>> inbound, shared_ptr<queue<TCPMessage>> outbound )
+    : inbound_( move( inbound ) ), outbound_( move( outbound ) )
+  {}
+
+  optional<TCPMessage> read()
+  {
+    if ( inbound_->empty() ) {
+      return {};
+    }
+    TCPMessage msg { move( inbound_->front() ) };
+    inbound_->pop();
+    return msg;
+  }
+
+  void write( const TCPMessage& msg ) { outbound_->push( msg ); }
+};
+
+static_assert( TCPDatagramAdapter<EmulatorAdapter<LoopbackAdapter>> );
+
+void speed_test( const size_t input_len,
+                 const string& link_name,
+                 const EmulatorConfig& link_config,
+                 const size_t random_seed )
+{
+  // Generate the data to be transferred
+  const string data = [&] {
+    default_random_engine rd { random_seed };
+    uniform_int_distribution<char> ud;
+    string ret;
+    for ( size_t i = 0; i < input_len; ++i ) {
+      ret += ud( rd );
+    }
+    return ret;
+  }();
+
+  TCPConfig client_config;
+  client_config.isn = Wrap32 { static_cast<uint32_t>( random_seed ) };
+  client_config.rt_timeout = 4 * link_config.delay_ms + client_config.ack_delay; // no spurious timeouts
+  TCPConfig server_config;
+  server_config.isn = Wrap32 { static_cast<uint32_t>( random_seed * 7 ) };
+  server_config.rt_timeout = client_config.rt_timeout;
+  // The application reads once per millisecond; a receive buffer larger than the (16-bit) window keeps the
+  // window from closing in between, so the transfer is limited by the window rather than by zero-window probes
+  server_config.recv_capacity = 4 * TCPConfig::DEFAULT_CAPACITY;
+
+  TCPPeer client { client_config };
+  TCPPeer server { server_config };
+  // Each end shapes what it sends, so the two together emulate both directions of the link
+  auto client_to_server = make_shared<queue<TCPMessage>>();
+  auto server_to_client = make_shared<queue<TCPMessage>>();
+  EmulatorAdapter<LoopbackAdapter> client_side {
+    LoopbackAdapter { server_to_client, client_to_server }, link_config, default_random_engine { random_seed } };
+  EmulatorAdapter<LoopbackAdapter> server_side {
+    LoopbackAdapter { client_to_server, server_to_client }, link_config, default_random_engine { random_seed + 1 } };
+
+  uint64_t now_ms = 0;
+
+  const auto client_transmit = [&]( const TCPMessage& msg ) { client_side.write( msg ); };
+  const auto server_transmit = [&]( const TCPMessage& msg ) { server_side.write( msg ); };
+
+  size_t bytes_written = 0;
+  size_t bytes_read = 0;
+  const uint64_t time_limit_ms = 3'600'000;
+
+  const auto start_time = steady_clock::now();
+  const clock_t start_cpu = clock();
+  while ( not server.inbound_reader().is_finished() ) {
+    if ( now_ms > time_limit_ms or not server.active() ) {
+      throw runtime_error( "Transfer did not finish" );
+    }
+
+    // The application writes as much as the send buffer will take
+    Writer& writer = client.outbound_writer();
+    if ( not writer.is_closed() ) {
+      const size_t len = min( writer.available_capacity(), data.size() - bytes_written );
+      writer.push( data.substr( bytes_written, len ) );
+      bytes_written += len;
+      if ( bytes_written == data.size() ) {
+        writer.close();
+      }
+      client.push( client_transmit );
+    }
+
+    // Deliver what has arrived
+    while ( auto msg = server_side.read() ) {
+      server.receive( move( *msg ), server_transmit );
+    }
+    while ( auto msg = client_side.read() ) {
+      client.receive( move( *msg ), client_transmit );
+    }
+
+    // The application reads everything that has arrived
+    Reader& reader = server.inbound_reader();
+    while ( reader.bytes_buffered() ) {
+      const string_view chunk = reader.peek();
+      if ( data.compare( bytes_read, chunk.size(), chunk ) != 0 ) {
+        throw runtime_error( "Mismatch between data written and read" );
+      }
+      bytes_read += chunk.size();
+      reader.pop( chunk.size() );
+    }
+
+    ++now_ms;
+    client.tick( 1, client_transmit );
+    server.tick( 1, server_transmit );
+    client_side.tick( 1 );
+    server_side.tick( 1 );
+  }
+  const clock_t stop_cpu = clock();
+  const auto stop_time = steady_clock::now();
+
+  if ( bytes_read != data.size() ) {
+    throw runtime_error( "Stream finished early" );
+  }
+
+  const auto test_duration = duration_cast<duration<double>>( stop_time - start_time );
+  const double gigabits_per_second = 8 * static_cast<double>( input_len ) / test_duration.count() / 1e9;
+  const double cpu_ns_per_byte
+    = 1e9 * static_cast<double>( stop_cpu - start_cpu ) / CLOCKS_PER_SEC / static_cast<double>( input_len );
+  const double simulated_megabits_per_second
+    = 8 * static_cast<double>( input_len ) / ( static_cast<double>( now_ms ) / 1000 ) / 1e6;
+
+  fstream debug_output;
+  debug_output.open( "/dev/tty" );
+
+  const auto sent = client.stats();
+  const auto received = server.stats();
+  const uint64_t retransmissions = sent->retransmits_timeout.value() + sent->retransmits_window_probe.value();
+  const EmulatorStats& up = client_side.stats();
+  const EmulatorStats& down = server_side.stats();
+  const uint64_t drops = up.dropped_queue + up.dropped_loss + down.dropped_queue + down.dropped_loss;
+
+  cout << "TCP over " << link_name << ": transferred " << input_len << " bytes at " << fixed << setprecision( 2 )
+       << gigabits_per_second << " Gbit/s (" << cpu_ns_per_byte << " ns CPU/byte); " << simulated_megabits_per_second
+       << " Mbit/s in " << now_ms << " simulated ms; " << sent->segments_out.value() << " segments sent, "
+       << retransmissions << " retransmitted; link dropped " << drops << ", reordered "
+       << up.reordered + down.reordered << ", duplicated " << up.duplicated + down.duplicated << "; receiver saw "
+       << received->duplicate_bytes.value() << " duplicate and " << received->out_of_order_bytes.value()
+       << " out-of-order bytes.\n";
+
+  debug_output << "             TCP loopback (" << link_name << "): " << fixed << setprecision( 2 )
+               << gigabits_per_second << " Gbit/s, " << cpu_ns_per_byte << " ns CPU/byte, " << retransmissions
+               << " retransmissions\n";
+}
+
+void program_body()
+{
+  speed_test( 50'000'000,
+              "a clean 1 Gbit/s link with 1 ms delay",
+              { .delay_ms = 1, .rate_bps = 1'000'000'000, .queue_limit_bytes = 256'000 },
+              1 );
+  speed_test( 10'000'000,
+              "a 100 Mbit/s link with 10 ms delay and 0.1% loss",
+              { .delay_ms = 10, .rate_bps = 100'000'000, .queue_limit_bytes = 128'000, .loss_good = 0.001 },
+              2 );
+  speed_test( 5'000'000,
+              "a 50 Mbit/s RED-queued link with jitter, burst loss, reordering and duplication",
+              { .delay_ms = 5,
+                .jitter_ms = 2,
+                .rate_bps = 50'000'000,
+                .queue_limit_bytes = 64'000,
+                .queue = QueueDiscipline::RED,
+                .p_good_to_bad = 0.001,
+                .p_bad_to_good = 0.3,
+                .loss_bad = 0.5,
+                .reorder = 0.01,
+                .duplicate = 0.01 },
+              3 );
+}
+int main()
+{
+  try {
+    program_body();
+  } catch ( const exception& e ) {
+    cerr << "Exception: " << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,92 @@
+#include "fragment_reassembler.hh"
+#include "tcp_over_ip.hh"
+
+#include <iostream>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <utility>
+
+using namespace std;
+
+namespace {
+
+void expect( bool condition, const string& what )
+{
+  if ( not condition ) {
+    throw runtime_error( what );
+  }
+}
+
+// An adapter for one end of a connection between 10.0.0.1:1234 and 10.0.0.2:80
+class Adapter : public TCPOverIPv4Adapter
+{
+public:
+  Adapter( const Address& source, const Address& destination )
+  {
+    config_mut().source = source;
+    config_mut().destination = destination;
+  }
+};
+
+// The datagram as it comes off the link: serialized, with `padding` bytes of trailing junk
+string on_the_wire( const InternetDatagram& dgram, size_t padding )
+{
+  string wire;
+  for ( const auto& buf : serialize( dgram ) ) {
+    wire.append( buf );
+  }
+  return wire + string( padding, 'p' );
+}
+
+void test_padding()
+{
+  const Address local { "10.0.0.1", 1234 };
+  const Address remote { "10.0.0.2", 80 };
+  Adapter receiver { local, remote };
+  Adapter sender { remote, local };
+  FragmentReassembler reassembler;
+
+  TCPMessage msg;
+  msg.sender.payload = "hello";
+  msg.receiver.ackno = Wrap32 { 0 };
+
+  // A short datagram padded out to Ethernet's minimum frame: the padding is neither payload nor checksummed
+  const auto small = receiver.unwrap_tcp_in_ip( on_the_wire( sender.wrap_tcp_in_ip( msg ), 6 ), reassembler );
+  expect( small.has_value(), "padded datagram was rejected" );
+  expect( small->sender.payload == "hello",
+          "padding was taken as payload: \"" + string { small->sender.payload } + "\"" );
+
+  // A datagram shorter than its stated length is still rejected
+  const string whole { on_the_wire( sender.wrap_tcp_in_ip( msg ), 0 ) };
+  expect( not receiver.unwrap_tcp_in_ip( whole.substr( 0, whole.size() - 1 ), reassembler ).has_value(),
+          "truncated datagram was accepted" );
+
+  // The fragments of a datagram are trimmed too, before they are reassembled
+  msg.sender.payload = string( 3000, 'x' );
+  InternetDatagram large { sender.wrap_tcp_in_ip( msg ) };
+  large.header.df = false;
+  large.header.compute_checksum();
+  optional<TCPMessage> reassembled;
+  for ( const auto& fragment : fragment_datagram( move( large ), 1500 ) ) {
+    reassembled = receiver.unwrap_tcp_in_ip( on_the_wire( fragment, 10 ), reassembler );
+  }
+  expect( reassembled.has_value(), "padded fragments were not reassembled" );
+  expect( string_view { reassembled->sender.payload } == string_view { msg.sender.payload },
+          "padding was taken into a reassembled datagram" );
+}
+
+} // namespace
+
+int main()
+{
+  try {
+    test_padding();
+  } catch ( const exception& e ) {
+    cerr << "\033[31;1mError: " << e.what() << "\033[m\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
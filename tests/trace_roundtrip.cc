@@ -0,0 +1,103 @@
+#include "trace.hh"
+
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+namespace {
+
+void expect( bool condition, const string& what )
+{
+  if ( not condition ) {
+    throw runtime_error( what );
+  }
+}
+
+bool same( const TraceRecord& a, const TraceRecord& b )
+{
+  return a.time_ns == b.time_ns and a.seqno == b.seqno and a.ackno == b.ackno and a.length == b.length
+         and a.window == b.window and a.event == b.event and a.flags == b.flags;
+}
+
+// Records pushed straight into the thread's buffer, so the test means the same with tracing compiled in or out
+vector<TraceRecord> record_events( uint32_t first_seqno, size_t count )
+{
+  vector<TraceRecord> records;
+  for ( uint32_t i = 0; i < count; ++i ) {
+    records.push_back( { trace_timestamp_ns(),
+                         first_seqno + i,
+                         first_seqno - i,
+                         i * 100,
+                         static_cast<uint16_t>( 1000 + i ),
+                         i % 2 ? TraceEvent::SegmentSent : TraceEvent::Ack,
+                         TraceFlag::ACK } );
+    thread_trace_buffer().push( records.back() );
+  }
+  return records;
+}
+
+void test_roundtrip()
+{
+  const vector<TraceRecord> main_records = record_events( 0xffff'fff0, 40 );
+  vector<TraceRecord> other_records;
+  thread other { [&] { other_records = record_events( 7, 3 ); } };
+  other.join();
+
+  stringstream file;
+  write_traces( file );
+  const vector<ThreadTrace> traces = read_traces( file );
+
+  expect( traces.size() == 2, "expected the events of 2 threads, got " + to_string( traces.size() ) );
+  expect( traces[0].thread == 0 and traces[1].thread == 1, "threads out of order" );
+  for ( size_t t = 0; t < 2; ++t ) {
+    const vector<TraceRecord>& expected = t == 0 ? main_records : other_records;
+    expect( traces[t].records.size() == expected.size(), "wrong number of records for thread " + to_string( t ) );
+    for ( size_t i = 0; i < expected.size(); ++i ) {
+      expect( same( traces[t].records[i], expected[i] ), "record " + to_string( i ) + " changed on the way" );
+    }
+  }
+}
+
+void test_bad_files()
+{
+  stringstream file;
+  write_traces( file );
+  const string good = file.str();
+
+  auto rejects = [&]( const string& contents ) {
+    stringstream in { contents };
+    try {
+      read_traces( in );
+    } catch ( const runtime_error& ) {
+      return true;
+    }
+    return false;
+  };
+
+  expect( rejects( "" ), "empty file accepted" );
+  expect( rejects( "NOTTRACE" + good.substr( 8 ) ), "file with the wrong magic number accepted" );
+  expect( rejects( good.substr( 0, good.size() - 1 ) ), "truncated file accepted" );
+  string wrong_size = good;
+  wrong_size[8] = static_cast<char>( sizeof( TraceRecord ) + 1 );
+  expect( rejects( wrong_size ), "file with the wrong record size accepted" );
+}
+
+} // namespace
+
+int main()
+{
+  try {
+    test_roundtrip();
+    test_bad_files();
+  } catch ( const exception& e ) {
+    cerr << "\033[31;1mError: " << e.what() << "\033[m\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
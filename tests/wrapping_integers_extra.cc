@@ -9,6 +9,7 @@
 #include <random>
 #include <stdexcept>
 #include <string>
+#include <vector>
 
 using namespace std;
 
@@ -76,6 +77,39 @@ int main()
       test_should_be( Wrap32::wrap( 2UL * UINT32_MAX + i, Wrap32 { 19 } ).unwrap( Wrap32 { 19 }, 2UL * UINT32_MAX ),
                       2UL * UINT32_MAX + i );
     }
+
+    // A batch unwraps each sequence number as unwrap() would, whatever its length (and so however much is left
+    // over after the vectorized blocks)
+    mt19937_64 rng { 1947 }; // NOLINT(*-msc51-cpp)
+    const vector<uint64_t> checkpoints {
+      0, 1, 1UL << 31, UINT32_MAX, UINT32_MAX + 1UL, 5UL << 32, UINT64_MAX - UINT32_MAX, UINT64_MAX };
+    for ( size_t length = 0; length < 40; ++length ) {
+      vector<Wrap32> seqnos;
+      for ( size_t i = 0; i < length; ++i ) {
+        seqnos.emplace_back( static_cast<uint32_t>( rng() ) );
+      }
+      for ( auto checkpoint : checkpoints ) {
+        checkpoint ^= rng() % 3; // NOLINT(*-magic-numbers)
+        const Wrap32 zero_point { static_cast<uint32_t>( rng() ) };
+        vector<uint64_t> out( length );
+        Wrap32::unwrap_batch( seqnos, zero_point, checkpoint, out );
+        for ( size_t i = 0; i < length; ++i ) {
+          test_should_be( out[i], seqnos[i].unwrap( zero_point, checkpoint ) );
+        }
+      }
+    }
+
+    // ... and refuses to write past the end of its output
+    bool threw {};
+    try {
+      vector<uint64_t> short_out( 1 );
+      Wrap32::unwrap_batch( vector<Wrap32>( 2, Wrap32 { 0 } ), Wrap32 { 0 }, 0, short_out );
+    } catch ( const runtime_error& ) {
+      threw = true;
+    }
+    if ( not threw ) {
+      throw runtime_error( "unwrap_batch accepted an output shorter than its input" );
+    }
   } catch ( const exception& e ) {
     cerr << e.what() << endl;
     return 1;
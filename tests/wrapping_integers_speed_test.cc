@@ -0,0 +1,91 @@
+#include "wrapping_integers.hh"
+
+#include <chrono>
+#include <cstddef>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <span>
+#include <stdexcept>
+#include <vector>
+
+using namespace std;
+using namespace std::chrono;
+
+namespace {
+
+// Time `unwrap_all( out )` over `rounds` rounds, returning nanoseconds per sequence number
+template<typename F>
+double time_unwraps( size_t rounds, span<uint64_t> out, F&& unwrap_all )
+{
+  const auto start_time = steady_clock::now();
+  for ( size_t round = 0; round < rounds; ++round ) {
+    unwrap_all( out );
+  }
+  const auto stop_time = steady_clock::now();
+  return duration_cast<duration<double, nano>>( stop_time - start_time ).count()
+         / static_cast<double>( rounds * out.size() );
+}
+
+void speed_test( const size_t batch_size, // NOLINT(bugprone-easily-swappable-parameters)
+                 const size_t rounds,     // NOLINT(bugprone-easily-swappable-parameters)
+                 const size_t random_seed )
+{
+  // Acknowledgments scattered around the checkpoint, so unwrap()'s branches go either way unpredictably
+  mt19937 rd { static_cast<uint32_t>( random_seed ) };
+  const Wrap32 zero_point { static_cast<uint32_t>( rd() ) };
+  const uint64_t checkpoint { ( uint64_t { 3 } << 32 ) + rd() };
+  vector<Wrap32> seqnos;
+  for ( size_t i = 0; i < batch_size; ++i ) {
+    seqnos.push_back( Wrap32::wrap( checkpoint, zero_point ) + static_cast<uint32_t>( rd() ) );
+  }
+
+  vector<uint64_t> scalar( batch_size );
+  vector<uint64_t> batch( batch_size );
+
+  const double scalar_ns = time_unwraps( rounds, scalar, [&]( span<uint64_t> out ) {
+    for ( size_t i = 0; i < out.size(); ++i ) {
+      out[i] = seqnos[i].unwrap( zero_point, checkpoint );
+    }
+  } );
+  const double batch_ns = time_unwraps(
+    rounds, batch, [&]( span<uint64_t> out ) { Wrap32::unwrap_batch( seqnos, zero_point, checkpoint, out ); } );
+
+  if ( batch != scalar ) {
+    throw runtime_error( "Mismatch between unwrap and unwrap_batch" );
+  }
+
+  fstream debug_output;
+  debug_output.open( "/dev/tty" );
+
+  cout << "Wrap32::unwrap of " << batch_size << " sequence numbers: " << fixed << setprecision( 2 ) << scalar_ns
+       << " ns each one at a time, " << batch_ns << " ns batched.\n";
+
+  debug_output << "             Wrap32 unwrap: " << fixed << setprecision( 2 ) << scalar_ns << " ns one at a time, "
+               << batch_ns << " ns batched\n";
+
+  // (relative to the scalar path rather than an absolute figure, so a loaded machine slows both alike)
+  if ( batch_ns > scalar_ns ) {
+    throw runtime_error( "Wrap32::unwrap_batch was slower than unwrapping one at a time." );
+  }
+}
+
+void program_body()
+{
+  speed_test( 4096, 10000, 1370 );
+}
+
+} // namespace
+
+int main()
+{
+  try {
+    program_body();
+  } catch ( const exception& e ) {
+    cerr << "Exception: " << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -136,6 +136,22 @@ string Address::to_string() const
   return "(non-Internet address)";
 }
 
+uint16_t Address::port() const
+{
+  // read the port straight from the sockaddr (ip_port() formats it with getnameinfo)
+  if ( _address.storage.ss_family == AF_INET and _size == sizeof( sockaddr_in ) ) {
+    sockaddr_in ipv4_addr {};
+    memcpy( &ipv4_addr, &_address.storage, _size );
+    return be16toh( ipv4_addr.sin_port );
+  }
+  if ( _address.storage.ss_family == AF_INET6 and _size == sizeof( sockaddr_in6 ) ) {
+    sockaddr_in6 ipv6_addr {};
+    memcpy( &ipv6_addr, &_address.storage, _size );
+    return be16toh( ipv6_addr.sin6_port );
+  }
+  return ip_port().second;
+}
+
 uint32_t Address::ipv4_numeric() const
 {
   if ( _address.storage.ss_family != AF_INET or _size != sizeof( sockaddr_in ) ) {
@@ -0,0 +1,103 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+// A hash table keyed by numeric IPv4 address, stored flat: open addressing with linear probing, and
+// backward-shift deletion (so there are no tombstones to slow down later probes).
+template<class Value>
+class AddressMap
+{
+  struct Slot
+  {
+    uint32_t key {};
+    bool occupied {};
+    Value value {};
+  };
+
+  std::vector<Slot> slots_ = std::vector<Slot>( MIN_SLOTS );
+  size_t size_ {};
+
+  static constexpr size_t MIN_SLOTS = 16; // a power of two
+
+  size_t mask() const { return slots_.size() - 1; }
+
+  // Fibonacci hashing spreads consecutive addresses (e.g. a /24 of neighbours) across the table
+  size_t home( uint32_t key ) const { return ( uint64_t { key } * 0x9E37'79B9'7F4A'7C15ULL >> 32 ) & mask(); }
+
+  // The slot holding `key`, or else the empty slot where it would go
+  size_t probe( uint32_t key ) const
+  {
+    size_t i = home( key );
+    while ( slots_[i].occupied and slots_[i].key != key ) {
+      i = ( i + 1 ) & mask();
+    }
+    return i;
+  }
+
+  void grow()
+  {
+    std::vector<Slot> old( slots_.size() * 2 );
+    std::swap( old, slots_ );
+    for ( auto& slot : old ) {
+      if ( slot.occupied ) {
+        slots_[probe( slot.key )] = std::move( slot );
+      }
+    }
+  }
+
+public:
+  size_t size() const { return size_; }
+  bool empty() const { return size_ == 0; }
+
+  Value* find( uint32_t key )
+  {
+    Slot& slot = slots_[probe( key )];
+    return slot.occupied ? &slot.value : nullptr;
+  }
+
+  const Value* find( uint32_t key ) const
+  {
+    const Slot& slot = slots_[probe( key )];
+    return slot.occupied ? &slot.value : nullptr;
+  }
+
+  // The value for `key` (default-constructed if it was absent), and whether it was inserted
+  std::pair<Value&, bool> try_emplace( uint32_t key )
+  {
+    size_t i = probe( key );
+    if ( slots_[i].occupied ) {
+      return { slots_[i].value, false };
+    }
+    if ( 2 * ( size_ + 1 ) > slots_.size() ) {
+      grow(); // keep the load factor at most 1/2 (only for an actual insert)
+      i = probe( key );
+    }
+    slots_[i] = { key, true, Value {} };
+    ++size_;
+    return { slots_[i].value, true };
+  }
+
+  bool erase( uint32_t key )
+  {
+    size_t hole = probe( key );
+    if ( not slots_[hole].occupied ) {
+      return false;
+    }
+
+    // Shift back any later entry of the probe run that may not sit before its home slot
+    for ( size_t i = ( hole + 1 ) & mask(); slots_[i].occupied; i = ( i + 1 ) & mask() ) {
+      const size_t distance_from_home = ( i - home( slots_[i].key ) ) & mask();
+      const size_t distance_to_hole = ( i - hole ) & mask();
+      if ( distance_from_home >= distance_to_hole ) {
+        slots_[hole] = std::move( slots_[i] );
+        hole = i;
+      }
+    }
+    slots_[hole] = {};
+    --size_;
+    return true;
+  }
+};
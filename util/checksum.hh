@@ -1,41 +1,101 @@
 #pragma once
 
+#include <bit>
+#include <concepts>
+#include <cstddef>
 #include <cstdint>
+#include <cstring>
+#include <span>
+#include <stdexcept>
 #include <string>
+#include <string_view>
 #include <vector>
 
 //! The internet checksum algorithm
 class InternetChecksum
 {
 private:
-  uint32_t sum_;
+  uint64_t sum_;
   bool parity_ {};
 
-public:
-  explicit InternetChecksum( const uint32_t sum = 0 ) : sum_( sum ) {}
-  void add( std::string_view data )
+  //! Sum `data` (and copy it to `out`, if not null) a machine word at a time
+  void add_words( std::string_view data, char* out )
   {
-    for ( const uint8_t i : data ) {
-      uint16_t val = i;
-      if ( not parity_ ) {
-        val <<= 8;
-      }
-      sum_ += val;
-      parity_ = !parity_;
+    const char* src = data.data();
+    size_t len = data.size();
+    if ( out ) {
+      std::memcpy( out, src, len );
+    }
+
+    if ( parity_ and len > 0 ) {
+      sum_ += static_cast<uint8_t>( *src ); // the low byte of a 16-bit word started by the previous call
+      parity_ = false;
+      ++src;
+      --len;
+    }
+
+    // Sum in native byte order: the one's complement sum is byte-order independent (RFC 1071), so the
+    // folded result only needs swapping once at the end.
+    uint64_t native_sum {};
+    for ( ; len >= sizeof( uint64_t ); src += sizeof( uint64_t ), len -= sizeof( uint64_t ) ) {
+      uint64_t word {};
+      std::memcpy( &word, src, sizeof( word ) );
+      native_sum += ( word & 0xffff'ffffU ) + ( word >> 32 );
+    }
+    for ( ; len >= sizeof( uint16_t ); src += sizeof( uint16_t ), len -= sizeof( uint16_t ) ) {
+      uint16_t word {};
+      std::memcpy( &word, src, sizeof( word ) );
+      native_sum += word;
+    }
+    auto folded = static_cast<uint16_t>( fold( native_sum ) );
+    if constexpr ( std::endian::native == std::endian::little ) {
+      folded = static_cast<uint16_t>( ( folded >> 8 ) | ( folded << 8 ) );
+    }
+    sum_ += folded;
+
+    if ( len > 0 ) {
+      sum_ += static_cast<uint16_t>( static_cast<uint8_t>( *src ) << 8 );
+      parity_ = true;
     }
   }
 
-  uint16_t value() const
+  static uint64_t fold( uint64_t sum )
   {
-    uint32_t ret = sum_;
+    while ( sum > 0xffff ) {
+      sum = ( sum >> 16 ) + static_cast<uint16_t>( sum );
+    }
+    return sum;
+  }
 
-    while ( ret > 0xffff ) {
-      ret = ( ret >> 16 ) + static_cast<uint16_t>( ret );
+public:
+  explicit InternetChecksum( const uint32_t sum = 0 ) : sum_( sum ) {}
+  void add( std::string_view data ) { add_words( data, nullptr ); }
+
+  //! Add `data` while copying it to `out` (which must have room for it), in a single pass
+  void add_and_copy( std::string_view data, std::span<char> out )
+  {
+    if ( out.size() < data.size() ) {
+      throw std::runtime_error( "InternetChecksum: output too small" );
     }
+    add_words( data, out.data() );
+  }
 
-    return ~ret;
+  //! Add an integer as its big-endian bytes (the same as add() on its serialized form)
+  template<std::unsigned_integral T>
+  void add_integer( const T val )
+  {
+    for ( size_t i = 0; i < sizeof( T ); ++i ) {
+      uint16_t byte_val = static_cast<uint8_t>( val >> ( ( sizeof( T ) - i - 1 ) * 8 ) );
+      if ( not parity_ ) {
+        byte_val <<= 8;
+      }
+      sum_ += byte_val;
+      parity_ = !parity_;
+    }
   }
 
+  uint16_t value() const { return static_cast<uint16_t>( ~fold( sum_ ) ); }
+
   void add( const std::vector<std::string>& data )
   {
     for ( const auto& x : data ) {
@@ -0,0 +1,214 @@
+#pragma once
+
+#include "file_descriptor.hh"
+#include "ipv4_header.hh"
+#include "random.hh"
+#include "tcp_config.hh"
+#include "tcp_segment.hh"
+
+#include <algorithm>
+#include <cstdint>
+#include <optional>
+#include <queue>
+#include <random>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+//! How the emulated link's queue decides what to drop
+enum class QueueDiscipline
+{
+  DropTail, //!< Drop arrivals that do not fit
+  RED       //!< Random Early Detection: drop arrivals with a probability that grows with the average queue
+};
+
+//! Config for EmulatorAdapter
+struct EmulatorConfig
+{
+  uint64_t delay_ms = 0;  //!< Fixed one-way delay
+  uint64_t jitter_ms = 0; //!< Extra delay, uniform in [0, jitter_ms] (segments may overtake each other)
+
+  uint64_t rate_bps = 0;                  //!< Bandwidth limit in bits/s (0 for none, and no queue)
+  uint64_t queue_limit_bytes = 64 * 1024; //!< Bytes that may wait for the link
+  QueueDiscipline queue = QueueDiscipline::DropTail;
+  uint64_t red_min_bytes = 16 * 1024; //!< RED: average queue below which nothing is dropped
+  uint64_t red_max_bytes = 48 * 1024; //!< RED: average queue above which everything is dropped
+  double red_max_p = 0.1;             //!< RED: drop probability as the average reaches red_max_bytes
+
+  //! \name
+  //! Gilbert-Elliott loss: a two-state Markov chain, stepped once per segment, with a loss rate per state.
+  //! Only loss_good set gives independent loss; a small p_good_to_bad and a high loss_bad give bursts.
+  double p_good_to_bad = 0;
+  double p_bad_to_good = 1;
+  double loss_good = 0;
+  double loss_bad = 1;
+
+  double reorder = 0;   //!< Probability that a segment skips the delay (and so overtakes those ahead of it)
+  double duplicate = 0; //!< Probability that a segment is sent twice
+};
+
+//! Counts of what the emulated link has done
+struct EmulatorStats
+{
+  uint64_t delivered {};     //!< Segments handed to the underlying adapter
+  uint64_t dropped_queue {}; //!< Segments dropped by the queue (tail drop or RED)
+  uint64_t dropped_loss {};  //!< Segments lost on the link
+  uint64_t reordered {};     //!< Segments sent without delay
+  uint64_t duplicated {};    //!< Extra copies sent
+};
+
+//! \brief An adapter that sends segments through an emulated link: delay and jitter, a bandwidth limit behind a
+//! drop-tail or RED queue, Gilbert-Elliott burst loss, reordering and duplication.
+//! \details Like netem, it shapes the outbound (write) direction only: segments are held and handed to the
+//! underlying adapter from tick(), which sets the emulated clock. Reads pass through. To shape both directions of
+//! a connection, wrap the adapter at each end.
+template<typename AdapterT>
+class EmulatorAdapter
+{
+private:
+  AdapterT _adapter;        //!< The underlying adapter
+  EmulatorConfig _emulator; //!< How to shape the link
+  EmulatorStats _stats {};  //!< What the link has done
+
+  std::default_random_engine _rand;
+  std::uniform_real_distribution<double> _uniform {};
+
+  uint64_t _now_us {};       //!< Emulated time, advanced by tick()
+  uint64_t _link_free_us {}; //!< When the link will have sent every segment queued for it
+  double _red_average {};    //!< RED's moving average of the queue, in bytes
+  bool _bad_state {};        //!< Gilbert-Elliott state
+  uint64_t _sequence {};     //!< Breaks ties between segments released at the same time, in order of arrival
+
+  //! Segments waiting to be released, earliest first: (release time, arrival order, segment)
+  using Held = std::tuple<uint64_t, uint64_t, TCPMessage>;
+  struct Later
+  {
+    bool operator()( const Held& a, const Held& b ) const
+    {
+      return std::tie( std::get<0>( a ), std::get<1>( a ) ) > std::tie( std::get<0>( b ), std::get<1>( b ) );
+    }
+  };
+  std::priority_queue<Held, std::vector<Held>, Later> _held {};
+
+  bool _chance( double p ) { return p > 0 and _uniform( _rand ) < p; }
+
+  //! Bytes admitted to the queue that have not yet been serialized onto the link
+  uint64_t _backlog_bytes() const
+  {
+    return _emulator.rate_bps == 0 ? 0
+                                   : ( std::max( _link_free_us, _now_us ) - _now_us ) * _emulator.rate_bps / 8'000'000;
+  }
+
+  //! \returns `true` if the queue admits a segment of `size` bytes
+  bool _admit( uint64_t size )
+  {
+    const uint64_t backlog = _backlog_bytes();
+    if ( backlog + size > _emulator.queue_limit_bytes ) {
+      return false;
+    }
+    if ( _emulator.queue == QueueDiscipline::DropTail ) {
+      return true;
+    }
+
+    constexpr double weight = 0.002; // the usual RED averaging weight
+    _red_average = ( 1 - weight ) * _red_average + weight * static_cast<double>( backlog );
+    const auto min = static_cast<double>( _emulator.red_min_bytes );
+    const auto max = static_cast<double>( _emulator.red_max_bytes );
+    if ( _red_average < min ) {
+      return true;
+    }
+    if ( _red_average >= max ) {
+      return false;
+    }
+    return not _chance( _emulator.red_max_p * ( _red_average - min ) / ( max - min ) );
+  }
+
+  //! \returns `true` if the Gilbert-Elliott channel loses the next segment
+  bool _lost()
+  {
+    _bad_state = _bad_state ? not _chance( _emulator.p_bad_to_good ) : _chance( _emulator.p_good_to_bad );
+    return _chance( _bad_state ? _emulator.loss_bad : _emulator.loss_good );
+  }
+
+  //! Queue a segment for the link, and schedule its release
+  void _send( const TCPMessage& seg )
+  {
+    const uint64_t size = IPv4Header::LENGTH + TCPSegment::HEADER_LENGTH + seg.sender.payload.size();
+    if ( not _admit( size ) ) {
+      ++_stats.dropped_queue;
+      return;
+    }
+
+    // The segment leaves the queue once the link has sent everything ahead of it
+    uint64_t release_us = _now_us;
+    if ( _emulator.rate_bps != 0 ) {
+      _link_free_us = std::max( _link_free_us, _now_us ) + size * 8'000'000 / _emulator.rate_bps;
+      release_us = _link_free_us;
+    }
+
+    if ( _lost() ) {
+      ++_stats.dropped_loss;
+      return;
+    }
+
+    if ( _chance( _emulator.reorder ) ) {
+      ++_stats.reordered;
+    } else {
+      release_us += _emulator.delay_ms * 1000;
+      if ( _emulator.jitter_ms != 0 ) {
+        release_us += std::uniform_int_distribution<uint64_t> { 0, _emulator.jitter_ms * 1000 }( _rand );
+      }
+    }
+    _held.emplace( release_us, _sequence++, seg );
+  }
+
+public:
+  //! Conversion to a FileDescriptor by returning the underlying AdapterT
+  FileDescriptor& fd() { return _adapter.fd(); }
+
+  //! Construct from an adapter, a link configuration, and (for reproducible runs) a random engine
+  EmulatorAdapter( AdapterT&& adapter,
+                   const EmulatorConfig& emulator,
+                   std::default_random_engine rand = get_random_engine() )
+    : _adapter( std::move( adapter ) ), _emulator( emulator ), _rand( std::move( rand ) )
+  {}
+
+  //! Read from the underlying AdapterT instance
+  std::optional<TCPMessage> read() { return _adapter.read(); }
+
+  //! \brief Send a segment through the emulated link
+  //! \param[in] seg is the segment to send; it reaches the underlying AdapterT from a later tick(), if at all
+  void write( const TCPMessage& seg )
+  {
+    _send( seg );
+    if ( _chance( _emulator.duplicate ) ) {
+      ++_stats.duplicated;
+      _send( seg );
+    }
+  }
+
+  //! Advance the emulated clock, and hand every segment that is due to the underlying AdapterT
+  void tick( const size_t ms_since_last_tick )
+  {
+    _adapter.tick( ms_since_last_tick );
+    _now_us += ms_since_last_tick * 1000;
+    _link_free_us = std::max( _link_free_us, _now_us );
+    while ( not _held.empty() and std::get<0>( _held.top() ) <= _now_us ) {
+      // priority_queue::top() is const; the segment is copied once more, which only shares its payload
+      const TCPMessage seg = std::get<2>( _held.top() );
+      _held.pop();
+      ++_stats.delivered;
+      _adapter.write( seg );
+    }
+  }
+
+  //! What the emulated link has done so far
+  const EmulatorStats& stats() const { return _stats; }
+
+  //! \name
+  //! Passthrough functions to the underlying AdapterT instance
+
+  void set_listening( const bool l ) { _adapter.set_listening( l ); } //!< FdAdapterBase::set_listening passthrough
+  const FdAdapterConfig& config() const { return _adapter.config(); } //!< FdAdapterBase::config passthrough
+  FdAdapterConfig& config_mut() { return _adapter.config_mut(); }     //!< FdAdapterBase::config_mut passthrough
+};
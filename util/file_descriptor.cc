@@ -3,6 +3,7 @@
 #include "exception.hh"
 
 #include <algorithm>
+#include <array>
 #include <fcntl.h>
 #include <iostream>
 #include <stdexcept>
@@ -108,6 +109,57 @@ void FileDescriptor::read( string& buffer )
   buffer.resize( bytes_read );
 }
 
+size_t FileDescriptor::read( span<char> buffer )
+{
+  const ssize_t bytes_read = ::read( fd_num(), buffer.data(), buffer.size() );
+  if ( bytes_read < 0 ) {
+    if ( internal_fd_->non_blocking_ and ( errno == EAGAIN or errno == EINPROGRESS ) ) {
+      return 0;
+    }
+    throw unix_error { "read" };
+  }
+
+  register_read();
+
+  if ( bytes_read == 0 ) {
+    internal_fd_->eof_ = true;
+  }
+
+  return bytes_read;
+}
+
+size_t FileDescriptor::read( span<const span<char>> buffers )
+{
+  // Scatter lists are usually a packet buffer and somewhere for what doesn't fit: build them on the stack.
+  static constexpr size_t kStackIovecs = 16;
+  array<iovec, kStackIovecs> stack_iovecs {};
+  vector<iovec> heap_iovecs;
+  span<iovec> iovecs { stack_iovecs };
+  if ( buffers.size() > kStackIovecs ) {
+    heap_iovecs.resize( buffers.size() );
+    iovecs = heap_iovecs;
+  }
+  for ( size_t i = 0; i < buffers.size(); ++i ) {
+    iovecs[i] = { buffers[i].data(), buffers[i].size() };
+  }
+
+  const ssize_t bytes_read = ::readv( fd_num(), iovecs.data(), static_cast<int>( buffers.size() ) );
+  if ( bytes_read < 0 ) {
+    if ( internal_fd_->non_blocking_ and ( errno == EAGAIN or errno == EINPROGRESS ) ) {
+      return 0;
+    }
+    throw unix_error { "read" };
+  }
+
+  register_read();
+
+  if ( bytes_read == 0 ) {
+    internal_fd_->eof_ = true;
+  }
+
+  return bytes_read;
+}
+
 void FileDescriptor::read( vector<string>& buffers )
 {
   if ( buffers.empty() ) {
@@ -153,7 +205,7 @@ void FileDescriptor::read( vector<string>& buffers )
 
 size_t FileDescriptor::write( string_view buffer )
 {
-  return write( vector<string_view> { buffer } );
+  return write( span { &buffer, 1 } );
 }
 
 size_t FileDescriptor::write( const vector<std::string>& buffers )
@@ -166,18 +218,26 @@ size_t FileDescriptor::write( const vector<std::string>& buffers )
   return write( views );
 }
 
-size_t FileDescriptor::write( const vector<string_view>& buffers )
+size_t FileDescriptor::write( span<const string_view> buffers )
 {
-  vector<iovec> iovecs;
-  iovecs.reserve( buffers.size() );
+  // Gather lists are usually a header and a payload or two: build them on the stack when they fit.
+  static constexpr size_t kStackIovecs = 16;
+  array<iovec, kStackIovecs> stack_iovecs {};
+  vector<iovec> heap_iovecs;
+  span<iovec> iovecs { stack_iovecs };
+  if ( buffers.size() > kStackIovecs ) {
+    heap_iovecs.resize( buffers.size() );
+    iovecs = heap_iovecs;
+  }
+
   size_t total_size = 0;
-  for ( const auto x : buffers ) {
-    iovecs.push_back( { const_cast<char*>( x.data() ), x.size() } ); // NOLINT(*-const-cast)
-    total_size += x.size();
+  for ( size_t i = 0; i < buffers.size(); ++i ) {
+    iovecs[i] = { const_cast<char*>( buffers[i].data() ), buffers[i].size() }; // NOLINT(*-const-cast)
+    total_size += buffers[i].size();
   }
 
   const ssize_t bytes_written
-    = CheckSystemCall( "writev", ::writev( fd_num(), iovecs.data(), static_cast<int>( iovecs.size() ) ) );
+    = CheckSystemCall( "writev", ::writev( fd_num(), iovecs.data(), static_cast<int>( buffers.size() ) ) );
   register_write();
 
   if ( bytes_written == 0 and total_size != 0 ) {
@@ -0,0 +1,251 @@
+#include "fragment_reassembler.hh"
+
+#include <algorithm>
+#include <iterator>
+
+using namespace std;
+
+namespace {
+
+// The most payload a datagram can carry behind a 20-byte header
+constexpr size_t MAX_PAYLOAD { 0xffff - IPv4Header::LENGTH };
+
+} // namespace
+
+vector<InternetDatagram> fragment_datagram( InternetDatagram&& dgram, size_t mtu )
+{
+  vector<InternetDatagram> fragments;
+  size_t length {};
+  for ( const auto& buf : dgram.payload ) {
+    length += buf.size();
+  }
+  if ( IPv4Header::LENGTH + length <= mtu ) {
+    fragments.push_back( move( dgram ) );
+    return fragments;
+  }
+
+  // Every fragment but the last carries a multiple of 8 bytes
+  const size_t piece { mtu > IPv4Header::LENGTH ? ( mtu - IPv4Header::LENGTH ) / 8 * 8 : 0 };
+  if ( dgram.header.df or piece == 0 ) {
+    return fragments;
+  }
+
+  string payload;
+  payload.reserve( length );
+  for ( const auto& buf : dgram.payload ) {
+    payload.append( buf );
+  }
+
+  // A fragment may be fragmented again: offsets are relative to the original datagram, and only the last piece
+  // of the last fragment goes without MF
+  const size_t base { size_t { dgram.header.offset } * 8 };
+  fragments.reserve( ( length + piece - 1 ) / piece );
+  for ( size_t pos = 0; pos < length; pos += piece ) {
+    InternetDatagram& fragment = fragments.emplace_back( dgram.header, vector { payload.substr( pos, piece ) } );
+    fragment.header.hlen = IPv4Header::LENGTH / 4;
+    fragment.header.len = IPv4Header::LENGTH + fragment.payload.front().size();
+    fragment.header.offset = ( base + pos ) / 8;
+    fragment.header.mf = pos + piece < length or dgram.header.mf;
+    fragment.header.compute_checksum();
+  }
+  return fragments;
+}
+
+size_t FragmentReassembler::KeyHash::operator()( const Key& key ) const
+{
+  const uint64_t addresses { uint64_t { key.src } << 32 | key.dst };
+  const uint64_t rest { uint64_t { key.id } << 8 | key.proto };
+  const uint64_t mixed { ( addresses ^ rest * 0x9E37'79B9'7F4A'7C15ULL ) * 0xC2B2'AE3D'27D4'EB4FULL };
+  return mixed ^ mixed >> 32;
+}
+
+optional<InternetDatagram> FragmentReassembler::push( InternetDatagram&& dgram )
+{
+  const IPv4Header& header { dgram.header };
+  if ( not header.mf and header.offset == 0 ) {
+    return move( dgram );
+  }
+  ++stats_.fragments;
+
+  // The fragment's payload as one string, without any link-layer padding
+  string data;
+  if ( dgram.payload.size() == 1 ) {
+    data = move( dgram.payload.front() );
+  } else {
+    for ( const auto& buf : dgram.payload ) {
+      data.append( buf );
+    }
+  }
+  const size_t offset { size_t { header.offset } * 8 };
+  const size_t length { header.payload_length() };
+  if ( length == 0 or length > data.size() or ( header.mf and length % 8 != 0 ) or offset + length > MAX_PAYLOAD ) {
+    ++stats_.invalid;
+    return {};
+  }
+  data.resize( length );
+
+  const Key key { header.src, header.dst, header.id, header.proto };
+
+  // Turn away duplicates and overlaps before making room, so that they never cost another datagram its place
+  const auto existing = partials_.find( key );
+  if ( existing != partials_.end() ) {
+    switch ( check( existing->second, not header.mf, offset, length ) ) {
+      case Placed::Duplicate:
+        ++stats_.duplicates;
+        return {};
+      case Placed::Overlap:
+        ++stats_.overlaps;
+        drop( key );
+        return {};
+      case Placed::Stored:
+        break;
+    }
+  }
+
+  const size_t charge { length + FRAGMENT_OVERHEAD };
+  const size_t needed { charge + ( existing != partials_.end() ? 0 : DATAGRAM_OVERHEAD ) };
+  make_room( needed, key );
+  if ( bytes_ + needed > limits_.budget_bytes ) {
+    ++stats_.evicted; // too big for the budget even on its own
+    return {};
+  }
+
+  auto [it, inserted] = partials_.try_emplace( key );
+  Partial& partial { it->second };
+  if ( inserted ) {
+    partial.bytes = DATAGRAM_OVERHEAD;
+    bytes_ += DATAGRAM_OVERHEAD;
+    partial.expiry = expiry_.emplace( expiry_.end(), current_time_ms_ + limits_.timeout_ms, key );
+  }
+
+  place( partial, header, offset, move( data ) );
+  partial.bytes += charge;
+  bytes_ += charge;
+
+  if ( not partial.end.has_value() or partial.in_order_end != *partial.end ) {
+    return {};
+  }
+
+  // Complete: the pieces become the payload as they are, behind the first fragment's header
+  InternetDatagram whole { partial.header, {} };
+  whole.payload.reserve( partial.in_order.size() );
+  for ( auto& piece : partial.in_order ) {
+    whole.payload.push_back( move( piece.second ) );
+  }
+  whole.header.hlen = IPv4Header::LENGTH / 4;
+  whole.header.len = IPv4Header::LENGTH + *partial.end;
+  whole.header.mf = false;
+  whole.header.offset = 0;
+  whole.header.compute_checksum();
+
+  drop( key );
+  ++stats_.reassembled;
+  return whole;
+}
+
+auto FragmentReassembler::check( const Partial& partial, bool last, size_t offset, size_t length ) -> Placed
+{
+  const size_t end { offset + length };
+
+  // The last fragment fixes the datagram's length: nothing may reach past it, and it may not fall short of
+  // anything already held
+  if ( last ) {
+    size_t furthest { partial.in_order_end };
+    if ( not partial.waiting.empty() ) {
+      const auto& [last_offset, last_data] = *prev( partial.waiting.end() );
+      furthest = last_offset + last_data.size();
+    }
+    if ( partial.end.has_value() ? *partial.end != end : end < furthest ) {
+      return Placed::Overlap;
+    }
+  } else if ( partial.end.has_value() and end > *partial.end ) {
+    return Placed::Overlap;
+  }
+
+  // Within what has arrived in order: only an exact duplicate is harmless
+  if ( offset < partial.in_order_end ) {
+    const auto it
+      = ranges::lower_bound( partial.in_order, offset, {}, []( const auto& piece ) { return piece.first; } );
+    const bool duplicate { it != partial.in_order.end() and it->first == offset and it->second.size() == length };
+    return duplicate ? Placed::Duplicate : Placed::Overlap;
+  }
+
+  // Next in order: it may not run into what is waiting just behind it
+  if ( offset == partial.in_order_end ) {
+    const bool clear { partial.waiting.empty() or partial.waiting.begin()->first >= end };
+    return clear ? Placed::Stored : Placed::Overlap;
+  }
+
+  // Past a gap: it must fit between its neighbours
+  const auto next = partial.waiting.lower_bound( offset );
+  if ( next != partial.waiting.end() and next->first == offset ) {
+    return next->second.size() == length ? Placed::Duplicate : Placed::Overlap;
+  }
+  if ( next != partial.waiting.end() and next->first < end ) {
+    return Placed::Overlap;
+  }
+  if ( next != partial.waiting.begin() ) {
+    const auto& [previous_offset, previous_data] = *prev( next );
+    if ( previous_offset + previous_data.size() > offset ) {
+      return Placed::Overlap;
+    }
+  }
+  return Placed::Stored;
+}
+
+void FragmentReassembler::place( Partial& partial, const IPv4Header& header, size_t offset, string&& data )
+{
+  const size_t end { offset + data.size() };
+  if ( not header.mf ) {
+    partial.end = end;
+  }
+
+  // Next in order: append it, with whatever was waiting just behind it
+  if ( offset == partial.in_order_end ) {
+    if ( offset == 0 ) {
+      partial.header = header;
+    }
+    partial.in_order.emplace_back( offset, move( data ) );
+    partial.in_order_end = end;
+    while ( not partial.waiting.empty() and partial.waiting.begin()->first == partial.in_order_end ) {
+      auto node = partial.waiting.extract( partial.waiting.begin() );
+      partial.in_order_end += node.mapped().size();
+      partial.in_order.emplace_back( node.key(), move( node.mapped() ) );
+    }
+    return;
+  }
+
+  // Past a gap: it waits
+  partial.waiting.emplace( offset, move( data ) );
+}
+
+void FragmentReassembler::make_room( size_t bytes, const Key& keep )
+{
+  auto next = expiry_.begin();
+  while ( bytes_ + bytes > limits_.budget_bytes and next != expiry_.end() ) {
+    const Key key { next->second };
+    ++next; // (before drop() erases it)
+    if ( not( key == keep ) ) {
+      drop( key );
+      ++stats_.evicted;
+    }
+  }
+}
+
+void FragmentReassembler::drop( const Key& key )
+{
+  if ( const auto it = partials_.find( key ); it != partials_.end() ) {
+    bytes_ -= it->second.bytes;
+    expiry_.erase( it->second.expiry );
+    partials_.erase( it );
+  }
+}
+
+void FragmentReassembler::tick( uint64_t ms_since_last_tick )
+{
+  current_time_ms_ += ms_since_last_tick;
+  while ( not expiry_.empty() and expiry_.front().first <= current_time_ms_ ) {
+    drop( expiry_.front().second );
+    ++stats_.expired;
+  }
+}
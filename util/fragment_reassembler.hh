@@ -0,0 +1,115 @@
+#pragma once
+
+#include "ipv4_datagram.hh"
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <map>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// Split a datagram into fragments of at most `mtu` bytes each, header included (RFC 791). A datagram that fits
+// is returned whole; one that doesn't but has DF set (or can't be split that small) yields no fragments.
+std::vector<InternetDatagram> fragment_datagram( InternetDatagram&& dgram, size_t mtu );
+
+// How much a FragmentReassembler may hold, and for how long
+struct FragmentLimits
+{
+  size_t budget_bytes { 4 * 1024 * 1024 }; // for all partial datagrams, bookkeeping included
+  uint64_t timeout_ms { 30'000 };          // from a datagram's first fragment to its last
+};
+
+// What a FragmentReassembler has done
+struct FragmentStats
+{
+  uint64_t fragments {};   // fragments taken in
+  uint64_t reassembled {}; // whole datagrams put back together
+  uint64_t duplicates {};  // fragments identical in place and length to one already held (ignored)
+  uint64_t invalid {};     // fragments dropped as malformed (misaligned, or past the largest datagram)
+  uint64_t overlaps {};    // partial datagrams dropped for fragments that overlapped or disagreed on the end
+  uint64_t expired {};     // partial datagrams dropped when their time ran out
+  uint64_t evicted {};     // partial datagrams (or fragments) dropped to stay within the budget
+};
+
+// Puts IPv4 datagrams back together from their fragments, which are matched by source, destination,
+// identification and protocol. Like the Reassembler, it keeps what has arrived in order apart from what is
+// waiting for a gap to fill, so a fragment that arrives in order costs O(1). A datagram any of whose fragments
+// overlap (other than exact duplicates) is dropped whole, as RFC 5722 advises, since its bytes are ambiguous.
+class FragmentReassembler
+{
+public:
+  explicit FragmentReassembler( const FragmentLimits& limits = {} ) : limits_( limits ) {}
+
+  // Take in a datagram. One that isn't a fragment is returned as it is; a fragment is held until the last
+  // missing piece of its datagram arrives, and then the whole datagram is returned.
+  std::optional<InternetDatagram> push( InternetDatagram&& dgram );
+
+  // Drop partial datagrams whose time has run out
+  void tick( uint64_t ms_since_last_tick );
+
+  size_t bytes_held() const { return bytes_; }
+  size_t datagrams_held() const { return partials_.size(); }
+  const FragmentStats& stats() const { return stats_; }
+
+private:
+  // Bookkeeping charged against the budget, so a flood of tiny fragments is bounded too
+  static constexpr size_t DATAGRAM_OVERHEAD { 256 };
+  static constexpr size_t FRAGMENT_OVERHEAD { 64 };
+
+  struct Key
+  {
+    uint32_t src {};
+    uint32_t dst {};
+    uint16_t id {};
+    uint8_t proto {};
+
+    bool operator==( const Key& other ) const = default;
+  };
+
+  struct KeyHash
+  {
+    size_t operator()( const Key& key ) const;
+  };
+
+  // Partial datagrams in the order they expire, which (with one timeout for all) is the order they began
+  using ExpiryList = std::list<std::pair<uint64_t, Key>>;
+
+  struct Partial
+  {
+    ExpiryList::iterator expiry {}; // its place in expiry_, removed along with it
+    IPv4Header header {};           // of the first fragment, once it has arrived
+    std::vector<std::pair<size_t, std::string>> in_order {}; // fragments from offset 0 up to in_order_end
+    size_t in_order_end {};
+    std::map<size_t, std::string> waiting {}; // fragments past the first gap, by offset
+    std::optional<size_t> end {};             // payload length, once the last fragment has arrived
+    size_t bytes {};                          // charged against the budget
+  };
+
+  FragmentLimits limits_;
+  FragmentStats stats_ {};
+  std::unordered_map<Key, Partial, KeyHash> partials_ {};
+  size_t bytes_ {};
+  uint64_t current_time_ms_ {};
+  ExpiryList expiry_ {};
+
+  // Whether a fragment fits in a partial datagram, or why it doesn't
+  enum class Placed
+  {
+    Stored,
+    Duplicate,
+    Overlap
+  };
+  static Placed check( const Partial& partial, bool last, size_t offset, size_t length );
+
+  // Store a fragment's payload (that check() has found to fit)
+  static void place( Partial& partial, const IPv4Header& header, size_t offset, std::string&& data );
+
+  // Drop the oldest partial datagrams (other than `keep`'s, which is being added to) until `bytes` more fit in
+  // the budget
+  void make_room( size_t bytes, const Key& keep );
+  void drop( const Key& key );
+};
@@ -106,13 +106,17 @@ uint32_t IPv4Header::pseudo_checksum() const
 
 void IPv4Header::compute_checksum()
 {
-  cksum = 0;
-  Serializer s;
-  serialize( s );
-
-  // calculate checksum -- taken over header only
+  // calculate checksum -- taken over header only, field by field (same bytes as serialize() with cksum = 0)
   InternetChecksum check;
-  check.add( s.output() );
+  check.add_integer( static_cast<uint8_t>( ( static_cast<uint32_t>( ver ) << 4 ) | ( hlen & 0xfU ) ) );
+  check.add_integer( tos );
+  check.add_integer( len );
+  check.add_integer( id );
+  check.add_integer( static_cast<uint16_t>( ( df ? 0x4000U : 0 ) | ( mf ? 0x2000U : 0 ) | ( offset & 0x1fffU ) ) );
+  check.add_integer( ttl );
+  check.add_integer( proto );
+  check.add_integer( src );
+  check.add_integer( dst );
   cksum = check.value();
 }
 
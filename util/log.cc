@@ -0,0 +1,78 @@
+#include "log.hh"
+
+#include <array>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <mutex>
+#include <string>
+
+using namespace std;
+
+namespace {
+
+constexpr array<string_view, 6> LEVEL_NAMES { "trace", "debug", "info", "warning", "error", "off" };
+constexpr array<string_view, 5> LEVEL_PREFIXES { "TRACE", "DEBUG", "INFO", "WARNING", "ERROR" };
+
+atomic<LogLevel>& run_time_level()
+{
+  static atomic<LogLevel> level { environment_log_level( LogLevel::Info ) };
+  return level;
+}
+
+} // namespace
+
+LogLevel environment_log_level( LogLevel fallback )
+{
+  const char* name = getenv( "MINNOW_LOG_LEVEL" ); // NOLINT(concurrency-mt-unsafe)
+  if ( name == nullptr ) {
+    return fallback;
+  }
+  for ( size_t i = 0; i < LEVEL_NAMES.size(); ++i ) {
+    if ( LEVEL_NAMES.at( i ) == name ) {
+      return static_cast<LogLevel>( i );
+    }
+  }
+  return fallback;
+}
+
+LogLevel log_level()
+{
+  return run_time_level().load( memory_order_relaxed );
+}
+
+void set_log_level( LogLevel level )
+{
+  run_time_level().store( level, memory_order_relaxed );
+}
+
+//! \details Lines are counted per whole second of the steady clock. Concurrent callers may race at the turn of
+//! a second, which can only let a line or two more through.
+optional<uint64_t> LogRateLimit::admit()
+{
+  const uint64_t now
+    = chrono::duration_cast<chrono::seconds>( chrono::steady_clock::now().time_since_epoch() ).count();
+  if ( second_.load( memory_order_relaxed ) != now ) {
+    second_.store( now, memory_order_relaxed );
+    lines_.store( 0, memory_order_relaxed );
+  }
+  if ( lines_.fetch_add( 1, memory_order_relaxed ) >= LINES_PER_SECOND ) {
+    suppressed_.fetch_add( 1, memory_order_relaxed );
+    return {};
+  }
+  return suppressed_.exchange( 0, memory_order_relaxed );
+}
+
+void write_log_line( LogLevel level, string_view message, uint64_t suppressed )
+{
+  string line { LEVEL_PREFIXES.at( static_cast<size_t>( level ) ) };
+  line.append( ": " ).append( message );
+  if ( suppressed != 0 ) {
+    line.append( " (" + to_string( suppressed ) + " similar messages suppressed)" );
+  }
+  line.push_back( '\n' );
+
+  static mutex lock;
+  const lock_guard guard { lock };
+  cerr << line << flush;
+}
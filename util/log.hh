@@ -0,0 +1,74 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <optional>
+#include <ostream>
+#include <sstream>
+#include <string_view>
+
+//! \file
+//! Leveled logging to stderr. A message below the compile-time level (`cmake -DMINNOW_MIN_LOG_LEVEL=n`) is
+//! compiled out; one below the run-time level (MINNOW_LOG_LEVEL in the environment, or set_log_level()) costs
+//! one relaxed load. Messages are formatted only once they will be written, and each call site writes at most
+//! LogRateLimit::LINES_PER_SECOND of them a second.
+
+enum class LogLevel : uint8_t
+{
+  Trace,
+  Debug,
+  Info,
+  Warning,
+  Error,
+  Off
+};
+
+#ifndef MINNOW_MIN_LOG_LEVEL
+#define MINNOW_MIN_LOG_LEVEL 0
+#endif
+
+//! Messages below this level are compiled out
+constexpr LogLevel MIN_LOG_LEVEL = static_cast<LogLevel>( MINNOW_MIN_LOG_LEVEL );
+
+//! \returns the level named by MINNOW_LOG_LEVEL in the environment (trace, debug, info, warning, error or off),
+//! or `fallback` if it is unset or unrecognized
+LogLevel environment_log_level( LogLevel fallback );
+
+//! The run-time level, initially environment_log_level( LogLevel::Info )
+LogLevel log_level();
+void set_log_level( LogLevel level );
+
+//! \brief Limits one call site to LINES_PER_SECOND lines a second, and counts the rest
+class LogRateLimit
+{
+  std::atomic<uint64_t> second_ {};     //!< The second being counted
+  std::atomic<uint64_t> lines_ {};      //!< Lines admitted (or not) in that second
+  std::atomic<uint64_t> suppressed_ {}; //!< Lines suppressed since the last one written
+
+public:
+  static constexpr uint64_t LINES_PER_SECOND = 10;
+
+  //! \returns the number of lines suppressed since the last one admitted, or nothing if this one is suppressed
+  std::optional<uint64_t> admit();
+};
+
+//! Write one line (with the level as its prefix) to stderr, in a single write
+void write_log_line( LogLevel level, std::string_view message, uint64_t suppressed );
+
+//! \brief Log a message, formatted by `format( std::ostream& )` only if it is to be written
+//! \details Each call site (each lambda type) has its own rate limit.
+template<LogLevel level, typename Formatter>
+void log_line( Formatter&& format )
+{
+  if constexpr ( level >= MIN_LOG_LEVEL and level < LogLevel::Off ) {
+    if ( level < log_level() ) {
+      return;
+    }
+    static LogRateLimit limit;
+    if ( const auto suppressed = limit.admit() ) {
+      std::ostringstream message;
+      format( static_cast<std::ostream&>( message ) );
+      write_log_line( level, message.view(), *suppressed );
+    }
+  }
+}
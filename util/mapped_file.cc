@@ -0,0 +1,31 @@
+#include "mapped_file.hh"
+
+#include "exception.hh"
+#include "file_descriptor.hh"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+using namespace std;
+
+MappedFile::MappedFile( const string& path )
+{
+  // The mapping outlives the descriptor, which is closed on return
+  const FileDescriptor fd { CheckSystemCall( "open " + path, ::open( path.c_str(), O_RDONLY ) ) }; // NOLINT(*-vararg)
+  struct stat file_status {};
+  CheckSystemCall( "fstat", ::fstat( fd.fd_num(), &file_status ) );
+  size_ = file_status.st_size;
+  if ( size_ == 0 ) {
+    return; // mmap(2) rejects an empty mapping
+  }
+
+  void* const address = ::mmap( nullptr, size_, PROT_READ, MAP_PRIVATE, fd.fd_num(), 0 );
+  if ( address == MAP_FAILED ) { // NOLINT(*-cstyle-cast)
+    throw unix_error { "mmap " + path };
+  }
+  const size_t size = size_;
+  mapping_ = { static_cast<const char*>( address ), [size]( const char* p ) {
+                ::munmap( const_cast<char*>( p ), size ); // NOLINT(*-const-cast)
+              } };
+}
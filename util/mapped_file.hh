@@ -0,0 +1,21 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <span>
+#include <string>
+
+//! A read-only memory mapping of a whole file (unmapped when the last copy is destroyed)
+class MappedFile
+{
+public:
+  //! Map the file at `path`
+  explicit MappedFile( const std::string& path );
+
+  //! The contents of the file
+  std::span<const char> data() const { return { mapping_.get(), size_ }; }
+
+private:
+  size_t size_ {};
+  std::shared_ptr<const char> mapping_ {};
+};
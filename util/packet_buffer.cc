@@ -0,0 +1,138 @@
+#include "packet_buffer.hh"
+
+#include <algorithm>
+#include <atomic>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+using namespace std;
+
+namespace {
+
+// Blocks beyond this many are returned to the heap rather than kept on the free list
+constexpr size_t MAX_FREE_BLOCKS = 1024;
+
+template<class Block, class Remote>
+struct Pool
+{
+  vector<unique_ptr<Block>> free_blocks {};
+  PacketBuffer::PoolStats stats {};
+  shared_ptr<Remote> remote { make_shared<Remote>() };
+
+  unique_ptr<Block> acquire()
+  {
+    ++stats.blocks_in_use;
+    if ( free_blocks.empty() ) {
+      ++stats.blocks_allocated;
+      auto block = make_unique<Block>();
+      block->owner = remote;
+      return block;
+    }
+    ++stats.blocks_reused;
+    unique_ptr<Block> block { move( free_blocks.back() ) };
+    free_blocks.pop_back();
+    return block;
+  }
+
+  void release( unique_ptr<Block>&& block )
+  {
+    if ( block->owner != remote ) {
+      // Another thread's block: its pool counts it off (and it goes back to the heap)
+      block->owner->released.fetch_add( 1, memory_order_relaxed );
+      return;
+    }
+    --stats.blocks_in_use;
+    if ( free_blocks.size() < MAX_FREE_BLOCKS ) {
+      free_blocks.push_back( move( block ) );
+    }
+  }
+};
+
+template<class Block, class Remote>
+Pool<Block, Remote>& pool()
+{
+  thread_local Pool<Block, Remote> the_pool;
+  return the_pool;
+}
+
+} // namespace
+
+struct PacketBuffer::Remote
+{
+  atomic<uint64_t> released {}; // blocks from this pool that other threads have released
+};
+
+PacketBuffer::PoolStats PacketBuffer::pool_stats()
+{
+  const auto& the_pool = pool<Block, Remote>();
+  PoolStats stats { the_pool.stats };
+  stats.blocks_in_use -= the_pool.remote->released.load( memory_order_relaxed );
+  stats.blocks_free = the_pool.free_blocks.size();
+  return stats;
+}
+
+PacketBuffer::PacketBuffer() : block_( pool<Block, Remote>().acquire() ) {}
+
+PacketBuffer::~PacketBuffer()
+{
+  if ( block_ ) {
+    pool<Block, Remote>().release( move( block_ ) );
+  }
+}
+
+PacketBuffer::PacketBuffer( PacketBuffer&& other ) noexcept
+  : block_( move( other.block_ ) )
+  , begin_( exchange( other.begin_, 0 ) )
+  , end_( exchange( other.end_, 0 ) )
+{}
+
+PacketBuffer& PacketBuffer::operator=( PacketBuffer&& other ) noexcept
+{
+  swap( block_, other.block_ );
+  swap( begin_, other.begin_ );
+  swap( end_, other.end_ );
+  return *this;
+}
+
+span<char> PacketBuffer::prepend( size_t len )
+{
+  if ( len > headroom() ) {
+    throw runtime_error( "PacketBuffer: not enough headroom" );
+  }
+  if ( not block_ ) {
+    return {};
+  }
+  begin_ -= len;
+  return { block_->bytes.data() + begin_, len };
+}
+
+span<char> PacketBuffer::append( size_t len )
+{
+  if ( len > tailroom() ) {
+    throw runtime_error( "PacketBuffer: not enough tailroom" );
+  }
+  if ( not block_ ) {
+    return {};
+  }
+  end_ += len;
+  return { block_->bytes.data() + end_ - len, len };
+}
+
+void PacketBuffer::append( string_view data )
+{
+  ranges::copy( data, append( data.size() ).begin() );
+}
+
+void PacketBuffer::remove_prefix( size_t len )
+{
+  begin_ += min( len, size() );
+}
+
+void PacketBuffer::resize( size_t len )
+{
+  if ( len > size() ) {
+    throw runtime_error( "PacketBuffer: resize can only shrink" );
+  }
+  end_ = begin_ + len;
+}
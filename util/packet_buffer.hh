@@ -0,0 +1,87 @@
+#pragma once
+
+#include "parser.hh"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <string_view>
+
+// A packet held in a fixed-size block from a per-thread pool. The data starts after some headroom, so
+// each layer on the way down can prepend its header in place (and each layer on the way up can strip
+// its header in place) without copying the payload. A packet may be handed to another thread: if it is
+// destroyed there, its block goes back to the heap and is counted off the pool it came from.
+class PacketBuffer
+{
+public:
+  static constexpr size_t CAPACITY = 2048; // block size: a full Ethernet frame plus headroom
+  static constexpr size_t HEADROOM = 128;  // default room for the Ethernet, IPv4 and TCP headers (with options)
+
+  // Counters for the pool of the calling thread
+  struct PoolStats
+  {
+    uint64_t blocks_allocated {}; // blocks obtained from the heap
+    uint64_t blocks_reused {};    // blocks taken from the free list
+    uint64_t blocks_in_use {};    // blocks from this thread's pool currently held by a PacketBuffer (anywhere)
+    uint64_t blocks_free {};      // blocks on the free list
+  };
+  static PoolStats pool_stats();
+
+  // An empty packet with HEADROOM bytes of headroom
+  PacketBuffer();
+  ~PacketBuffer();
+
+  PacketBuffer( PacketBuffer&& other ) noexcept;
+  PacketBuffer& operator=( PacketBuffer&& other ) noexcept;
+  PacketBuffer( const PacketBuffer& other ) = delete;
+  PacketBuffer& operator=( const PacketBuffer& other ) = delete;
+
+  size_t size() const { return end_ - begin_; }
+  bool empty() const { return begin_ == end_; }
+  // (both zero for a moved-from packet, which has no block to grow into)
+  size_t headroom() const { return begin_; }
+  size_t tailroom() const { return block_ ? CAPACITY - end_ : 0; }
+
+  // (empty for a moved-from packet, which has no block)
+  std::string_view view() const
+  {
+    return block_ ? std::string_view { block_->bytes.data() + begin_, size() } : std::string_view {};
+  }
+
+  // Grow the packet by `len` bytes at the front (into the headroom) and return them to be filled in
+  // (throws if there is not enough room)
+  std::span<char> prepend( size_t len );
+
+  // Grow the packet by `len` bytes at the back (into the tailroom) and return them to be filled in
+  std::span<char> append( size_t len );
+  void append( std::string_view data );
+
+  // Strip `len` bytes from the front of the packet
+  void remove_prefix( size_t len );
+
+  // Keep only the first `len` bytes of the packet
+  void resize( size_t len );
+
+  // Serialize a fixed-length header (with a LENGTH constant) into the headroom
+  template<class Header>
+  void prepend_header( const Header& header )
+  {
+    Serializer serializer { prepend( Header::LENGTH ) };
+    header.serialize( serializer );
+  }
+
+private:
+  struct Remote; // the part of a thread's pool that other threads may update
+
+  struct Block
+  {
+    std::array<char, CAPACITY> bytes {};
+    std::shared_ptr<Remote> owner {}; // of the pool that allocated it (which may outlive its thread)
+  };
+
+  std::unique_ptr<Block> block_;
+  size_t begin_ { HEADROOM };
+  size_t end_ { HEADROOM };
+};
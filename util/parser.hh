@@ -1,55 +1,114 @@
 #pragma once
 
 #include <algorithm>
+#include <bit>
 #include <concepts>
 #include <cstdint>
 #include <cstring>
-#include <deque>
-#include <numeric>
 #include <span>
 #include <stdexcept>
 #include <string>
 #include <string_view>
 #include <vector>
 
+// Convert between host and network (big-endian) byte order
+template<std::unsigned_integral T>
+T to_big_endian( T val )
+{
+  if constexpr ( sizeof( T ) > 1 and std::endian::native == std::endian::little ) {
+#if __cpp_lib_byteswap
+    val = std::byteswap( val );
+#else
+    if constexpr ( sizeof( T ) == 2 ) {
+      val = __builtin_bswap16( val );
+    } else if constexpr ( sizeof( T ) == 4 ) {
+      val = __builtin_bswap32( val );
+    } else {
+      val = __builtin_bswap64( val );
+    }
+#endif
+  }
+  return val;
+}
+
+// Load a big-endian integer from (at least sizeof( T )) bytes at `src`
+template<std::unsigned_integral T>
+T load_big_endian( const char* src )
+{
+  T val {};
+  std::memcpy( &val, src, sizeof( T ) );
+  return to_big_endian( val );
+}
+
+// Store `val` as sizeof( T ) big-endian bytes at `dst`
+template<std::unsigned_integral T>
+void store_big_endian( char* dst, const T val )
+{
+  const T big_endian = to_big_endian( val );
+  std::memcpy( dst, &big_endian, sizeof( T ) );
+}
+
 class Parser
 {
+  // A read-only view of the input buffers: nothing is copied until the caller asks for an owned copy.
   class BufferList
   {
     uint64_t size_ {};
-    std::deque<std::string> buffer_ {};
-    uint64_t skip_ {};
+    std::string_view current_ {};          // unread part of the current buffer
+    std::span<const std::string> rest_ {}; // buffers after the current one
+
+    void advance()
+    {
+      while ( current_.empty() and not rest_.empty() ) {
+        current_ = rest_.front();
+        rest_ = rest_.subspan( 1 );
+      }
+    }
 
   public:
-    explicit BufferList( const std::vector<std::string>& buffers )
+    explicit BufferList( std::span<const std::string> buffers ) : rest_( buffers )
     {
       for ( const auto& x : buffers ) {
-        append( x );
+        size_ += x.size();
       }
+      advance();
     }
 
+    explicit BufferList( std::string_view buffer ) : size_( buffer.size() ), current_( buffer ) {}
+
     uint64_t size() const { return size_; }
     uint64_t serialized_length() const { return size(); }
     bool empty() const { return size_ == 0; }
 
     std::string_view peek() const
     {
-      if ( buffer_.empty() ) {
+      if ( empty() ) {
         throw std::runtime_error( "peek on empty BufferList" );
       }
-      return std::string_view { buffer_.front() }.substr( skip_ );
+      return current_;
     }
 
     void remove_prefix( uint64_t len )
     {
-      while ( len and not buffer_.empty() ) {
-        const uint64_t to_pop_now = std::min( len, peek().size() );
-        skip_ += to_pop_now;
+      while ( len and not empty() ) {
+        const uint64_t to_pop_now = std::min( len, current_.size() );
+        current_.remove_prefix( to_pop_now );
         len -= to_pop_now;
         size_ -= to_pop_now;
-        if ( skip_ == buffer_.front().size() ) {
-          buffer_.pop_front();
-          skip_ = 0;
+        advance();
+      }
+    }
+
+    // Call `f` on each non-empty remaining piece of the input, in order
+    template<class F>
+    void for_each( F&& f ) const
+    {
+      if ( not current_.empty() ) {
+        f( current_ );
+      }
+      for ( const auto& x : rest_ ) {
+        if ( not x.empty() ) {
+          f( std::string_view { x } );
         }
       }
     }
@@ -57,55 +116,24 @@ class Parser
     void dump_all( std::vector<std::string>& out )
     {
       out.clear();
-      if ( empty() ) {
-        return;
-      }
-      std::string first_str = std::move( buffer_.front() );
-      if ( skip_ ) {
-        first_str = first_str.substr( skip_ );
-      }
-      out.emplace_back( std::move( first_str ) );
-      buffer_.pop_front();
-      for ( auto&& x : buffer_ ) {
-        out.emplace_back( std::move( x ) );
-      }
+      for_each( [&]( std::string_view x ) { out.emplace_back( x ); } );
+      remove_prefix( size_ );
     }
 
     void dump_all( std::string& out )
     {
-      std::vector<std::string> concat;
-      dump_all( concat );
-      if ( concat.size() == 1 ) {
-        out = std::move( concat.front() );
-        return;
-      }
-
       out.clear();
-      for ( const auto& s : concat ) {
-        out.append( s );
-      }
+      out.reserve( size_ );
+      for_each( [&]( std::string_view x ) { out.append( x ); } );
+      remove_prefix( size_ );
     }
 
     std::vector<std::string_view> buffer() const
     {
-      if ( empty() ) {
-        return {};
-      }
       std::vector<std::string_view> ret;
-      ret.reserve( buffer_.size() );
-      auto tmp_skip = skip_;
-      for ( const auto& x : buffer_ ) {
-        ret.push_back( std::string_view { x }.substr( tmp_skip ) );
-        tmp_skip = 0;
-      }
+      for_each( [&]( std::string_view x ) { ret.push_back( x ); } );
       return ret;
     }
-
-    void append( std::string str )
-    {
-      size_ += str.size();
-      buffer_.push_back( std::move( str ) );
-    }
   };
 
   BufferList input_;
@@ -119,7 +147,13 @@ class Parser
   }
 
 public:
+  // The input must outlive the Parser.
   explicit Parser( const std::vector<std::string>& input ) : input_( input ) {}
+  explicit Parser( std::string_view input ) : input_( input ) {}
+  explicit Parser( std::span<const uint8_t> input )
+    // NOLINTNEXTLINE(*-reinterpret-cast)
+    : input_( std::string_view { reinterpret_cast<const char*>( input.data() ), input.size() } )
+  {}
 
   const BufferList& input() const { return input_; }
 
@@ -135,17 +169,18 @@ public:
       return;
     }
 
-    if constexpr ( sizeof( T ) == 1 ) {
-      out = static_cast<uint8_t>( input_.peek().front() );
-      input_.remove_prefix( 1 );
+    // Fast path: the integer lies in one buffer.
+    if ( const std::string_view front = input_.peek(); front.size() >= sizeof( T ) ) {
+      out = load_big_endian<T>( front.data() );
+      input_.remove_prefix( sizeof( T ) );
       return;
-    } else {
-      out = static_cast<T>( 0 );
-      for ( size_t i = 0; i < sizeof( T ); i++ ) {
-        out <<= 8;
-        out |= static_cast<uint8_t>( input_.peek().front() );
-        input_.remove_prefix( 1 );
-      }
+    }
+
+    out = static_cast<T>( 0 );
+    for ( size_t i = 0; i < sizeof( T ); i++ ) {
+      out <<= 8;
+      out |= static_cast<uint8_t>( input_.peek().front() );
+      input_.remove_prefix( 1 );
     }
   }
 
@@ -167,6 +202,13 @@ public:
   void all_remaining( std::vector<std::string>& out ) { input_.dump_all( out ); }
   void all_remaining( std::string& out ) { input_.dump_all( out ); }
   std::vector<std::string_view> buffer() const { return input_.buffer(); }
+
+  // Call `f` on each remaining piece of the input, without copying it
+  template<class F>
+  void for_each_buffer( F&& f ) const
+  {
+    input_.for_each( std::forward<F>( f ) );
+  }
 };
 
 class Serializer
@@ -174,23 +216,45 @@ class Serializer
   std::vector<std::string> output_ {};
   std::string buffer_ {};
 
+  // Caller-provided storage (e.g. the headroom in front of a payload), used instead of buffer_ and output_
+  std::span<char> region_ {};
+  size_t region_used_ {};
+  bool in_region_ {};
+
+  // Claim the next `len` bytes of output: in the region, or at the end of buffer_ (grown as needed)
+  char* claim( size_t len )
+  {
+    if ( not in_region_ ) {
+      buffer_.resize( buffer_.size() + len );
+      return buffer_.data() + buffer_.size() - len;
+    }
+    if ( len > region_.size() - region_used_ ) {
+      throw std::runtime_error( "Serializer: output region too small" );
+    }
+    region_used_ += len;
+    return region_.data() + region_used_ - len;
+  }
+
 public:
   Serializer() = default;
   explicit Serializer( std::string&& buffer ) : buffer_( std::move( buffer ) ) {}
 
+  // Write into `region` (owned by the caller) without allocating. Payloads should be passed to writev()
+  // alongside written() rather than copied in with buffer().
+  explicit Serializer( std::span<char> region ) : region_( region ), in_region_( true ) {}
+
   template<std::unsigned_integral T>
   void integer( const T val )
   {
-    constexpr uint64_t len = sizeof( T );
-
-    for ( uint64_t i = 0; i < len; ++i ) {
-      const uint8_t byte_val = val >> ( ( len - i - 1 ) * 8 );
-      buffer_.push_back( byte_val );
-    }
+    store_big_endian( claim( sizeof( T ) ), val );
   }
 
   void buffer( std::string buf )
   {
+    if ( in_region_ ) {
+      std::copy( buf.begin(), buf.end(), claim( buf.size() ) );
+      return;
+    }
     flush();
     if ( not buf.empty() ) {
       output_.push_back( std::move( buf ) );
@@ -214,9 +278,15 @@ public:
 
   const std::vector<std::string>& output()
   {
+    if ( in_region_ ) {
+      throw std::runtime_error( "Serializer: output() called when writing into a region" );
+    }
     flush();
     return output_;
   }
+
+  // The part of the caller's region written so far
+  std::string_view written() const { return { region_.data(), region_used_ }; }
 };
 
 // Helper to serialize any object (without constructing a Serializer of the caller's own)
@@ -236,3 +306,12 @@ bool parse( T& obj, const std::vector<std::string>& buffers, Targs&&... Fargs )
   obj.parse( p, std::forward<Targs>( Fargs )... );
   return not p.has_error();
 }
+
+// Same, over one contiguous buffer
+template<class T, typename... Targs>
+bool parse( T& obj, std::string_view buffer, Targs&&... Fargs )
+{
+  Parser p { buffer };
+  obj.parse( p, std::forward<Targs>( Fargs )... );
+  return not p.has_error();
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <utility>
+
+// An immutable slice of a reference-counted string. Copies and substrings share the underlying
+// storage, so a slice of a ByteStream's buffer can travel down the stack without copying its bytes.
+class SharedString
+{
+  std::shared_ptr<std::string> storage_ {};
+  std::string_view view_ {};
+
+public:
+  SharedString() = default;
+
+  // Take ownership of a string
+  SharedString( std::string str ) // NOLINT(*-explicit-*)
+    : storage_( str.empty() ? nullptr : std::make_shared<std::string>( std::move( str ) ) )
+    , view_( storage_ ? std::string_view { *storage_ } : std::string_view {} )
+  {}
+
+  SharedString( const char* str ) : SharedString( std::string { str } ) {} // NOLINT(*-explicit-*)
+
+  // Share [pos, pos + len) of a string
+  SharedString( std::shared_ptr<std::string> storage, size_t pos, size_t len )
+    : storage_( std::move( storage ) ), view_( std::string_view { *storage_ }.substr( pos, len ) )
+  {}
+
+  size_t size() const { return view_.size(); }
+  bool empty() const { return view_.empty(); }
+  const char* data() const { return view_.data(); }
+
+  operator std::string_view() const { return view_; } // NOLINT(*-explicit-*)
+  explicit operator std::string() const { return std::string { view_ }; }
+
+  SharedString substr( size_t pos, size_t len = std::string_view::npos ) const
+  {
+    SharedString ret { *this };
+    ret.view_ = view_.substr( pos, len );
+    return ret;
+  }
+
+  // Move the bytes out as a std::string (without a copy if this is the only reference to the whole string)
+  std::string release() &&
+  {
+    if ( storage_ and storage_.use_count() == 1 and view_.size() == storage_->size() ) {
+      std::string ret { std::move( *storage_ ) };
+      storage_.reset();
+      view_ = {};
+      return ret;
+    }
+    return std::string { view_ };
+  }
+
+  bool operator==( std::string_view other ) const { return view_ == other; }
+};
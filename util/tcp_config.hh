@@ -15,11 +15,16 @@ public:
   static constexpr size_t MAX_PAYLOAD_SIZE = 1000;  //!< Conservative max payload size for real Internet
   static constexpr uint16_t TIMEOUT_DFLT = 1000;    //!< Default re-transmit timeout is 1 second
   static constexpr unsigned MAX_RETX_ATTEMPTS = 8;  //!< Maximum re-transmit attempts before giving up
+  static constexpr uint16_t ACK_DELAY_DFLT = 40;    //!< Default delay of an acknowledgment is 40 milliseconds
 
   uint16_t rt_timeout = TIMEOUT_DFLT;      //!< Initial value of the retransmission timeout, in milliseconds
+  uint16_t ack_delay = ACK_DELAY_DFLT;     //!< Longest delay of an acknowledgment, in milliseconds (0 disables)
   size_t recv_capacity = DEFAULT_CAPACITY; //!< Receive capacity, in bytes
   size_t send_capacity = DEFAULT_CAPACITY; //!< Sender capacity, in bytes
   Wrap32 isn { 137 };                      //!< Default initial sequence number
+  bool nagle = false;                      //!< Coalesce sub-MSS writes while data is in flight (Nagle's algorithm)
+  bool pacing = false;                     //!< Space out segments with a token bucket instead of bursting
+  uint64_t pacing_rate = 0;                //!< Pacing rate in bytes/s (0 paces at window / smoothed RTT)
 };
 
 //! Config for classes derived from FdAdapter
@@ -31,4 +36,6 @@ public:
 
   uint16_t loss_rate_dn = 0; //!< Downlink loss rate (for LossyFdAdapter)
   uint16_t loss_rate_up = 0; //!< Uplink loss rate (for LossyFdAdapter)
+
+  bool trust_checksums = false; //!< Skip TCP checksum verification (the device has already verified it)
 };
@@ -10,6 +10,7 @@
 
 #include <atomic>
 #include <cstdint>
+#include <memory>
 #include <optional>
 #include <thread>
 #include <vector>
@@ -58,6 +59,10 @@ public:
   // Return peer address from underlying datagram adapter
   const Address& peer_address() const { return _datagram_adapter.config().destination; }
 
+  //! Statistics of the connection (null before connect or listen_and_accept), readable while the TCPPeer
+  //! thread updates them and after it has finished
+  std::shared_ptr<const TCPStats> stats() const { return _stats; }
+
 protected:
   //! Adapter to underlying datagram socket (e.g., UDP or IP)
   AdaptT _datagram_adapter;
@@ -72,6 +77,9 @@ private:
   //! TCP state machine
   std::optional<TCPPeer> _tcp {};
 
+  //! The TCPPeer's statistics (which outlive it)
+  std::shared_ptr<const TCPStats> _stats {};
+
   //! eventloop that handles all the events (new inbound datagram, new outbound bytes, new inbound bytes)
   EventLoop _eventloop {};
 
@@ -1,6 +1,7 @@
 #include "tcp_minnow_socket.hh"
 
 #include "exception.hh"
+#include "log.hh"
 #include "parser.hh"
 #include "tun.hh"
 
@@ -65,6 +66,7 @@ template<TCPDatagramAdapter AdaptT>
 void TCPMinnowSocket<AdaptT>::_initialize_TCP( const TCPConfig& config )
 {
   _tcp.emplace( config );
+  _stats = _tcp->stats();
 
   // Set up the event loop
 
@@ -90,10 +92,12 @@ void TCPMinnowSocket<AdaptT>::_initialize_TCP( const TCPConfig& config )
         _tcp->receive( std::move( seg.value() ), [&]( auto x ) { _datagram_adapter.write( x ); } );
       }
 
-      // debugging output:
-      if ( _thread_data.eof() and _tcp.value().sender().sequence_numbers_in_flight() == 0 and not _fully_acked ) {
-        std::cerr << "DEBUG: minnow outbound stream to " << _datagram_adapter.config().destination.to_string()
-                  << " has been fully acknowledged.\n";
+      // debugging output (checked once per datagram until it fires, cheapest test first):
+      if ( not _fully_acked and _tcp->sender().sequence_numbers_in_flight() == 0 and _thread_data.eof() ) {
+        log_line<LogLevel::Debug>( [&]( std::ostream& out ) {
+          out << "minnow outbound stream to " << _datagram_adapter.config().destination.to_string()
+              << " has been fully acknowledged.";
+        } );
         _fully_acked = true;
       }
     },
@@ -115,10 +119,11 @@ void TCPMinnowSocket<AdaptT>::_initialize_TCP( const TCPConfig& config )
         _outbound_shutdown = true;
 
         // debugging output:
-        std::cerr << "DEBUG: minnow outbound stream to " << _datagram_adapter.config().destination.to_string()
-                  << " finished (" << _tcp.value().sender().sequence_numbers_in_flight() << " seqno"
-                  << ( _tcp.value().sender().sequence_numbers_in_flight() == 1 ? "" : "s" )
-                  << " still in flight).\n";
+        log_line<LogLevel::Debug>( [&]( std::ostream& out ) {
+          out << "minnow outbound stream to " << _datagram_adapter.config().destination.to_string()
+              << " finished (" << _tcp.value().sender().sequence_numbers_in_flight() << " seqno"
+              << ( _tcp.value().sender().sequence_numbers_in_flight() == 1 ? "" : "s" ) << " still in flight).";
+        } );
       }
 
       _tcp->push( [&]( auto x ) { _datagram_adapter.write( x ); } );
@@ -132,7 +137,7 @@ void TCPMinnowSocket<AdaptT>::_initialize_TCP( const TCPConfig& config )
       _outbound_shutdown = true;
     },
     [&] {
-      std::cerr << "DEBUG: minnow outbound stream had error.\n";
+      log_line<LogLevel::Debug>( []( std::ostream& out ) { out << "minnow outbound stream had error."; } );
       _tcp->outbound_writer().set_error();
     } );
 
@@ -157,8 +162,10 @@ void TCPMinnowSocket<AdaptT>::_initialize_TCP( const TCPConfig& config )
         _inbound_shutdown = true;
 
         // debugging output:
-        std::cerr << "DEBUG: minnow inbound stream from " << _datagram_adapter.config().destination.to_string()
-                  << " finished " << ( inbound.has_error() ? "uncleanly.\n" : "cleanly.\n" );
+        log_line<LogLevel::Debug>( [&]( std::ostream& out ) {
+          out << "minnow inbound stream from " << _datagram_adapter.config().destination.to_string()
+              << " finished " << ( inbound.has_error() ? "uncleanly." : "cleanly." );
+        } );
       }
     },
     [&] {
@@ -168,7 +175,7 @@ void TCPMinnowSocket<AdaptT>::_initialize_TCP( const TCPConfig& config )
     },
     [&] {},
     [&] {
-      std::cerr << "DEBUG: minnow inbound stream had error.\n";
+      log_line<LogLevel::Debug>( []( std::ostream& out ) { out << "minnow inbound stream had error."; } );
       _tcp->inbound_reader().set_error();
     } );
 }
@@ -196,7 +203,7 @@ TCPMinnowSocket<AdaptT>::~TCPMinnowSocket()
 {
   try {
     if ( _tcp_thread.joinable() ) {
-      std::cerr << "Warning: unclean shutdown of TCPMinnowSocket\n";
+      log_line<LogLevel::Warning>( []( std::ostream& out ) { out << "unclean shutdown of TCPMinnowSocket"; } );
       // force the other side to exit
       _abort.store( true );
       _tcp_thread.join();
@@ -211,9 +218,9 @@ void TCPMinnowSocket<AdaptT>::wait_until_closed()
 {
   shutdown( SHUT_RDWR );
   if ( _tcp_thread.joinable() ) {
-    std::cerr << "DEBUG: minnow waiting for clean shutdown... ";
+    log_line<LogLevel::Debug>( []( std::ostream& out ) { out << "minnow waiting for clean shutdown..."; } );
     _tcp_thread.join();
-    std::cerr << "done.\n";
+    log_line<LogLevel::Debug>( []( std::ostream& out ) { out << "minnow clean shutdown done."; } );
   }
 }
 
@@ -230,7 +237,8 @@ void TCPMinnowSocket<AdaptT>::connect( const TCPConfig& c_tcp, const FdAdapterCo
 
   _datagram_adapter.config_mut() = c_ad;
 
-  std::cerr << "DEBUG: minnow connecting to " << c_ad.destination.to_string() << "...\n";
+  log_line<LogLevel::Debug>(
+    [&]( std::ostream& out ) { out << "minnow connecting to " << c_ad.destination.to_string() << "..."; } );
 
   if ( not _tcp.has_value() ) {
     throw std::runtime_error( "TCPPeer not successfully initialized" );
@@ -244,9 +252,12 @@ void TCPMinnowSocket<AdaptT>::connect( const TCPConfig& c_tcp, const FdAdapterCo
 
   _tcp_loop( [&] { return _tcp->sender().sequence_numbers_in_flight() == 1; } );
   if ( _tcp->inbound_reader().has_error() ) {
-    std::cerr << "DEBUG: minnow error on connecting to " << c_ad.destination.to_string() << ".\n";
+    log_line<LogLevel::Debug>(
+      [&]( std::ostream& out ) { out << "minnow error on connecting to " << c_ad.destination.to_string() << "."; } );
   } else {
-    std::cerr << "DEBUG: minnow successfully connected to " << c_ad.destination.to_string() << ".\n";
+    log_line<LogLevel::Debug>( [&]( std::ostream& out ) {
+      out << "minnow successfully connected to " << c_ad.destination.to_string() << ".";
+    } );
   }
 
   _tcp_thread = std::thread( &TCPMinnowSocket::_tcp_main, this );
@@ -266,9 +277,11 @@ void TCPMinnowSocket<AdaptT>::listen_and_accept( const TCPConfig& c_tcp, const F
   _datagram_adapter.config_mut() = c_ad;
   _datagram_adapter.set_listening( true );
 
-  std::cerr << "DEBUG: minnow listening for incoming connection...\n";
+  log_line<LogLevel::Debug>( []( std::ostream& out ) { out << "minnow listening for incoming connection..."; } );
   _tcp_loop( [&] { return ( not _tcp->has_ackno() ) or ( _tcp->sender().sequence_numbers_in_flight() ); } );
-  std::cerr << "DEBUG: minnow new connection from " << _datagram_adapter.config().destination.to_string() << ".\n";
+  log_line<LogLevel::Debug>( [&]( std::ostream& out ) {
+    out << "minnow new connection from " << _datagram_adapter.config().destination.to_string() << ".";
+  } );
 
   _tcp_thread = std::thread( &TCPMinnowSocket::_tcp_main, this );
 }
@@ -283,8 +296,9 @@ void TCPMinnowSocket<AdaptT>::_tcp_main()
     _tcp_loop( [] { return true; } );
     shutdown( SHUT_RDWR );
     if ( not _tcp.value().active() ) {
-      std::cerr << "DEBUG: minnow TCP connection finished "
-                << ( _tcp->inbound_reader().has_error() ? "uncleanly.\n" : "cleanly.\n" );
+      log_line<LogLevel::Debug>( [&]( std::ostream& out ) {
+        out << "minnow TCP connection finished " << ( _tcp->inbound_reader().has_error() ? "uncleanly." : "cleanly." );
+      } );
     }
     _tcp.reset();
   } catch ( const std::exception& e ) {
@@ -5,7 +5,10 @@
 #include "parser.hh"
 
 #include <arpa/inet.h>
+#include <span>
 #include <stdexcept>
+#include <string>
+#include <string_view>
 #include <unistd.h>
 #include <utility>
 
@@ -14,9 +17,11 @@ using namespace std;
 //! \details This function attempts to parse a TCP segment from
 //! the IP datagram's payload.
 //!
-//! If this succeeds, it then checks that the received segment is related to the
-//! current connection. When a TCP connection has been established, this means
-//! checking that the source and destination ports in the TCP header are correct.
+//! It checks that the segment is related to the current connection before doing
+//! any work proportional to its size. When a TCP connection has been established,
+//! this means checking that the source and destination ports in the TCP header are
+//! correct. Only then is the checksum verified (unless FdAdapterConfig::trust_checksums
+//! is set) and the payload copied out.
 //!
 //! If the TCP connection is listening (i.e., TCPOverIPv4OverTunFdAdapter::_listen is `true`)
 //! and the TCP segment read from the wire includes a SYN, this function clears the
@@ -24,26 +29,59 @@ using namespace std;
 //! from the TCP header; it uses this information to filter future reads.
 //! \returns a std::optional<TCPSegment> that is empty if the segment was invalid or unrelated
 optional<TCPMessage> TCPOverIPv4Adapter::unwrap_tcp_in_ip( const InternetDatagram& ip_dgram )
+{
+  return unwrap_tcp_in_ip( ip_dgram.header, Parser { ip_dgram.payload } );
+}
+
+//! \details Only the IPv4 header is decoded before the datagram is trimmed to its stated length, so padding
+//! added by the link (e.g. to reach Ethernet's minimum frame size) is neither payload nor checksummed.
+optional<TCPMessage> TCPOverIPv4Adapter::unwrap_tcp_in_ip( string_view datagram, FragmentReassembler& reassembler )
+{
+  IPv4Header ip_header;
+  Parser header_parser { datagram };
+  ip_header.parse( header_parser );
+  const size_t header_length { size_t { ip_header.hlen } * 4 };
+  if ( header_parser.has_error() or ip_header.len > datagram.size() or ip_header.len < header_length ) {
+    return {}; // malformed or truncated
+  }
+
+  // The payload, up to the datagram's stated length
+  Parser parser { datagram.substr( header_length, ip_header.len - header_length ) };
+  if ( not ip_header.mf and ip_header.offset == 0 ) {
+    return unwrap_tcp_in_ip( ip_header, parser );
+  }
+
+  InternetDatagram fragment { ip_header, {} };
+  parser.all_remaining( fragment.payload );
+  if ( auto whole = reassembler.push( move( fragment ) ) ) {
+    return unwrap_tcp_in_ip( *whole );
+  }
+  return {};
+}
+
+optional<TCPMessage> TCPOverIPv4Adapter::unwrap_tcp_in_ip( const IPv4Header& ip_header, Parser segment )
 {
   // is the IPv4 datagram for us?
   // Note: it's valid to bind to address "0" (INADDR_ANY) and reply from actual address contacted
-  if ( not listening() and ( ip_dgram.header.dst != config().source.ipv4_numeric() ) ) {
+  if ( not listening() and ( ip_header.dst != config().source.ipv4_numeric() ) ) {
     return {};
   }
 
   // is the IPv4 datagram from our peer?
-  if ( not listening() and ( ip_dgram.header.src != config().destination.ipv4_numeric() ) ) {
+  if ( not listening() and ( ip_header.src != config().destination.ipv4_numeric() ) ) {
     return {};
   }
 
   // does the IPv4 datagram claim that its payload is a TCP segment?
-  if ( ip_dgram.header.proto != IPv4Header::PROTO_TCP ) {
+  if ( ip_header.proto != IPv4Header::PROTO_TCP ) {
     return {};
   }
 
-  // is the payload a valid TCP segment?
+  // decode the header only (the checksum covers the whole segment, so keep a view of it)
+  const Parser whole_segment { segment };
   TCPSegment tcp_seg;
-  if ( not parse( tcp_seg, ip_dgram.payload, ip_dgram.header.pseudo_checksum() ) ) {
+  tcp_seg.parse_header( segment );
+  if ( segment.has_error() ) {
     return {};
   }
 
@@ -52,45 +90,77 @@ optional<TCPMessage> TCPOverIPv4Adapter::unwrap_tcp_in_ip( const InternetDatagra
     return {};
   }
 
-  // should we target this source addr/port (and use its destination addr as our source) in reply?
+  // is the TCP segment from our peer? (or, if listening, a SYN to reply to?)
   if ( listening() ) {
-    if ( tcp_seg.message.sender.SYN and not tcp_seg.message.sender.RST ) {
-      config_mutable().source = Address { inet_ntoa( { htobe32( ip_dgram.header.dst ) } ), config().source.port() };
-      config_mutable().destination
-        = Address { inet_ntoa( { htobe32( ip_dgram.header.src ) } ), tcp_seg.udinfo.src_port };
-      set_listening( false );
-    } else {
+    if ( not tcp_seg.message.sender.SYN or tcp_seg.message.sender.RST ) {
       return {};
     }
+  } else if ( tcp_seg.udinfo.src_port != config().destination.port() ) {
+    return {};
   }
 
-  // is the TCP segment from our peer?
-  if ( tcp_seg.udinfo.src_port != config().destination.port() ) {
+  // only now pay for the checksum and the payload
+  if ( not config().trust_checksums and not TCPSegment::checksum_ok( whole_segment, ip_header.pseudo_checksum() ) ) {
     return {};
   }
+  tcp_seg.parse_payload( segment );
+  if ( segment.has_error() ) {
+    return {};
+  }
+
+  // should we target this source addr/port (and use its destination addr as our source) in reply?
+  if ( listening() ) {
+    config_mutable().source = Address { inet_ntoa( { htobe32( ip_header.dst ) } ), config().source.port() };
+    config_mutable().destination = Address { inet_ntoa( { htobe32( ip_header.src ) } ), tcp_seg.udinfo.src_port };
+    set_listening( false );
+  }
 
   return tcp_seg.message;
 }
 
-//! Takes a TCP segment, sets port numbers as necessary, and wraps it in an IPv4 datagram
-//! \param[in] seg is the TCP segment to convert
-InternetDatagram TCPOverIPv4Adapter::wrap_tcp_in_ip( const TCPMessage& msg )
+TCPSegment TCPOverIPv4Adapter::make_segment( const TCPMessage& msg, IPv4Header& ip_header )
 {
   TCPSegment seg { .message = msg };
   // set the port numbers in the TCP segment
   seg.udinfo.src_port = config().source.port();
   seg.udinfo.dst_port = config().destination.port();
 
-  // create an Internet Datagram and set its addresses and length
+  // set the addresses and length of the IPv4 header
+  ip_header.src = config().source.ipv4_numeric();
+  ip_header.dst = config().destination.ipv4_numeric();
+  ip_header.len = ip_header.hlen * 4 + TCPSegment::HEADER_LENGTH + seg.message.sender.payload.size();
+
+  ip_header.compute_checksum();
+
+  return seg;
+}
+
+//! Takes a TCP segment, sets port numbers as necessary, and wraps it in an IPv4 datagram
+//! \param[in] seg is the TCP segment to convert
+InternetDatagram TCPOverIPv4Adapter::wrap_tcp_in_ip( const TCPMessage& msg )
+{
   InternetDatagram ip_dgram;
-  ip_dgram.header.src = config().source.ipv4_numeric();
-  ip_dgram.header.dst = config().destination.ipv4_numeric();
-  ip_dgram.header.len = ip_dgram.header.hlen * 4 + 20 /* tcp header len */ + seg.message.sender.payload.size();
+  TCPSegment seg { make_segment( msg, ip_dgram.header ) };
 
-  // set payload, calculating TCP checksum using information from IP header
-  seg.compute_checksum( ip_dgram.header.pseudo_checksum() );
-  ip_dgram.header.compute_checksum();
-  ip_dgram.payload = serialize( seg );
+  // serialize the segment, calculating the TCP checksum (using information from the IP header) as it is copied
+  string bytes( TCPSegment::HEADER_LENGTH + seg.message.sender.payload.size(), 0 );
+  const span<char> out { bytes };
+  seg.serialize_with_checksum( out.first( TCPSegment::HEADER_LENGTH ),
+                               out.subspan( TCPSegment::HEADER_LENGTH ),
+                               ip_dgram.header.pseudo_checksum() );
+  ip_dgram.payload.push_back( move( bytes ) );
 
   return ip_dgram;
 }
+
+//! \details The payload is checksummed as it is copied into the packet; the TCP and IPv4 headers are then
+//! prepended in place.
+void TCPOverIPv4Adapter::wrap_tcp_in_ip( const TCPMessage& msg, PacketBuffer& packet )
+{
+  IPv4Header ip_header;
+  TCPSegment seg { make_segment( msg, ip_header ) };
+
+  const span<char> payload { packet.append( seg.message.sender.payload.size() ) };
+  seg.serialize_with_checksum( packet.prepend( TCPSegment::HEADER_LENGTH ), payload, ip_header.pseudo_checksum() );
+  packet.prepend_header( ip_header );
+}
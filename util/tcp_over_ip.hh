@@ -1,10 +1,13 @@
 #pragma once
 
 #include "fd_adapter.hh"
+#include "fragment_reassembler.hh"
 #include "ipv4_datagram.hh"
+#include "packet_buffer.hh"
 #include "tcp_segment.hh"
 
 #include <optional>
+#include <string_view>
 
 //! \brief A converter from TCP segments to serialized IPv4 datagrams
 class TCPOverIPv4Adapter : public FdAdapterBase
@@ -12,5 +15,19 @@ class TCPOverIPv4Adapter : public FdAdapterBase
 public:
   std::optional<TCPMessage> unwrap_tcp_in_ip( const InternetDatagram& ip_dgram );
 
+  //! Same, given the parsed IPv4 header and a Parser over the (still serialized) TCP segment
+  std::optional<TCPMessage> unwrap_tcp_in_ip( const IPv4Header& ip_header, Parser segment );
+
+  //! Same, given a whole serialized IPv4 datagram as read from the link (any padding past the length in its
+  //! header is ignored). A fragment is held by `reassembler`, and only the datagram it completes is unwrapped.
+  std::optional<TCPMessage> unwrap_tcp_in_ip( std::string_view datagram, FragmentReassembler& reassembler );
+
   InternetDatagram wrap_tcp_in_ip( const TCPMessage& msg );
+
+  //! Same, but serialized into `packet`, which is left holding the IPv4 datagram
+  void wrap_tcp_in_ip( const TCPMessage& msg, PacketBuffer& packet );
+
+protected:
+  //! Build the TCP segment for `msg` (with ports, but without its checksum) and the IPv4 header that will carry it
+  TCPSegment make_segment( const TCPMessage& msg, IPv4Header& ip_header );
 };
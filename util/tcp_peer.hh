@@ -6,8 +6,12 @@
 #include "tcp_segment.hh"
 #include "tcp_sender.hh"
 #include "tcp_sender_message.hh"
+#include "tcp_stats.hh"
+#include "trace.hh"
 
+#include <algorithm>
 #include <functional>
+#include <memory>
 #include <optional>
 
 class TCPPeer
@@ -18,7 +22,13 @@ class TCPPeer
   }
 
 public:
-  explicit TCPPeer( const TCPConfig& cfg ) : cfg_( cfg ) {}
+  explicit TCPPeer( const TCPConfig& cfg ) : cfg_( cfg )
+  {
+    sender_.set_nagle( cfg_.nagle );
+    sender_.set_pacing( cfg_.pacing, cfg_.pacing_rate );
+    sender_.set_stats( stats_ );
+    receiver_.set_stats( stats_ );
+  }
 
   Writer& outbound_writer() { return sender_.writer(); }
   Reader& inbound_reader() { return receiver_.reader(); }
@@ -28,10 +38,18 @@ public:
 
   /* Passthrough methods */
   void push( const TransmitFunction& transmit ) { sender_.push( make_send( transmit ) ); }
+  void flush( const TransmitFunction& transmit ) { sender_.flush( make_send( transmit ) ); }
+  void set_cork( bool enabled ) { sender_.set_cork( enabled ); }
   void tick( uint64_t t, const TransmitFunction& transmit )
   {
     cumulative_time_ += t;
     sender_.tick( t, make_send( transmit ) );
+
+    // Acknowledge delayed data once the delayed-ACK timer fires (unless already piggybacked), or sooner if
+    // the application has opened the window in the meantime.
+    if ( ack_deadline_.has_value() and ( cumulative_time_ >= ack_deadline_.value() or window_opened() ) ) {
+      send( sender_.make_empty_message(), transmit );
+    }
   }
   bool has_ackno() const { return receiver_.send().ackno.has_value(); }
 
@@ -53,11 +71,20 @@ public:
       return;
     }
 
+    stats_->segments_in.add();
+    stats_->bytes_in.add( msg.sender.payload.size() );
+    trace_segment( TraceEvent::SegmentReceived, msg );
+
     // Record time in case this peer has to linger after streams finish.
     time_of_last_receipt_ = cumulative_time_;
 
-    // If SenderMessage occupies a sequence number, make sure to reply.
-    need_send_ |= ( msg.sender.sequence_length() > 0 );
+    // If SenderMessage occupies a sequence number, make sure to reply (perhaps after a delay, see below).
+    const bool occupies_seqno = msg.sender.sequence_length() > 0;
+    const bool has_flags = msg.sender.SYN or msg.sender.FIN or msg.sender.RST;
+    const uint64_t payload_size = msg.sender.payload.size();
+    const uint64_t pushed_before = receiver_.writer().bytes_pushed();
+    const uint64_t pending_before = receiver_.reassembler().bytes_pending();
+    const bool window_probe = advertised_window_ == 0 and payload_size > 0;
 
     // If SenderMessage is a "keep-alive" (with intentionally invalid seqno), make sure to reply.
     // (N.B. orthodox TCP rules require a reply on any unacceptable segment.)
@@ -72,10 +99,26 @@ public:
     // Give incoming TCPSenderMessage to receiver.
     receiver_.receive( std::move( msg.sender ) );
 
+    // Delayed ACK (RFC 1122 4.2.3.2 and RFC 5681 4.2): data that arrives in order and is accepted in full
+    // can wait for a later segment, until a second full-sized segment arrives or the timer fires.
+    // Anything else (flags, out-of-order data, data that fills a gap, data beyond the window, a probe of a
+    // zero window, or data that arrives after the window has opened) is acknowledged immediately.
+    if ( occupies_seqno ) {
+      const bool in_order = receiver_.writer().bytes_pushed() == pushed_before + payload_size;
+      if ( cfg_.ack_delay == 0 or has_flags or window_probe or not in_order or pending_before != 0
+           or window_opened() ) {
+        need_send_ = true;
+      } else if ( ( delayed_ack_bytes_ += payload_size ) >= 2 * TCPConfig::MAX_PAYLOAD_SIZE ) {
+        need_send_ = true;
+      } else if ( not ack_deadline_.has_value() ) {
+        ack_deadline_ = cumulative_time_ + cfg_.ack_delay;
+      }
+    }
+
     // Give incoming TCPReceiverMessage to sender.
     sender_.receive( msg.receiver );
 
-    // Send reply if needed.
+    // Send reply if needed (any segment pushed here carries the acknowledgment as well).
     push( transmit );
     if ( need_send_ ) {
       send( sender_.make_empty_message(), transmit );
@@ -86,18 +129,62 @@ public:
   const TCPReceiver& receiver() const { return receiver_; }
   const TCPSender& sender() const { return sender_; }
 
+  // Statistics, readable from any thread (and after the peer itself is gone)
+  std::shared_ptr<const TCPStats> stats() const { return stats_; }
+
 private:
   TCPConfig cfg_;
+  std::shared_ptr<TCPStats> stats_ { std::make_shared<TCPStats>() };
   TCPSender sender_ { ByteStream { cfg_.send_capacity }, cfg_.isn, cfg_.rt_timeout };
   TCPReceiver receiver_ { Reassembler { ByteStream { cfg_.recv_capacity } } };
 
   bool need_send_ {};
 
+  uint64_t delayed_ack_bytes_ {};           // bytes received in order but not yet acknowledged
+  std::optional<uint64_t> ack_deadline_ {}; // time by which the delayed acknowledgment must be sent
+  uint16_t advertised_window_ {};           // size of the last window advertised
+
+  // Has the window opened, since it was last advertised, by enough that the sender needs to hear at once?
+  // That is so when the sender was held to less than a full-sized segment and now has room for one, or when
+  // the window grew by two full-sized segments (or half the buffer if that is smaller). Anything less, such
+  // as an application reading each segment as it arrives, waits for the usual delayed acknowledgment.
+  bool window_opened() const
+  {
+    const uint64_t window = receiver_.send().window_size;
+    const uint64_t segment = std::min<uint64_t>( TCPConfig::MAX_PAYLOAD_SIZE, cfg_.recv_capacity / 2 );
+    if ( advertised_window_ < TCPConfig::MAX_PAYLOAD_SIZE and window >= segment ) {
+      return true;
+    }
+    return window
+           >= advertised_window_ + std::min<uint64_t>( 2 * TCPConfig::MAX_PAYLOAD_SIZE, cfg_.recv_capacity / 2 );
+  }
+
   void send( const TCPSenderMessage& sender_message, const TransmitFunction& transmit )
   {
     TCPMessage msg { sender_message, receiver_.send() };
+    stats_->segments_out.add();
+    stats_->bytes_out.add( msg.sender.payload.size() );
+    trace_segment( TraceEvent::SegmentSent, msg );
+    advertised_window_ = msg.receiver.window_size;
     transmit( std::move( msg ) );
     need_send_ = false;
+    delayed_ack_bytes_ = 0;
+    ack_deadline_.reset();
+  }
+
+  static void trace_segment( TraceEvent event, const TCPMessage& msg )
+  {
+    if constexpr ( TRACING_ENABLED ) {
+      const uint8_t flags = ( msg.sender.SYN ? TraceFlag::SYN : 0 ) | ( msg.sender.FIN ? TraceFlag::FIN : 0 )
+                            | ( msg.sender.RST or msg.receiver.RST ? TraceFlag::RST : 0 )
+                            | ( msg.receiver.ackno.has_value() ? TraceFlag::ACK : 0 );
+      trace_event( event,
+                   msg.sender.seqno.raw_value(),
+                   msg.receiver.ackno.value_or( Wrap32 { 0 } ).raw_value(),
+                   msg.sender.payload.size(),
+                   msg.receiver.window_size,
+                   flags );
+    }
   }
 
   bool linger_after_streams_finish_ { true }; // one peer may need to linger to make sure all closure conditions met
@@ -3,21 +3,33 @@
 #include "wrapping_integers.hh"
 
 #include <cstddef>
+#include <span>
+#include <string_view>
 
 static constexpr uint32_t TCPHeaderMinLen = 5; // 32-bit words
+static_assert( TCPHeaderMinLen * 4 == TCPSegment::HEADER_LENGTH );
 
 using namespace std;
 
 void TCPSegment::parse( Parser& parser, uint32_t datagram_layer_pseudo_checksum )
 {
-  /* verify checksum */
-  InternetChecksum check { datagram_layer_pseudo_checksum };
-  check.add( parser.buffer() );
-  if ( check.value() ) {
+  if ( not checksum_ok( parser, datagram_layer_pseudo_checksum ) ) {
     parser.set_error();
     return;
   }
+  parse_header( parser );
+  parse_payload( parser );
+}
 
+bool TCPSegment::checksum_ok( const Parser& segment, uint32_t datagram_layer_pseudo_checksum )
+{
+  InternetChecksum check { datagram_layer_pseudo_checksum };
+  segment.for_each_buffer( [&]( string_view buf ) { check.add( buf ); } );
+  return check.value() == 0;
+}
+
+void TCPSegment::parse_header( Parser& parser )
+{
   uint32_t raw32 {};
   uint16_t raw16 {};
   uint8_t octet {};
@@ -52,8 +64,16 @@ void TCPSegment::parse( Parser& parser, uint32_t datagram_layer_pseudo_checksum
     parser.set_error();
   }
   parser.remove_prefix( data_offset * 4 - TCPHeaderMinLen * 4 );
+}
 
-  parser.all_remaining( message.sender.payload );
+void TCPSegment::parse_payload( Parser& parser )
+{
+  if ( parser.has_error() ) {
+    return;
+  }
+  string payload;
+  parser.all_remaining( payload );
+  message.sender.payload = move( payload );
 }
 
 class Wrap32Serializable : public Wrap32
@@ -64,28 +84,57 @@ public:
 
 void TCPSegment::serialize( Serializer& serializer ) const
 {
-  serializer.integer( udinfo.src_port );
-  serializer.integer( udinfo.dst_port );
-  serializer.integer( Wrap32Serializable { message.sender.seqno }.raw_value() );
-  serializer.integer( Wrap32Serializable { message.receiver.ackno.value_or( Wrap32 { 0 } ) }.raw_value() );
-  serializer.integer( uint8_t { TCPHeaderMinLen << 4 } ); // data offset
+  serialize_header( serializer );
+  serializer.buffer( static_cast<string>( message.sender.payload ) );
+}
+
+namespace {
+
+// Call `f` on each field of the segment's header, in wire order
+template<class F>
+void for_each_header_field( const TCPSegment& seg, F&& f )
+{
+  const TCPMessage& message = seg.message;
+  f( seg.udinfo.src_port );
+  f( seg.udinfo.dst_port );
+  f( Wrap32Serializable { message.sender.seqno }.raw_value() );
+  f( Wrap32Serializable { message.receiver.ackno.value_or( Wrap32 { 0 } ) }.raw_value() );
+  f( uint8_t { TCPHeaderMinLen << 4 } ); // data offset
   const bool reset = message.sender.RST or message.receiver.RST;
   const uint8_t flags = ( message.receiver.ackno.has_value() ? 0b0001'0000U : 0 ) | ( reset ? 0b0000'0100U : 0 )
                         | ( message.sender.SYN ? 0b0000'0010U : 0 ) | ( message.sender.FIN ? 0b0000'0001U : 0 );
-  serializer.integer( flags );
-  serializer.integer( message.receiver.window_size );
-  serializer.integer( udinfo.cksum );
-  serializer.integer( uint16_t { 0 } ); // urgent pointer
-  serializer.buffer( message.sender.payload );
+  f( flags );
+  f( message.receiver.window_size );
+  f( seg.udinfo.cksum );
+  f( uint16_t { 0 } ); // urgent pointer
+}
+
+} // namespace
+
+void TCPSegment::serialize_header( Serializer& serializer ) const
+{
+  for_each_header_field( *this, [&]( auto field ) { serializer.integer( field ); } );
 }
 
 void TCPSegment::compute_checksum( uint32_t datagram_layer_pseudo_checksum )
 {
   udinfo.cksum = 0;
-  Serializer s;
-  serialize( s );
+  InternetChecksum check { datagram_layer_pseudo_checksum };
+  for_each_header_field( *this, [&]( auto field ) { check.add_integer( field ); } );
+  check.add( message.sender.payload );
+  udinfo.cksum = check.value();
+}
 
+void TCPSegment::serialize_with_checksum( span<char> header,
+                                          span<char> payload,
+                                          uint32_t datagram_layer_pseudo_checksum )
+{
+  udinfo.cksum = 0;
   InternetChecksum check { datagram_layer_pseudo_checksum };
-  check.add( s.output() );
+  for_each_header_field( *this, [&]( auto field ) { check.add_integer( field ); } );
+  check.add_and_copy( message.sender.payload, payload );
   udinfo.cksum = check.value();
+
+  Serializer serializer { header };
+  serialize_header( serializer );
 }
@@ -5,6 +5,9 @@
 #include "tcp_sender_message.hh"
 #include "udinfo.hh"
 
+#include <cstddef>
+#include <span>
+
 struct TCPMessage
 {
   TCPSenderMessage sender {};
@@ -13,11 +16,29 @@ struct TCPMessage
 
 struct TCPSegment
 {
+  static constexpr size_t HEADER_LENGTH = 20; // TCP header length (without options), in bytes
+
   TCPMessage message {};
   UserDatagramInfo udinfo {};
 
   void parse( Parser& parser, uint32_t datagram_layer_pseudo_checksum );
   void serialize( Serializer& serializer ) const;
 
+  // The steps of parse(), for callers that want to look at the header before paying for the rest:
+  // verify the checksum over the whole (unparsed) segment, decode the header, then copy out the payload
+  static bool checksum_ok( const Parser& segment, uint32_t datagram_layer_pseudo_checksum );
+  void parse_header( Parser& parser );
+  void parse_payload( Parser& parser );
+
+  // Serialize only the header: the payload can then be sent by reference
+  void serialize_header( Serializer& serializer ) const;
+
+  // Sum the header fields and the payload in place, and set udinfo.cksum
   void compute_checksum( uint32_t datagram_layer_pseudo_checksum );
+
+  // Compute the checksum while copying the payload into `payload`, then serialize the header (checksum
+  // included) into `header`: one pass over the payload instead of a checksum pass and a copy
+  void serialize_with_checksum( std::span<char> header,
+                                std::span<char> payload,
+                                uint32_t datagram_layer_pseudo_checksum );
 };
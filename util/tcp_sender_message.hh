@@ -1,9 +1,8 @@
 #pragma once
 
+#include "shared_string.hh"
 #include "wrapping_integers.hh"
 
-#include <string>
-
 /*
  * The TCPSenderMessage structure contains the information sent from a TCP sender to its receiver.
  *
@@ -15,7 +14,8 @@
  * 2) The SYN flag. If set, this segment is the beginning of the byte stream, and the seqno field
  *    contains the Initial Sequence Number (ISN) -- the zero point.
  *
- * 3) The payload: a substring (possibly empty) of the byte stream.
+ * 3) The payload: a substring (possibly empty) of the byte stream. It may share its bytes with the
+ *    sender's outbound stream.
  *
  * 4) The FIN flag. If set, the payload represents the ending of the byte stream.
  *
@@ -27,7 +27,7 @@ struct TCPSenderMessage
   Wrap32 seqno { 0 };
 
   bool SYN {};
-  std::string payload {};
+  SharedString payload {};
   bool FIN {};
 
   bool RST {};
@@ -0,0 +1,21 @@
+#include "tcp_stats.hh"
+
+#include <sstream>
+
+using namespace std;
+
+string TCPStats::to_string() const
+{
+  stringstream ss {};
+  ss << "out: " << segments_out.value() << " segments (" << bytes_out.value() << " bytes)"
+     << ", in: " << segments_in.value() << " segments (" << bytes_in.value() << " bytes)"
+     << ", retransmitted: " << retransmits_timeout.value() << " on timeout, " << retransmits_window_probe.value()
+     << " window probes"
+     << ", reassembler: " << duplicate_bytes.value() << " duplicate, " << out_of_order_bytes.value()
+     << " out-of-order, " << beyond_window_bytes.value() << " beyond-window bytes"
+     << ", zero windows: " << zero_window_events.value() << ", RTT: " << smoothed_RTT_ms.value()
+     << " ms smoothed (" << latest_RTT_ms.value() << " latest, " << min_RTT_ms.value() << " min)"
+     << ", limited by window " << window_limited_ms.value() << " ms, by application " << app_limited_ms.value()
+     << " ms";
+  return ss.str();
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+//! \brief A statistic written by one thread and readable from any other without locking
+//! \details The writer owns the value, so an update is a relaxed load and store rather than a locked
+//! read-modify-write; readers see each value whole, but not a consistent snapshot across statistics.
+class StatCounter
+{
+  std::atomic<uint64_t> value_ {};
+
+public:
+  void add( uint64_t n = 1 )
+  {
+    value_.store( value_.load( std::memory_order_relaxed ) + n, std::memory_order_relaxed );
+  }
+  void set( uint64_t n ) { value_.store( n, std::memory_order_relaxed ); }
+  uint64_t value() const { return value_.load( std::memory_order_relaxed ); }
+};
+
+//! Per-connection statistics, updated by TCPPeer and its sender, receiver and reassembler
+struct TCPStats
+{
+  //! \name
+  //! Segments, and payload bytes, sent and received (retransmissions included)
+  StatCounter segments_out {};
+  StatCounter bytes_out {};
+  StatCounter segments_in {};
+  StatCounter bytes_in {};
+
+  //! \name
+  //! Retransmissions, by cause
+  StatCounter retransmits_timeout {};     //!< The retransmission timer expired with the window open
+  StatCounter retransmits_window_probe {}; //!< Zero-window probes (sent again while the window stays closed)
+
+  //! \name
+  //! Bytes seen by the Reassembler
+  StatCounter duplicate_bytes {};     //!< Already assembled, or already waiting to be
+  StatCounter out_of_order_bytes {};  //!< Stored to wait for earlier bytes
+  StatCounter beyond_window_bytes {}; //!< Discarded for lack of capacity
+
+  StatCounter zero_window_events {}; //!< Times the peer's window closed
+
+  //! \name
+  //! Round-trip time estimates, in milliseconds (0 until the first sample)
+  StatCounter smoothed_RTT_ms {};
+  StatCounter latest_RTT_ms {};
+  StatCounter min_RTT_ms {};
+
+  //! \name
+  //! Time the sender spent with data to send but no room in the window, and with nothing to send
+  StatCounter window_limited_ms {};
+  StatCounter app_limited_ms {};
+
+  //! Record a round-trip time sample, and the smoothed estimate that includes it
+  void record_RTT( uint64_t sample_ms, uint64_t smoothed_ms )
+  {
+    latest_RTT_ms.set( sample_ms );
+    smoothed_RTT_ms.set( smoothed_ms );
+    if ( min_RTT_ms.value() == 0 or sample_ms < min_RTT_ms.value() ) {
+      min_RTT_ms.set( sample_ms );
+    }
+  }
+
+  //! Return a string containing the statistics in human-readable format
+  std::string to_string() const;
+};
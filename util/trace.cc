@@ -0,0 +1,112 @@
+#include "trace.hh"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <mutex>
+#include <stdexcept>
+
+using namespace std;
+
+namespace {
+
+constexpr array<char, 8> TRACE_MAGIC { 'M', 'N', 'T', 'R', 'A', 'C', 'E', '1' };
+
+//! Every thread's buffer, in order of registration
+struct TraceRegistry
+{
+  mutex lock {};
+  vector<shared_ptr<TraceBuffer>> buffers {};
+};
+
+TraceRegistry& registry()
+{
+  static TraceRegistry instance;
+  return instance;
+}
+
+template<class T>
+void write_raw( ostream& out, const T& value )
+{
+  out.write( reinterpret_cast<const char*>( &value ), sizeof( value ) ); // NOLINT(*-reinterpret-cast)
+}
+
+template<class T>
+void read_raw( istream& in, T& value )
+{
+  if ( not in.read( reinterpret_cast<char*>( &value ), sizeof( value ) ) ) { // NOLINT(*-reinterpret-cast)
+    throw runtime_error( "truncated trace" );
+  }
+}
+
+} // namespace
+
+vector<TraceRecord> TraceBuffer::snapshot() const
+{
+  const uint64_t head = head_.load( memory_order_acquire );
+  const uint64_t count = min<uint64_t>( head, CAPACITY );
+  vector<TraceRecord> records;
+  records.reserve( count );
+  for ( uint64_t i = head - count; i < head; ++i ) {
+    records.push_back( records_[i & ( CAPACITY - 1 )] );
+  }
+  return records;
+}
+
+TraceBuffer& thread_trace_buffer()
+{
+  thread_local const shared_ptr<TraceBuffer> buffer = [] {
+    auto new_buffer = make_shared<TraceBuffer>();
+    const lock_guard guard { registry().lock };
+    registry().buffers.push_back( new_buffer );
+    return new_buffer;
+  }();
+  return *buffer;
+}
+
+uint64_t trace_timestamp_ns()
+{
+  return chrono::duration_cast<chrono::nanoseconds>( chrono::steady_clock::now().time_since_epoch() ).count();
+}
+
+//! \details The file is the magic number, the record size, then for each thread its index, its record count
+//! and its records.
+void write_traces( ostream& out )
+{
+  const lock_guard guard { registry().lock };
+  out.write( TRACE_MAGIC.data(), TRACE_MAGIC.size() );
+  write_raw( out, uint32_t { sizeof( TraceRecord ) } );
+  for ( uint64_t thread = 0; thread < registry().buffers.size(); ++thread ) {
+    const vector<TraceRecord> records = registry().buffers[thread]->snapshot();
+    write_raw( out, thread );
+    write_raw( out, uint64_t { records.size() } );
+    out.write( reinterpret_cast<const char*>( records.data() ), // NOLINT(*-reinterpret-cast)
+               static_cast<streamsize>( records.size() * sizeof( TraceRecord ) ) );
+  }
+}
+
+vector<ThreadTrace> read_traces( istream& in )
+{
+  array<char, TRACE_MAGIC.size()> magic {};
+  uint32_t record_size {};
+  if ( not in.read( magic.data(), magic.size() ) or magic != TRACE_MAGIC ) {
+    throw runtime_error( "not a minnow trace" );
+  }
+  read_raw( in, record_size );
+  if ( record_size != sizeof( TraceRecord ) ) {
+    throw runtime_error( "trace has records of " + to_string( record_size ) + " bytes" );
+  }
+
+  vector<ThreadTrace> threads;
+  while ( in.peek() != istream::traits_type::eof() ) {
+    ThreadTrace& thread = threads.emplace_back();
+    uint64_t count {};
+    read_raw( in, thread.thread );
+    read_raw( in, count );
+    thread.records.resize( count );
+    for ( auto& record : thread.records ) {
+      read_raw( in, record );
+    }
+  }
+  return threads;
+}
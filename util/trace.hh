@@ -0,0 +1,104 @@
+#pragma once
+
+#include "wrapping_integers.hh"
+
+#include <atomic>
+#include <cstdint>
+#include <istream>
+#include <memory>
+#include <ostream>
+#include <vector>
+
+//! \file
+//! Binary event tracing, compiled in with `cmake -DMINNOW_TRACING=ON`. When it is off, trace_event() is an empty
+//! inline function (but its arguments are still evaluated, so a call whose arguments take work to compute belongs
+//! inside `if constexpr ( TRACING_ENABLED )`); when it is on, each event is one fixed-size record appended to a
+//! ring buffer owned by the calling thread (no locks, and no allocation after the thread's first event).
+#ifndef MINNOW_TRACING
+#define MINNOW_TRACING 0
+#endif
+
+constexpr bool TRACING_ENABLED = MINNOW_TRACING;
+
+enum class TraceEvent : uint8_t
+{
+  SegmentSent,     //!< seqno, ackno, payload length, advertised window, flags
+  SegmentReceived, //!< seqno, ackno, payload length, advertised window, flags
+  Ack,             //!< ackno, sequence numbers newly acknowledged, peer's window
+  Retransmit,      //!< seqno, sequence length, peer's window
+  WindowChange,    //!< new window (and the old one in `length`)
+  TimerFired,      //!< consecutive retransmissions so far (in `length`)
+};
+
+//! Flags in TraceRecord::flags
+struct TraceFlag
+{
+  static constexpr uint8_t SYN = 1;
+  static constexpr uint8_t FIN = 2;
+  static constexpr uint8_t RST = 4;
+  static constexpr uint8_t ACK = 8; //!< the ackno field is valid
+};
+
+//! One event, in the (host byte order) layout of the trace file
+struct TraceRecord
+{
+  uint64_t time_ns {}; //!< steady clock
+  uint32_t seqno {};
+  uint32_t ackno {};
+  uint32_t length {};
+  uint16_t window {};
+  TraceEvent event {};
+  uint8_t flags {};
+};
+static_assert( sizeof( TraceRecord ) == 24 );
+
+//! A single-writer ring of the most recent events of one thread
+class TraceBuffer
+{
+public:
+  static constexpr size_t CAPACITY = 1 << 16; //!< records (a power of two)
+
+  void push( const TraceRecord& record )
+  {
+    const uint64_t head = head_.load( std::memory_order_relaxed );
+    records_[head & ( CAPACITY - 1 )] = record;
+    head_.store( head + 1, std::memory_order_release );
+  }
+
+  //! The buffered records, oldest first
+  std::vector<TraceRecord> snapshot() const;
+
+private:
+  std::unique_ptr<TraceRecord[]> records_ { std::make_unique<TraceRecord[]>( CAPACITY ) };
+  std::atomic<uint64_t> head_ {}; //!< records ever written
+};
+
+//! The calling thread's buffer (registered on first use, and kept after the thread exits)
+TraceBuffer& thread_trace_buffer();
+
+//! Nanoseconds on the steady clock
+uint64_t trace_timestamp_ns();
+
+//! Record an event in the calling thread's buffer (if tracing is compiled in)
+inline void trace_event( TraceEvent event,
+                         uint32_t seqno,
+                         uint32_t ackno,
+                         uint32_t length,
+                         uint16_t window,
+                         uint8_t flags = 0 )
+{
+  if constexpr ( TRACING_ENABLED ) {
+    thread_trace_buffer().push( { trace_timestamp_ns(), seqno, ackno, length, window, event, flags } );
+  }
+}
+
+//! The events of one thread, oldest first
+struct ThreadTrace
+{
+  uint64_t thread {}; //!< in order of each thread's first event
+  std::vector<TraceRecord> records {};
+};
+
+//! Write every thread's buffered events (best called once the traced threads are idle), and read them back
+void write_traces( std::ostream& out );
+std::vector<ThreadTrace> read_traces( std::istream& in );
@@ -1,21 +1,55 @@
 #include "tuntap_adapter.hh"
+#include "packet_buffer.hh"
 #include "parser.hh"
 
+#include <array>
+#include <span>
+#include <string>
+#include <string_view>
+
 using namespace std;
 
+//! \details The datagram is read into a pooled packet buffer and only its IPv4 and TCP headers are decoded
+//! before deciding whether it belongs to this connection; the payload is copied out only if it does. A datagram
+//! too big for the buffer's tailroom (the device's MTU may be up to 64 KiB) spills over into a heap buffer
+//! kept for the purpose, and is put back together in one piece.
 optional<TCPMessage> TCPOverIPv4OverTunFdAdapter::read()
 {
-  vector<string> strs( 2 );
-  strs.front().resize( IPv4Header::LENGTH );
-  _tun.read( strs );
-
-  InternetDatagram ip_dgram;
-  const vector<string> buffers = { strs.at( 0 ), strs.at( 1 ) };
-  if ( parse( ip_dgram, buffers ) ) {
-    return unwrap_tcp_in_ip( ip_dgram );
+  PacketBuffer packet;
+  const span<char> tailroom { packet.append( packet.tailroom() ) };
+  const array<span<char>, 2> buffers { tailroom, span<char> { _overflow } };
+  const size_t length { _tun.read( buffers ) };
+  if ( length <= tailroom.size() ) {
+    packet.resize( length );
+    return unwrap_tcp_in_ip( packet.view(), _reassembler );
   }
-  return {};
+
+  string datagram;
+  datagram.reserve( length );
+  datagram.append( tailroom.data(), tailroom.size() );
+  datagram.append( _overflow.data(), length - tailroom.size() );
+  return unwrap_tcp_in_ip( datagram, _reassembler );
+}
+
+//! \details The headers are serialized into a buffer on the stack and the payload is handed to writev() by
+//! reference, so nothing is allocated or copied.
+void TCPOverIPv4OverTunFdAdapter::write( const TCPMessage& msg )
+{
+  IPv4Header ip_header;
+  TCPSegment seg { make_segment( msg, ip_header ) };
+  seg.compute_checksum( ip_header.pseudo_checksum() );
+
+  array<char, IPv4Header::LENGTH + TCPSegment::HEADER_LENGTH> headers {};
+  Serializer serializer { headers };
+  ip_header.serialize( serializer );
+  seg.serialize_header( serializer );
+
+  const array<string_view, 2> buffers { serializer.written(), seg.message.sender.payload };
+  _tun.write( buffers );
 }
 
 //! Specialize LossyFdAdapter to TCPOverIPv4OverTunFdAdapter
 template class LossyFdAdapter<TCPOverIPv4OverTunFdAdapter>;
+
+//! Specialize EmulatorAdapter to TCPOverIPv4OverTunFdAdapter
+template class EmulatorAdapter<TCPOverIPv4OverTunFdAdapter>;
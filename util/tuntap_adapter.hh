@@ -1,5 +1,7 @@
 #pragma once
 
+#include "emulator_adapter.hh"
+#include "fragment_reassembler.hh"
 #include "tcp_over_ip.hh"
 #include "tcp_segment.hh"
 #include "tun.hh"
@@ -7,6 +9,7 @@
 #include <optional>
 #include <unordered_map>
 #include <utility>
+#include <vector>
 
 template<class T>
 concept TCPDatagramAdapter = requires( T a, TCPMessage seg ) {
@@ -24,6 +27,8 @@ class TCPOverIPv4OverTunFdAdapter : public TCPOverIPv4Adapter
 {
 private:
   TunFD _tun;
+  std::vector<char> _overflow = std::vector<char>( 0xffff ); //!< the part of a datagram past a packet buffer
+  FragmentReassembler _reassembler {}; //!< puts fragmented datagrams back together
 
 public:
   //! Construct from a TunFD
@@ -33,7 +38,13 @@ public:
   std::optional<TCPMessage> read();
 
   //! Creates an IPv4 datagram from a TCP segment and writes it to the TUN device
-  void write( const TCPMessage& seg ) { _tun.write( serialize( wrap_tcp_in_ip( seg ) ) ); }
+  void write( const TCPMessage& msg );
+
+  //! Drops partly reassembled datagrams whose time has run out
+  void tick( const size_t ms_since_last_tick ) { _reassembler.tick( ms_since_last_tick ); }
+
+  //! Access the fragment reassembler
+  const FragmentReassembler& reassembler() const { return _reassembler; }
 
   //! Access the underlying TUN device
   explicit operator TunFD&() { return _tun; }
@@ -47,3 +58,4 @@ public:
 
 static_assert( TCPDatagramAdapter<TCPOverIPv4OverTunFdAdapter> );
 static_assert( TCPDatagramAdapter<LossyFdAdapter<TCPOverIPv4OverTunFdAdapter>> );
+static_assert( TCPDatagramAdapter<EmulatorAdapter<TCPOverIPv4OverTunFdAdapter>> );